@@ -8,21 +8,46 @@
  *
  * All macros that take a list head expect a *pointer* to the list head (e.g.
  * use a variable of type "struct your_head *", not &list in the macro).
+ *
+ * Define LIST_HEADER_ONLY before including this header to get the read fast
+ * paths (iterator, is_empty, contains, size) as static inline functions
+ * instead of calls into the library. Both modes link against the same
+ * library and can be mixed in one program.
  */
 
 #ifndef LIST_H
 #define LIST_H
 
-#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+/*
+ * The atomics in this header are spelled through LL_ATOMIC_(T) and
+ * LL_LOAD_ACQUIRE_(p): C11 _Atomic and <stdatomic.h> in C, std::atomic
+ * in C++ (C++17/20 have no <stdatomic.h>). Nothing is added to the
+ * global namespace in C++.
+ */
+#ifdef __cplusplus
+#include <atomic>
+#define LL_ATOMIC_(T) std::atomic<T>
+#define LL_LOAD_ACQUIRE_(p) std::atomic_load_explicit((p), std::memory_order_acquire)
+#define LL_STATIC_ASSERT_(cond, msg) static_assert(cond, msg)
+#else
+#include <stdatomic.h>
+#define LL_ATOMIC_(T) _Atomic(T)
+#define LL_LOAD_ACQUIRE_(p) atomic_load_explicit((p), memory_order_acquire)
+#define LL_STATIC_ASSERT_(cond, msg) _Static_assert(cond, msg)
+#endif
+
+/* List links; the same type as C11 atomic_uintptr_t. */
+typedef LL_ATOMIC_(uintptr_t) ll_atomic_uintptr_t;
+
 /* Commit ID type (64-bit when available). */
-#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
-typedef _Atomic(uint64_t) ll_commit_id_t;
+#if defined(__cplusplus) || (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L)
+typedef LL_ATOMIC_(uint64_t) ll_commit_id_t;
 #else
-typedef _Atomic(unsigned long long) ll_commit_id_t;
+typedef LL_ATOMIC_(unsigned long long) ll_commit_id_t;
 #endif
 
 
@@ -30,12 +55,131 @@ typedef _Atomic(unsigned long long) ll_commit_id_t;
 extern "C" {
 #endif
 
+/*
+ * Allocator hook for the memory the list manages itself: node wrappers,
+ * transaction objects and their write-set buffers, and commit scratch.
+ * alloc returns "size" bytes aligned to "align" (a power of two) or NULL;
+ * free receives the same size and align the block was allocated with.
+ * Both NULL (the default) means the C library allocator.
+ */
+typedef struct ll_allocator {
+    void *(*alloc)(size_t size, size_t align, void *ctx);
+    void (*free)(void *p, size_t size, size_t align, void *ctx);
+    void *ctx;
+} ll_allocator_t;
+
+struct ll_vnode;
+
+/* Batch disposer: receives n removed elements that are safe to free. */
+typedef void (*ll_free_batch_fn)(void **elms, size_t n);
+
+/* Element order for LL_SET_ORDER: <0, 0 or >0 as a sorts before, with or after b. */
+typedef int (*ll_order_fn)(const void *a, const void *b);
+
+/*
+ * Reclamation domain: the open snapshots and walks in progress that
+ * reclaim on a list must respect. Every list starts in one process-wide default
+ * domain, so a snapshot held on any list delays reclaim on all of them.
+ * Lists given their own domain (LL_SET_DOMAIN) only wait for readers of
+ * that domain. A domain may be shared by any set of lists and must
+ * outlive them; ll_domain_create returns NULL on allocation failure.
+ */
+typedef struct ll_domain ll_domain_t;
+
+ll_domain_t *ll_domain_create(void);
+void ll_domain_destroy(ll_domain_t *domain);
+
+/*
+ * Per-list control block, embedded in every head by LL_HEAD and set up by
+ * LL_INIT. Internal; use the macros to change it.
+ */
+typedef struct ll_ctl {
+    ll_allocator_t alloc;
+    ll_domain_t *domain;         /* LL_SET_DOMAIN */
+    ll_atomic_uintptr_t pending; /* removed nodes reclaim has not seen yet */
+    ll_atomic_uintptr_t popped;  /* unlinked by remove_head; the element is the caller's */
+    LL_ATOMIC_(uint64_t) held_min_rid;  /* oldest removal reclaim tracks; UINT64_MAX if none */
+    LL_ATOMIC_(int) backlog;     /* unlinked nodes are waiting to be freed */
+    LL_ATOMIC_(int) reclaiming;  /* one thread reclaims a list at a time */
+    LL_ATOMIC_(struct ll_vnode *) cursor;  /* where a budgeted walk resumes */
+    size_t reclaim_budget;       /* LL_SET_RECLAIM_BUDGET */
+    ll_free_batch_fn free_batch; /* LL_SET_FREE_BATCH; replaces free_cb */
+    bool free_deferred;          /* on the deferred-free thread */
+    uint64_t snapshot_lease_ns;  /* LL_SET_SNAPSHOT_LEASE; 0 = none */
+    LL_ATOMIC_(size_t) garbage;  /* removed nodes not freed yet */
+    LL_ATOMIC_(size_t) garbage_peak;
+    LL_ATOMIC_(size_t) nodes;    /* wrappers allocated, not freed yet */
+    size_t garbage_limit;        /* LL_SET_GARBAGE_LIMIT; 0 = none */
+    unsigned garbage_wait_us;
+    LL_ATOMIC_(uint64_t) n_forced, n_throttled;
+    /* Owned by the reclaiming thread; [0] is disposed with free_cb, [1] popped. */
+    struct ll_vnode *held;       /* removed nodes, still linked or not */
+    size_t n_held;
+    size_t n_unlinked;           /* of those, already unlinked */
+    size_t credit;               /* walk steps paid for by removals */
+    struct ll_vnode *limbo[2];   /* unlinked, waiting out older snapshots */
+    uint64_t limbo_epoch;        /* commit id when limbo was filled */
+    uint64_t limbo_period;       /* QSBR grace period limbo waits for */
+    bool qsbr;                   /* LL_SET_QSBR */
+    int threading;               /* LL_SET_THREADING */
+    ll_order_fn order;           /* LL_SET_ORDER */
+    unsigned spray;              /* LL_SET_RELAXED_MIN; < 2 = strict */
+    struct ll_vnode *retired[2]; /* pinned by a transaction's era */
+    LL_ATOMIC_(int) group_commit;  /* LL_SET_GROUP_COMMIT */
+    LL_ATOMIC_(int) gc_leader;   /* a committer is applying the queue */
+    ll_atomic_uintptr_t gc_queue;  /* transactions waiting for the leader */
+} ll_ctl_t;
+
+/*
+ * Plain readers (LL_CONTAINS, LL_SIZE, the iterators and LL_GENERATE's
+ * read paths) publish one era per walk: ll_read_pin_ pins this thread's
+ * entry in the list's domain at the current commit id, so reclaim frees
+ * nothing the walk can still reach, and ll_read_unpin_ drops it. A pin
+ * taken inside another walk on the same thread is a no-op (slot NULL).
+ * A thread past the 32 that get an entry counts itself in the domain's
+ * overflow instead, which holds back all reclaim while it walks.
+ * Lists in QSBR mode skip both and store nothing.
+ */
+typedef struct ll_pin {
+    LL_ATOMIC_(uint64_t) *slot;  /* NULL: nothing to undo */
+    LL_ATOMIC_(uint64_t) *open;  /* the entry's open transaction count; NULL: slot is the overflow */
+    uint64_t open_w, restore;
+} ll_pin_t;
+
+ll_pin_t ll_read_pin_(ll_ctl_t *ctl, ll_commit_id_t *commit_id);
+void ll_read_unpin_(ll_pin_t *pin);
+
+static inline ll_pin_t ll_pin_(ll_ctl_t *ctl, ll_commit_id_t *commit_id)
+{
+    if (ctl->qsbr) {
+        ll_pin_t none = { NULL, NULL, 0, 0 };
+        return none;
+    }
+    return ll_read_pin_(ctl, commit_id);
+}
+
+static inline void ll_unpin_(ll_pin_t *pin)
+{
+    if (pin->slot)
+        ll_read_unpin_(pin);
+}
+
 /*
  * Embed this in your struct to make it listable. "type" is your struct tag,
  * "name" is the member name for the list link.
  * Example: struct item { int id; LL_ENTRY(item, link); };
  */
-#define LL_ENTRY(type, name) atomic_uintptr_t name
+#define LL_ENTRY(type, name) ll_atomic_uintptr_t name
+
+/*
+ * On x86-64 the head pointer and commit_id share one 16-byte aligned word,
+ * so LL_REMOVE_HEAD can swap both with a single double-width CAS.
+ */
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define LL_HEAD_ALIGN_ __attribute__((aligned(16)))
+#else
+#define LL_HEAD_ALIGN_
+#endif
 
 /*
  * Declare a list head type. "name" is the struct tag, "type" is the element type (struct tag).
@@ -45,9 +189,10 @@ extern "C" {
  */
 #define LL_HEAD(name, type)          \
     struct name {                                \
-        atomic_uintptr_t head;                    \
+        ll_atomic_uintptr_t head LL_HEAD_ALIGN_;  \
         ll_commit_id_t commit_id;                 \
         void (*free_cb)(struct type *);           \
+        ll_ctl_t ctl;                             \
     }
 
 /*
@@ -55,10 +200,145 @@ extern "C" {
  */
 #define LL_INIT(headp)                \
     do {                                          \
-        ll_init_(&((headp)->head), &((headp)->commit_id)); \
+        ll_init_(&((headp)->head), &((headp)->commit_id), &((headp)->ctl)); \
         (headp)->free_cb = NULL;                  \
     } while (0)
 
+/*
+ * Route the list's own allocations (see ll_allocator_t) through alloc_fn and
+ * free_fn with "ctx". Call right after LL_INIT, before the list is shared;
+ * NULL functions restore the C library allocator.
+ */
+#define LL_SET_ALLOCATOR(headp, alloc_fn, free_fn, ctx)         \
+    ll_set_allocator_(&((headp)->ctl), (alloc_fn), (free_fn), (ctx))
+
+/*
+ * Move the list to reclamation domain "domain" (NULL: the default one).
+ * Call right after LL_INIT, before the list is shared.
+ */
+#define LL_SET_DOMAIN(headp, domain)                            \
+    ll_set_domain_(&((headp)->ctl), (domain))
+
+/*
+ * Opt in (on != 0) or out of group commit. With it on, concurrent
+ * ll_txn_commit calls on this list queue up; whichever committer finds no
+ * leader applies the whole queue under a single commit id and runs one
+ * reclaim pass, and the others wait for it. Everything a batch commits
+ * becomes visible at the same id. May be changed at any time.
+ */
+#define LL_SET_GROUP_COMMIT(headp, on)                          \
+    ll_set_group_commit_(&((headp)->ctl), (on))
+
+/*
+ * Cap the list nodes one reclaim pass may visit (default
+ * LL_RECLAIM_BUDGET; 0 = no cap). Reclaim is driven by removals: each
+ * removal pays for a few steps of a walk that resumes where the last one
+ * stopped, so a commit costs in proportion to the garbage it produced,
+ * not to the length of the list.
+ */
+#define LL_RECLAIM_BUDGET 1024
+#define LL_SET_RECLAIM_BUDGET(headp, nodes)                     \
+    ll_set_reclaim_budget_(&((headp)->ctl), (nodes))
+
+/*
+ * Dispose of removed elements in batches instead of one free_cb call each:
+ * every reclaim pass hands what it freed to fn in one call. With deferred
+ * nonzero, the batches are queued for a deferred-free thread (started on
+ * first use, shared by all lists) and fn runs there, off the committing
+ * thread; ll_free_flush waits for the batches queued so far. fn replaces
+ * free_cb for this list; NULL goes back to free_cb. Call before the list
+ * is shared.
+ *
+ * A queued batch no longer needs its list, but it still calls fn and
+ * frees itself through the list's allocator. Call ll_free_flush before
+ * destroying that allocator's context or unloading the code fn lives in.
+ * ll_free_shutdown runs whatever is queued, then stops and joins the
+ * thread (for library unload or leak checkers); the next deferred batch
+ * starts it again. Don't call it while deferred lists are still reclaiming.
+ */
+#define LL_SET_FREE_BATCH(headp, fn, deferred)                  \
+    ll_set_free_batch_(&((headp)->ctl), (fn), (deferred))
+
+void ll_free_flush(void);
+void ll_free_shutdown(void);
+
+/*
+ * Quiescent-state-based reclamation for read-mostly lists. Plain readers
+ * of a list with QSBR on (LL_CONTAINS, LL_FOREACH, LL_SIZE and the
+ * iterator) store nothing. Instead, each reader thread calls
+ * ll_qsbr_online once, then ll_quiescent_state whenever it holds no
+ * reference into any such list (e.g. once per event-loop turn), and
+ * ll_qsbr_offline before blocking for long or exiting. Removed nodes are
+ * freed only after every online thread has passed a quiescent state, so a
+ * stalled online thread delays reclamation on every QSBR list. Call
+ * LL_SET_QSBR before the list is shared. At most 32 threads are online
+ * (or hold any list's era slot) at once: ll_qsbr_online returns -1 when
+ * none is left, and that thread must not read QSBR lists until a retry
+ * returns 0.
+ */
+#define LL_SET_QSBR(headp, on)                                  \
+    ll_set_qsbr_(&((headp)->ctl), (on))
+
+int ll_qsbr_online(void);
+void ll_qsbr_offline(void);
+void ll_quiescent_state(void);
+
+/*
+ * Who may change a list (LL_SET_THREADING). The default, LL_MULTI_WRITER,
+ * allows any thread. Under LL_SINGLE_WRITER one thread makes every change
+ * (inserts, removes, commits) and others only read: plain reads, and
+ * transactions they roll back. The writer's plain operations, ordered
+ * inserts and LL_REMOVE_MIN included, then use plain loads and release
+ * stores instead of read-modify-writes and skip the walk pin; with one
+ * remover LL_REMOVE_MIN is always strict, whatever LL_SET_RELAXED_MIN
+ * says. LL_SINGLE_THREADED is for a list only one thread ever touches,
+ * and drops the release ordering as well: its accesses are relaxed
+ * atomics, which compile to the same moves as plain ones. The mode is a
+ * runtime setting on the head, checked once per operation. The macro API
+ * is the same in every mode. Call right after LL_INIT.
+ */
+#define LL_MULTI_WRITER    0
+#define LL_SINGLE_WRITER   1
+#define LL_SINGLE_THREADED 2
+
+#define LL_SET_THREADING(headp, mode)                           \
+    ll_set_threading_(&((headp)->ctl), (mode))
+
+/*
+ * Bound the removed nodes waiting to be freed (0 = no bound, the default).
+ * A remover or committer that finds more than "nodes" of them runs a full
+ * reclaim pass itself; if that is not enough (an old snapshot still sees
+ * them) and max_wait_us is nonzero, it backs off and retries for up to
+ * max_wait_us microseconds before going on. Don't set a wait if removers
+ * may hold a transaction open on the same list: they would wait on
+ * themselves.
+ */
+#define LL_SET_GARBAGE_LIMIT(headp, nodes, max_wait_us)         \
+    ll_set_garbage_limit_(&((headp)->ctl), (nodes), (max_wait_us))
+
+/*
+ * Give every transaction started on this list a lease of lease_us
+ * microseconds on its snapshot (0, the default: no limit). A transaction
+ * still open when its lease runs out stops holding back reclamation: its
+ * snapshot is revoked by the next reclaim pass that notices, its reads see
+ * nothing more, ll_txn_status reports LL_TXN_EXPIRED and ll_txn_commit
+ * discards it with that result. A snapshot is never revoked in the middle
+ * of one of the transaction's own operations.
+ */
+#define LL_SET_SNAPSHOT_LEASE(headp, lease_us)                  \
+    ll_set_snapshot_lease_(&((headp)->ctl), (lease_us))
+
+typedef struct ll_garbage_stats {
+    size_t garbage;       /* removed nodes not freed yet */
+    size_t peak;          /* most there have been at once */
+    uint64_t forced;      /* reclaim passes forced by the limit */
+    uint64_t throttled;   /* of those, how many then had to wait */
+} ll_garbage_stats_t;
+
+/* Fill *statsp with the list's reclamation backlog, for monitoring. */
+#define LL_GARBAGE_STATS(headp, statsp)                         \
+    ll_garbage_stats_(&((headp)->ctl), (statsp))
+
 /*
  * Insert element at the head. "elm" is a pointer to your struct; "field" is
  * the member name of LL_ENTRY. No allocation; you own "elm".
@@ -71,20 +351,21 @@ extern "C" {
     ({ __typeof__(elm) _e = (elm); (size_t)offsetof(__typeof__(*_e), field); })
 
 #define LL_INSERT_HEAD(headp, elm, field)                   \
-    ll_insert_head_(&((headp)->head), &((headp)->commit_id), (void *)(elm))
+    ll_insert_head_(&((headp)->head), &((headp)->commit_id), &((headp)->ctl), (void *)(elm))
 
 /*
  * Insert element at the tail.
  */
 #define LL_INSERT_TAIL(headp, elm, field)                   \
-    ll_insert_tail_(&((headp)->head), &((headp)->commit_id), (void *)(elm))
+    ll_insert_tail_(&((headp)->head), &((headp)->commit_id), &((headp)->ctl), (void *)(elm))
 
 /*
  * Insert element after the node containing after_elm (by pointer). Lock-free;
  * uses current commit_id snapshot to find after_elm. No-op if after_elm not in list.
  */
 #define LL_INSERT_AFTER(headp, after_elm, elm, field)                       \
-    ll_insert_after_(&((headp)->head), &((headp)->commit_id), (void *)(after_elm), (void *)(elm))
+    ll_insert_after_(&((headp)->head), &((headp)->commit_id), &((headp)->ctl), \
+                     (void *)(after_elm), (void *)(elm))
 
 /*
  * Remove and return the element at the head. Returns NULL if empty.
@@ -92,21 +373,52 @@ extern "C" {
  * Caller may free the returned element when no longer needed.
  */
 #define LL_REMOVE_HEAD(headp, type, field)                  \
-    ((type *)ll_remove_head_(&((headp)->head), &((headp)->commit_id)))
+    ((type *)ll_remove_head_(&((headp)->head), &((headp)->commit_id), &((headp)->ctl), \
+                             (void (*)(void *))(headp)->free_cb))
 
 /*
- * Remove the given element from the list. If head->free_cb is set, it will be
- * called when the element is safe to free (after reclaim); otherwise you must
- * not free the element until no thread can reference it (e.g. by design).
+ * Remove the given element from the list; 0 on success, -1 if it is not in
+ * the list or already removed. If head->free_cb is set, it will be called
+ * when the element is safe to free (after reclaim); otherwise you must not
+ * free the element until no thread can reference it (e.g. by design).
  */
 #define LL_REMOVE(headp, elm, field)                        \
-    ll_remove_(&((headp)->head), &((headp)->commit_id), (void (*)(void *))(headp)->free_cb, (void *)(elm))
+    ll_remove_(&((headp)->head), &((headp)->commit_id), &((headp)->ctl), \
+               (void (*)(void *))(headp)->free_cb, (void *)(elm))
+
+/*
+ * Priority queues. LL_SET_ORDER(headp, cmp) keeps the list sorted by cmp
+ * (see ll_order_fn; it gets element pointers): LL_INSERT_ORDERED links
+ * elm after every element that does not sort after it, and LL_REMOVE_MIN
+ * pops the least, in one step at the head. Both are lock-free. Don't mix
+ * them with the unordered inserts on the same list. Call LL_SET_ORDER
+ * right after LL_INIT.
+ */
+#define LL_SET_ORDER(headp, cmp)                                \
+    ll_set_order_(&((headp)->ctl), (ll_order_fn)(cmp))
+
+#define LL_INSERT_ORDERED(headp, elm, field)                \
+    ll_insert_ordered_(&((headp)->head), &((headp)->commit_id), &((headp)->ctl), (void *)(elm))
+
+#define LL_REMOVE_MIN(headp, type, field)                   \
+    ((type *)ll_remove_min_(&((headp)->head), &((headp)->commit_id), &((headp)->ctl), \
+                            (void (*)(void *))(headp)->free_cb))
+
+/*
+ * Relaxed delete-min for many concurrent removers, after the SprayList:
+ * LL_REMOVE_MIN takes a random one of the first "width" elements instead
+ * of every remover contending for the first, so an element may come out
+ * up to width - 1 places early. A width of about the number of removers
+ * times its log keeps them mostly apart; 0 or 1 is strict (the default).
+ */
+#define LL_SET_RELAXED_MIN(headp, width)                        \
+    ll_set_relaxed_min_(&((headp)->ctl), (width))
 
 /*
  * Return true if "elm" is in the list (by pointer equality).
  */
 #define LL_CONTAINS(headp, elm, field)                       \
-    ll_contains_(&((headp)->head), &((headp)->commit_id), (void *)(elm))
+    ll_contains_(&((headp)->head), &((headp)->commit_id), &((headp)->ctl), (void *)(elm))
 
 /*
  * Return true if the list is empty.
@@ -118,35 +430,64 @@ extern "C" {
  * "type" is the element struct type; "field" is the list entry member name.
  */
 #define LL_SIZE(headp, type, field)                         \
-    ll_size_(&((headp)->head), &((headp)->commit_id))
+    ll_size_(&((headp)->head), &((headp)->commit_id), &((headp)->ctl))
 
 /*
  * Iterator for versioned traversal (snapshot at current commit_id).
- * Do not remove elements during iteration.
+ * Do not remove elements during iteration. The iterator holds a read pin
+ * (see ll_pin_t) from ll_iter_begin until it is exhausted; call
+ * ll_iter_end to stop early. Iterators on one thread must end in the
+ * reverse order they began.
  */
 typedef struct ll_iter {
     int begun;
     void *cur;           /* current versioned_node *; internal */
-    atomic_uintptr_t *head;
+    ll_atomic_uintptr_t *head;
     ll_commit_id_t *commit_id;
     uint64_t snapshot_version;
+    ll_pin_t pin;
 } ll_iter_t;
 
+/* An ll_iter_t that has not begun, without -Wmissing-field-initializers in C++. */
+#ifdef __cplusplus
+#define LL_ITER_INIT {}
+#else
+#define LL_ITER_INIT {0}
+#endif
+
+#ifndef LIST_HEADER_ONLY
 void ll_iter_begin(ll_iter_t *it,
-    atomic_uintptr_t *head, ll_commit_id_t *commit_id);
+    ll_atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl);
 bool ll_iter_has(ll_iter_t *it);
 void ll_iter_next(ll_iter_t *it);
 void *ll_iter_get(ll_iter_t *it);
+void ll_iter_end(ll_iter_t *it);
+#endif
+
+/*
+ * The loop macros end their iterator however the loop is left. With GCC
+ * and Clang that includes return and goto out of the body (a cleanup
+ * attribute); elsewhere only break and running to the end do, and
+ * leaving by return or goto keeps the iterator's pin, holding back
+ * reclaim in the list's domain until the thread exits.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define LL_SCOPED_(end_fn) __attribute__((cleanup(end_fn)))
+#else
+#define LL_SCOPED_(end_fn)
+#endif
 
 /*
  * Traverse the list at current snapshot. "var" is the loop variable.
+ * "break", and with GCC or Clang also return and goto, end the walk.
  */
 #define LL_FOREACH(var, headp, type, field)                  \
-    for (ll_iter_t _ll_it = {0};                             \
-         (void)(!_ll_it.begun && (ll_iter_begin(&_ll_it, &((headp)->head), &((headp)->commit_id)), 0)), \
-         ll_iter_has(&_ll_it);                               \
-         ll_iter_next(&_ll_it))                              \
-        if (((var) = (type *)ll_iter_get(&_ll_it)) != NULL)
+    for (ll_iter_t _ll_it LL_SCOPED_(ll_iter_end) = LL_ITER_INIT, *_ll_itp = &_ll_it; _ll_itp; \
+         ll_iter_end(_ll_itp), _ll_itp = NULL)               \
+        for (ll_iter_begin(&_ll_it, &((headp)->head), &((headp)->commit_id), &((headp)->ctl)); \
+             ll_iter_has(&_ll_it);                           \
+             ll_iter_next(&_ll_it))                          \
+            if (((var) = (type *)ll_iter_get(&_ll_it)) != NULL)
 
 /*
  * --- Snapshot visibility ---
@@ -159,6 +500,74 @@ void *ll_iter_get(ll_iter_t *it);
  * modified (removed).
  */
 
+/*
+ * Call cb(elm, userdata) for every element visible at one snapshot, with
+ * the calls spread over up to nthreads threads (the caller plus
+ * nthreads - 1 created for this call and joined before it returns, at
+ * most 32 in all). Only the callbacks run in parallel: the traversal
+ * itself is a single serial walk by the calling thread, which hands the
+ * elements over in chunks. This pays off when cb does real work per
+ * element; for a cheap cb the walk bounds the scan, and the thread
+ * start-up makes it slower than LL_FOREACH. cb runs concurrently and in
+ * no particular order. Returns the number of elements visited. As with
+ * LL_FOREACH, do not remove elements from within cb. Removes from other
+ * threads may run meanwhile: each element visible at the snapshot is
+ * visited exactly once.
+ */
+#define LL_PARALLEL_CALLBACKS(headp, nthreads, cb, userdata)     \
+    ll_parallel_callbacks_(&((headp)->head), &((headp)->commit_id), &((headp)->ctl), \
+                           (nthreads), (cb), (userdata))
+
+/*
+ * Aggregate the elements visible at one snapshot (counts, sums, min/max)
+ * without a transaction or a copy. As for LL_PARALLEL_CALLBACKS, the walk
+ * is serial and only map runs in parallel. Each taking thread gets an accumulator of acc_size bytes, on its own
+ * 64-byte-aligned cache lines, that identity sets up; map folds one element into it, and combine folds the
+ * accumulators together into *result. The threads meet elements in no
+ * particular order, so map and combine must not care about order: with
+ * nthreads 1 the walk is serial and in list order. Returns 0, or -1 if
+ * out of memory (nothing is called).
+ *
+ *   struct stats { long n, sum; };
+ *   static void st_zero(void *a, void *ud) { memset(a, 0, sizeof(struct stats)); }
+ *   static void st_add(void *a, const void *e, void *ud)
+ *       { ((struct stats *)a)->n++; ((struct stats *)a)->sum += ((const struct item *)e)->value; }
+ *   static void st_merge(void *a, const void *b, void *ud) { ... }
+ *   static const ll_reduce_ops_t stats_ops = { sizeof(struct stats), st_zero, st_add, st_merge };
+ *   struct stats st;
+ *   LL_SNAPSHOT_REDUCE(lst_p, 4, &stats_ops, &st, NULL);
+ */
+typedef struct ll_reduce_ops {
+    size_t acc_size;
+    void (*identity)(void *acc, void *userdata);
+    void (*map)(void *acc, const void *elm, void *userdata);
+    void (*combine)(void *acc, const void *other, void *userdata);
+} ll_reduce_ops_t;
+
+#define LL_SNAPSHOT_REDUCE(headp, nthreads, ops, result, userdata) \
+    ll_snapshot_reduce_(&((headp)->head), &((headp)->commit_id), &((headp)->ctl), \
+                        (nthreads), (ops), (result), (userdata))
+
+/*
+ * Copy the elements visible at snapshot S into one array, in list order:
+ * *out gets the array and *n how many it holds. S is 0 for the current
+ * snapshot, or the ll_txn_snapshot of a transaction still open on this
+ * list. The array is sized up front from the list's count of live nodes
+ * and filled in one walk, so it rarely needs to grow. It is the
+ * caller's, not the list's, so it comes from plain malloc even on a list
+ * with LL_SET_ALLOCATOR (free it with free; NULL if nothing is visible),
+ * or with the _ARENA form from arena->alloc, for arenas released all at once:
+ * arena->free is never called, and a list growing under the call can
+ * leave a smaller block behind in the arena. Returns 0, or -1 if out of
+ * memory (*out NULL, *n 0).
+ */
+#define LL_SNAPSHOT_TO_ARRAY(headp, S, out, n)                   \
+    ll_snapshot_to_array_(&((headp)->head), &((headp)->commit_id), &((headp)->ctl), \
+                          (S), (void ***)(out), (n), NULL)
+#define LL_SNAPSHOT_TO_ARRAY_ARENA(headp, S, out, n, arena)      \
+    ll_snapshot_to_array_(&((headp)->head), &((headp)->commit_id), &((headp)->ctl), \
+                          (S), (void ***)(out), (n), (arena))
+
 /*
  * --- Transactions ---
  * Start a transaction to see a snapshot of the list and buffer inserts/removes.
@@ -178,7 +587,8 @@ typedef void (*ll_txn_foreach_fn)(void *elm, void *userdata);
  * continue to add/remove. Returns NULL on allocation failure.
  */
 #define LL_TXN_START(headp, type, field)                     \
-    ll_txn_start_(&((headp)->head), &((headp)->commit_id), (void (*)(void *))(headp)->free_cb)
+    ll_txn_start_(&((headp)->head), &((headp)->commit_id), &((headp)->ctl), \
+                  (void (*)(void *))(headp)->free_cb)
 
 /**
  * Insert at head (in transaction view). Applied to the list on commit.
@@ -219,20 +629,64 @@ typedef void (*ll_txn_foreach_fn)(void *elm, void *userdata);
 #define LL_TXN_FOREACH(txn, cb, userdata)                    \
     ll_txn_foreach_((txn), (cb), (userdata))
 
+/**
+ * Pull-style cursor over the transaction view, in LL_TXN_FOREACH order:
+ * head inserts, then snapshot nodes each followed by its insert-afters, then
+ * tail inserts. ll_txn_iter_get returns the current element, or NULL once
+ * the view is exhausted; stop whenever you like, there is nothing to free.
+ * ll_txn_iter_batch copies up to "max" elements from the current one on
+ * into "out", advances past them and returns how many it copied.
+ * Changes made to the txn while a cursor is open are not guaranteed to be
+ * seen by that cursor.
+ */
+typedef struct ll_txn_iter {
+    ll_txn_t *txn;
+    void *cur;           /* current element; NULL at end */
+    void *node;          /* current snapshot node; internal */
+    size_t pos;          /* position within the current phase; internal */
+    int phase;           /* internal */
+    bool grouped;        /* walking an indexed insert-after group; internal */
+} ll_txn_iter_t;
+
+void ll_txn_iter_begin(ll_txn_iter_t *it, ll_txn_t *txn);
+void ll_txn_iter_next(ll_txn_iter_t *it);
+void *ll_txn_iter_get(const ll_txn_iter_t *it);
+size_t ll_txn_iter_batch(ll_txn_iter_t *it, void **out, size_t max);
+
+/**
+ * Loop over the transaction view with the cursor; "break" stops early.
+ * Example: LL_TXN_FOREACH_ITER(var, txn, struct item) if (var->id == id) break;
+ */
+#define LL_TXN_FOREACH_ITER(var, txn, type)                          \
+    for (ll_txn_iter_t _ll_ti, *_ll_tip = &_ll_ti; _ll_tip; _ll_tip = NULL)       \
+        for (ll_txn_iter_begin(&_ll_ti, (txn));                      \
+             ((var) = (type *)ll_txn_iter_get(&_ll_ti)) != NULL;     \
+             ll_txn_iter_next(&_ll_ti))
+
+/** Result of a transaction whose snapshot lease ran out (LL_SET_SNAPSHOT_LEASE). */
+#define LL_TXN_EXPIRED (-2)
+
 /**
  * Commit: apply all buffered removes then inserts to the list. Frees the txn;
- * do not use txn after this. Returns 0 on success.
+ * do not use txn after this. Returns 0 on success, or LL_TXN_EXPIRED (and
+ * nothing is applied) if the snapshot lease ran out first.
  */
 int ll_txn_commit(ll_txn_t *txn);
 
+/** 0 while the transaction's snapshot is held, LL_TXN_EXPIRED once revoked. */
+int ll_txn_status(ll_txn_t *txn);
+
+/** The commit id the transaction reads at (e.g. for LL_SNAPSHOT_TO_ARRAY). */
+uint64_t ll_txn_snapshot(ll_txn_t *txn);
+
 /**
  * Rollback: discard all buffered changes and free the txn. Do not use txn after this.
  */
 void ll_txn_rollback(ll_txn_t *txn);
 
 /* Internal (used by macros). */
-ll_txn_t *ll_txn_start_(atomic_uintptr_t *head,
-    ll_commit_id_t *commit_id, void (*free_cb)(void *));
+ll_txn_t *ll_txn_start_(ll_atomic_uintptr_t *head,
+    ll_commit_id_t *commit_id, ll_ctl_t *ctl, void (*free_cb)(void *));
 void ll_txn_insert_head_(ll_txn_t *txn, void *elm);
 void ll_txn_insert_tail_(ll_txn_t *txn, void *elm);
 void ll_txn_insert_after_(ll_txn_t *txn, void *after_elm, void *elm);
@@ -241,16 +695,366 @@ bool ll_txn_contains_(ll_txn_t *txn, const void *elm);
 void ll_txn_foreach_(ll_txn_t *txn,
     ll_txn_foreach_fn cb, void *userdata);
 
+/*
+ * Work-stealing deque (Chase-Lev) of element pointers, for per-worker task
+ * queues. The owning thread pushes and pops at the bottom with plain
+ * stores (a CAS only when taking the last element); other threads steal
+ * from the top with one CAS each. The ring buffer doubles when full; the
+ * old one is kept until no thief can still be reading it, using the
+ * walk pins and eras of a reclamation domain private to the deque.
+ *
+ *   ll_wsdeque_t dq;
+ *   LL_WSDEQUE_INIT(&dq);                          owner, before sharing
+ *   LL_WSDEQUE_PUSH(&dq, task);                    owner
+ *   t = LL_WSDEQUE_POP(&dq, struct task);          owner; NULL if empty
+ *   t = LL_WSDEQUE_STEAL(&victim, struct task);    any thread; NULL if empty
+ *   n = LL_WSDEQUE_STEAL_HALF(&victim, buf, max);  up to half, oldest first
+ *   LL_WSDEQUE_DESTROY(&dq);                       once nobody uses it
+ */
+struct ll_wsring;
+typedef struct ll_wsdeque {
+    LL_ATOMIC_(int64_t) top;     /* next to steal */
+    char pad_[64 - sizeof(int64_t)];
+    LL_ATOMIC_(int64_t) bottom;  /* next free slot; owner only writes */
+    LL_ATOMIC_(struct ll_wsring *) ring;
+    ll_commit_id_t epoch;        /* bumped on every resize; thieves pin it */
+    ll_domain_t *domain;         /* thieves' pins, nothing else */
+    struct ll_wsring *retired;   /* outgrown rings; owner only */
+} ll_wsdeque_t;
+
+/* 0, or -1 if out of memory. */
+#define LL_WSDEQUE_INIT(dq)                 ll_wsdeque_init_(dq)
+#define LL_WSDEQUE_DESTROY(dq)              ll_wsdeque_destroy_(dq)
+/* Owner only. 0, or -1 if the ring could not grow (elm not pushed). */
+#define LL_WSDEQUE_PUSH(dq, elm)            ll_wsdeque_push_((dq), (void *)(elm))
+/* Owner only: the most recently pushed element. */
+#define LL_WSDEQUE_POP(dq, type)            ((type *)ll_wsdeque_pop_(dq))
+/* Any thread: the oldest element. */
+#define LL_WSDEQUE_STEAL(dq, type)          ((type *)ll_wsdeque_steal_(dq))
+/* Any thread: up to half the elements (at most max) into out, oldest first; returns how many. */
+#define LL_WSDEQUE_STEAL_HALF(dq, out, max) ll_wsdeque_steal_half_((dq), (void **)(out), (max))
+/* Elements in the deque; exact only while nobody else is using it. */
+#define LL_WSDEQUE_SIZE(dq)                 ll_wsdeque_size_(dq)
+
+int ll_wsdeque_init_(ll_wsdeque_t *dq);
+void ll_wsdeque_destroy_(ll_wsdeque_t *dq);
+int ll_wsdeque_push_(ll_wsdeque_t *dq, void *elm);
+void *ll_wsdeque_pop_(ll_wsdeque_t *dq);
+void *ll_wsdeque_steal_(ll_wsdeque_t *dq);
+size_t ll_wsdeque_steal_half_(ll_wsdeque_t *dq, void **out, size_t max);
+size_t ll_wsdeque_size_(ll_wsdeque_t *dq);
+
 /* Internal API: list uses versioned wrappers; commit_id tags each change. */
-void ll_init_(atomic_uintptr_t *head, ll_commit_id_t *commit_id);
-void ll_insert_head_(atomic_uintptr_t *head, ll_commit_id_t *commit_id, void *elm);
-void ll_insert_tail_(atomic_uintptr_t *head, ll_commit_id_t *commit_id, void *elm);
-void ll_insert_after_(atomic_uintptr_t *head, ll_commit_id_t *commit_id, void *after_elm, void *elm);
-void *ll_remove_head_(atomic_uintptr_t *head, ll_commit_id_t *commit_id);
-int ll_remove_(atomic_uintptr_t *head, ll_commit_id_t *commit_id, void (*free_cb)(void *), void *elm);
-bool ll_contains_(atomic_uintptr_t *head, ll_commit_id_t *commit_id, const void *elm);
-bool ll_is_empty_(atomic_uintptr_t *head);
-size_t ll_size_(atomic_uintptr_t *head, ll_commit_id_t *commit_id);
+void ll_init_(ll_atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl);
+void ll_set_allocator_(ll_ctl_t *ctl,
+    void *(*alloc_fn)(size_t, size_t, void *),
+    void (*free_fn)(void *, size_t, size_t, void *), void *ctx);
+void ll_set_domain_(ll_ctl_t *ctl, ll_domain_t *domain);
+void ll_set_group_commit_(ll_ctl_t *ctl, int on);
+void ll_set_reclaim_budget_(ll_ctl_t *ctl, size_t nodes);
+void ll_set_qsbr_(ll_ctl_t *ctl, int on);
+void ll_set_threading_(ll_ctl_t *ctl, int mode);
+void ll_set_order_(ll_ctl_t *ctl, ll_order_fn cmp);
+void ll_set_relaxed_min_(ll_ctl_t *ctl, unsigned width);
+void ll_set_free_batch_(ll_ctl_t *ctl, ll_free_batch_fn fn, int deferred);
+void ll_set_snapshot_lease_(ll_ctl_t *ctl, uint64_t lease_us);
+void ll_set_garbage_limit_(ll_ctl_t *ctl, size_t nodes, unsigned max_wait_us);
+void ll_garbage_stats_(ll_ctl_t *ctl, ll_garbage_stats_t *stats);
+void ll_insert_head_(ll_atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl, void *elm);
+void ll_insert_tail_(ll_atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl, void *elm);
+void ll_insert_ordered_(ll_atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl, void *elm);
+void ll_insert_after_(ll_atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl,
+    void *after_elm, void *elm);
+void *ll_remove_head_(ll_atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl,
+    void (*free_cb)(void *));
+void *ll_remove_min_(ll_atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl,
+    void (*free_cb)(void *));
+int ll_remove_(ll_atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl,
+    void (*free_cb)(void *), void *elm);
+size_t ll_parallel_callbacks_(ll_atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl,
+    int nthreads, ll_txn_foreach_fn cb, void *userdata);
+int ll_snapshot_reduce_(ll_atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl,
+    int nthreads, const ll_reduce_ops_t *ops, void *result, void *userdata);
+int ll_snapshot_to_array_(ll_atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl,
+    uint64_t S, void ***out, size_t *n, const ll_allocator_t *arena);
+#ifndef LIST_HEADER_ONLY
+bool ll_contains_(ll_atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl,
+    const void *elm);
+bool ll_is_empty_(ll_atomic_uintptr_t *head);
+size_t ll_size_(ll_atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl);
+#endif
+
+/*
+ * --- Versioned node layout ---
+ * The list chains these wrappers; each holds the user element and the
+ * commit ids that bound its lifetime. Exposed so generated code can inline
+ * read paths; treat the fields as read-only outside list.c.
+ */
+typedef struct ll_vnode {
+    void *user_elm;
+    uint64_t insert_txn_id;
+    LL_ATOMIC_(uint64_t) removed_txn_id;  /* 0 = not removed */
+    ll_atomic_uintptr_t next;          /* bit 0: being unlinked */
+    struct ll_vnode *retire_next;      /* reclaim's chains; next stays intact */
+} ll_vnode_t;
+
+static inline ll_vnode_t *ll_vnode_(uintptr_t u)
+{
+    return (ll_vnode_t *)(u & ~(uintptr_t)1UL);
+}
+
+static inline ll_vnode_t *ll_vnode_next_(const ll_vnode_t *w)
+{
+    return ll_vnode_(LL_LOAD_ACQUIRE_(&w->next));
+}
+
+static inline bool ll_vnode_visible_(ll_vnode_t *w, uint64_t snapshot_version)
+{
+    uint64_t rid = LL_LOAD_ACQUIRE_(&w->removed_txn_id);
+    return w->insert_txn_id <= snapshot_version && (rid == 0 || rid > snapshot_version);
+}
+
+/*
+ * Cursor for generated iteration: current node, the snapshot it was
+ * started at and its read pin, dropped once the cursor runs off the end.
+ */
+typedef struct ll_gcursor {
+    ll_vnode_t *node;
+    uint64_t snapshot_version;
+    ll_pin_t pin;
+} ll_gcursor_t;
+
+/* Stop a cursor before the end; harmless on one that already ran off it. */
+static inline void ll_gcursor_end_(ll_gcursor_t *c)
+{
+    ll_unpin_(&c->pin);
+    c->pin.slot = NULL;
+}
+
+static inline void *ll_gcursor_skip_(ll_gcursor_t *c, ll_vnode_t *w)
+{
+    while (w && !ll_vnode_visible_(w, c->snapshot_version))
+        w = ll_vnode_next_(w);
+    c->node = w;
+    if (!w)
+        ll_gcursor_end_(c);
+    return w ? w->user_elm : NULL;
+}
+
+static inline void *ll_gcursor_first_(ll_gcursor_t *c, ll_atomic_uintptr_t *head,
+    ll_commit_id_t *commit_id, ll_ctl_t *ctl)
+{
+    c->pin = ll_pin_(ctl, commit_id);
+    c->snapshot_version = LL_LOAD_ACQUIRE_(commit_id);
+    return ll_gcursor_skip_(c, ll_vnode_(LL_LOAD_ACQUIRE_(head)));
+}
+
+#ifdef LIST_HEADER_ONLY
+/* Inline fast paths; same behavior as the out-of-line versions in list.c. */
+static inline void ll_iter_begin(ll_iter_t *it,
+    ll_atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl)
+{
+    ll_gcursor_t c;
+    ll_gcursor_first_(&c, head, commit_id, ctl);
+    it->head = head;
+    it->commit_id = commit_id;
+    it->snapshot_version = c.snapshot_version;
+    it->pin = c.pin;
+    it->begun = 1;
+    it->cur = c.node;
+}
+
+static inline bool ll_iter_has(ll_iter_t *it)
+{
+    return it->cur != NULL;
+}
+
+static inline void ll_iter_next(ll_iter_t *it)
+{
+    if (!it->cur)
+        return;
+    ll_gcursor_t c = { NULL, it->snapshot_version, it->pin };
+    ll_gcursor_skip_(&c, ll_vnode_next_((ll_vnode_t *)it->cur));
+    it->cur = c.node;
+    it->pin = c.pin;
+}
+
+static inline void *ll_iter_get(ll_iter_t *it)
+{
+    return it->cur ? ((ll_vnode_t *)it->cur)->user_elm : NULL;
+}
+
+static inline void ll_iter_end(ll_iter_t *it)
+{
+    ll_unpin_(&it->pin);
+    it->pin.slot = NULL;
+    it->cur = NULL;
+}
+
+static inline bool ll_is_empty_(ll_atomic_uintptr_t *head)
+{
+    return ll_vnode_(LL_LOAD_ACQUIRE_(head)) == NULL;
+}
+
+static inline bool ll_contains_(ll_atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl,
+    const void *elm)
+{
+    ll_pin_t pin = ll_pin_(ctl, commit_id);
+    uint64_t S = LL_LOAD_ACQUIRE_(commit_id);
+    ll_vnode_t *w = ll_vnode_(LL_LOAD_ACQUIRE_(head));
+    while (w && !(w->user_elm == elm && ll_vnode_visible_(w, S)))
+        w = ll_vnode_next_(w);
+    ll_unpin_(&pin);
+    return w != NULL;
+}
+
+static inline size_t ll_size_(ll_atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl)
+{
+    ll_pin_t pin = ll_pin_(ctl, commit_id);
+    uint64_t S = LL_LOAD_ACQUIRE_(commit_id);
+    size_t n = 0;
+    for (ll_vnode_t *w = ll_vnode_(LL_LOAD_ACQUIRE_(head)); w; w = ll_vnode_next_(w))
+        n += ll_vnode_visible_(w, S);
+    ll_unpin_(&pin);
+    return n;
+}
+#endif /* LIST_HEADER_ONLY */
+
+/*
+ * --- Type-specialized operations (sys/tree.h style) ---
+ * LL_GENERATE(name, type, field) emits static inline, type-safe versions of
+ * the list operations for "struct name" (declared with LL_HEAD(name, type)).
+ * Read paths (contains, size, find, iteration) are emitted inline against
+ * the node layout above, so the compiler can inline visibility checks,
+ * comparators and loop bodies; mutations call the lock-free out-of-line
+ * implementation.
+ *
+ *   LL_HEAD(item_list, item);
+ *   LL_GENERATE(item_list, item, link)
+ *
+ *   struct item *it;
+ *   LL_GFOREACH(it, item_list, headp) { ... }
+ *   struct item *hit = item_list_LL_FIND(headp, item_cmp, &key);
+ *
+ * The comparator passed to _LL_FIND returns 0 on a match; declare it static
+ * so it can be inlined.
+ */
+#define LL_GENERATE(name, type, field)                                             \
+LL_STATIC_ASSERT_(sizeof(((struct type *)0)->field) == sizeof(ll_atomic_uintptr_t), \
+                  "LL_GENERATE: " #type "." #field " is not an LL_ENTRY");        \
+static inline void name##_LL_INSERT_HEAD(struct name *head, struct type *elm)      \
+{                                                                                  \
+    ll_insert_head_(&head->head, &head->commit_id, &head->ctl, elm);               \
+}                                                                                  \
+static inline void name##_LL_INSERT_TAIL(struct name *head, struct type *elm)      \
+{                                                                                  \
+    ll_insert_tail_(&head->head, &head->commit_id, &head->ctl, elm);               \
+}                                                                                  \
+static inline void name##_LL_INSERT_AFTER(struct name *head,                       \
+    struct type *after_elm, struct type *elm)                                      \
+{                                                                                  \
+    ll_insert_after_(&head->head, &head->commit_id, &head->ctl, after_elm, elm);   \
+}                                                                                  \
+static inline struct type *name##_LL_REMOVE_HEAD(struct name *head)                \
+{                                                                                  \
+    return (struct type *)ll_remove_head_(&head->head, &head->commit_id,           \
+        &head->ctl, (void (*)(void *))head->free_cb);                              \
+}                                                                                  \
+static inline int name##_LL_REMOVE(struct name *head, struct type *elm)            \
+{                                                                                  \
+    return ll_remove_(&head->head, &head->commit_id, &head->ctl,                   \
+                      (void (*)(void *))head->free_cb, elm);                       \
+}                                                                                  \
+static inline struct type *name##_LL_FIRST(struct name *head, ll_gcursor_t *c)     \
+{                                                                                  \
+    return (struct type *)ll_gcursor_first_(c, &head->head, &head->commit_id,      \
+                                            &head->ctl);                           \
+}                                                                                  \
+static inline struct type *name##_LL_NEXT(ll_gcursor_t *c)                         \
+{                                                                                  \
+    return (struct type *)ll_gcursor_skip_(c, ll_vnode_next_(c->node));            \
+}                                                                                  \
+static inline void name##_LL_END(ll_gcursor_t *c)                                  \
+{                                                                                  \
+    ll_gcursor_end_(c);                                                            \
+}                                                                                  \
+static inline bool name##_LL_CONTAINS(struct name *head, const struct type *elm)   \
+{                                                                                  \
+    ll_pin_t pin = ll_pin_(&head->ctl, &head->commit_id);                          \
+    uint64_t S = LL_LOAD_ACQUIRE_(&head->commit_id);                               \
+    ll_vnode_t *w =                                                                \
+        ll_vnode_(LL_LOAD_ACQUIRE_(&head->head));                                  \
+    while (w && !(w->user_elm == elm && ll_vnode_visible_(w, S)))                  \
+        w = ll_vnode_next_(w);                                                     \
+    ll_unpin_(&pin);                                                               \
+    return w != NULL;                                                              \
+}                                                                                  \
+static inline size_t name##_LL_SIZE(struct name *head)                             \
+{                                                                                  \
+    ll_pin_t pin = ll_pin_(&head->ctl, &head->commit_id);                          \
+    uint64_t S = LL_LOAD_ACQUIRE_(&head->commit_id);                               \
+    size_t n = 0;                                                                  \
+    ll_vnode_t *w =                                                                \
+        ll_vnode_(LL_LOAD_ACQUIRE_(&head->head));                                  \
+    for (; w; w = ll_vnode_next_(w))                                               \
+        n += ll_vnode_visible_(w, S);                                              \
+    ll_unpin_(&pin);                                                               \
+    return n;                                                                      \
+}                                                                                  \
+static inline struct type *name##_LL_FIND(struct name *head,                       \
+    int (*cmp)(const struct type *, const void *), const void *key)                \
+{                                                                                  \
+    ll_gcursor_t c;                                                                \
+    struct type *e = name##_LL_FIRST(head, &c);                                    \
+    while (e && cmp(e, key) != 0)                                                  \
+        e = name##_LL_NEXT(&c);                                                    \
+    ll_gcursor_end_(&c);                                                           \
+    return e;                                                                      \
+}                                                                                  \
+static inline void name##_LL_VISIT(struct name *head,                              \
+    void (*fn)(struct type *, void *), void *userdata)                             \
+{                                                                                  \
+    ll_gcursor_t c;                                                                \
+    for (struct type *e = name##_LL_FIRST(head, &c); e; e = name##_LL_NEXT(&c))    \
+        fn(e, userdata);                                                           \
+}                                                                                  \
+static inline ll_txn_t *name##_LL_TXN_START(struct name *head)                     \
+{                                                                                  \
+    return ll_txn_start_(&head->head, &head->commit_id, &head->ctl,                \
+                         (void (*)(void *))head->free_cb);                         \
+}                                                                                  \
+static inline void name##_LL_TXN_INSERT_HEAD(ll_txn_t *txn, struct type *elm)      \
+{                                                                                  \
+    ll_txn_insert_head_(txn, elm);                                                 \
+}                                                                                  \
+static inline void name##_LL_TXN_INSERT_TAIL(ll_txn_t *txn, struct type *elm)      \
+{                                                                                  \
+    ll_txn_insert_tail_(txn, elm);                                                 \
+}                                                                                  \
+static inline void name##_LL_TXN_INSERT_AFTER(ll_txn_t *txn,                       \
+    struct type *after_elm, struct type *elm)                                      \
+{                                                                                  \
+    ll_txn_insert_after_(txn, after_elm, elm);                                     \
+}                                                                                  \
+static inline void name##_LL_TXN_REMOVE(ll_txn_t *txn, struct type *elm)           \
+{                                                                                  \
+    ll_txn_remove_(txn, elm);                                                      \
+}                                                                                  \
+static inline bool name##_LL_TXN_CONTAINS(ll_txn_t *txn, const struct type *elm)   \
+{                                                                                  \
+    return ll_txn_contains_(txn, elm);                                             \
+}
+
+/*
+ * Inline traversal over a generated list type. Same snapshot semantics as
+ * LL_FOREACH, and left the same ways. A cursor driven by hand holds its
+ * pin until _LL_NEXT returns NULL or _LL_END is called.
+ */
+#define LL_GFOREACH(var, name, headp)                                         \
+    for (ll_gcursor_t _ll_gc LL_SCOPED_(name##_LL_END), *_ll_gcp = &_ll_gc; _ll_gcp; \
+         name##_LL_END(_ll_gcp), _ll_gcp = NULL)                              \
+        for ((var) = name##_LL_FIRST((headp), _ll_gcp); (var);                 \
+             (var) = name##_LL_NEXT(_ll_gcp))
 
 #ifdef __cplusplus
 }
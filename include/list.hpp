@@ -0,0 +1,365 @@
+/**
+ * Concurrent Linked List - C++17 wrapper (header-only)
+ *
+ * Typed, RAII front end over the C API in list.h:
+ *
+ *   struct item { int id; LL_ENTRY(item, link); };
+ *   ll::list<item, &item::link> items;
+ *   items.push_back(x);
+ *   for (item &it : items) ...             // one snapshot per begin()
+ *   {
+ *       auto t = items.begin_txn();
+ *       t.remove(x);
+ *       t.push_front(y);
+ *       t.commit();                        // dropped without commit: rollback
+ *   }
+ *
+ * Every member is an inline forward to the same internal calls the C macros
+ * expand to, and the link member pointer is only used at compile time, so a
+ * wrapped list compiles to the same code as hand-written C. The list does not
+ * own its elements: as with the C API, you allocate them, and removed
+ * elements are handed to the disposer (if any) once no reader can see them.
+ * The memory the list allocates itself (wrappers, transactions) can come
+ * from a std::pmr::memory_resource.
+ */
+
+#ifndef LIST_HPP
+#define LIST_HPP
+
+#include "list.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory_resource>
+#include <type_traits>
+#include <utility>
+
+namespace ll {
+
+namespace detail {
+struct elm;
+/* Untyped head with the exact layout LL_HEAD produces, so the C macros apply. */
+LL_HEAD(head, elm);
+}
+
+template <class T, ll_atomic_uintptr_t T::*Link>
+class list;
+
+/**
+ * Move-only transaction over an ll::list. Rolls back in its destructor unless
+ * commit() or rollback() was called. An empty txn (allocation failure, or
+ * moved from) converts to false.
+ */
+template <class T, ll_atomic_uintptr_t T::*Link>
+class txn {
+public:
+    txn() noexcept : t_(nullptr) {}
+    txn(txn &&o) noexcept : t_(std::exchange(o.t_, nullptr)) {}
+    txn &operator=(txn &&o) noexcept
+    {
+        if (this != &o) {
+            rollback();
+            t_ = std::exchange(o.t_, nullptr);
+        }
+        return *this;
+    }
+    txn(const txn &) = delete;
+    txn &operator=(const txn &) = delete;
+    ~txn() { rollback(); }
+
+    explicit operator bool() const noexcept { return t_ != nullptr; }
+    /** True once the snapshot lease ran out (see LL_SET_SNAPSHOT_LEASE). */
+    bool expired() const noexcept { return t_ && ll_txn_status(t_) == LL_TXN_EXPIRED; }
+    ll_txn_t *native() const noexcept { return t_; }
+
+    void push_front(T &e) { LL_TXN_INSERT_HEAD(t_, &e, link); }
+    void push_back(T &e) { LL_TXN_INSERT_TAIL(t_, &e, link); }
+    void insert_after(T &anchor, T &e) { LL_TXN_INSERT_AFTER(t_, &anchor, &e, link); }
+    void remove(T &e) { LL_TXN_REMOVE(t_, &e, link); }
+    bool contains(const T &e) const { return LL_TXN_CONTAINS(t_, &e, link); }
+
+    /** Forward iterator over the transaction view (see ll_txn_iter_t). */
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T *;
+        using reference = T &;
+
+        iterator() noexcept : it_() {}
+
+        reference operator*() const noexcept { return *cur(); }
+        pointer operator->() const noexcept { return cur(); }
+        iterator &operator++()
+        {
+            ll_txn_iter_next(&it_);
+            return *this;
+        }
+        iterator operator++(int)
+        {
+            iterator old = *this;
+            ++*this;
+            return old;
+        }
+        friend bool operator==(const iterator &a, const iterator &b) noexcept
+        {
+            return a.cur() == b.cur();
+        }
+        friend bool operator!=(const iterator &a, const iterator &b) noexcept
+        {
+            return a.cur() != b.cur();
+        }
+
+    private:
+        friend class txn;
+        explicit iterator(ll_txn_t *t) : it_() { ll_txn_iter_begin(&it_, t); }
+        T *cur() const noexcept { return static_cast<T *>(it_.cur); }
+
+        ll_txn_iter_t it_;
+    };
+
+    iterator begin() const { return iterator(t_); }
+    iterator end() const noexcept { return iterator(); }
+
+    /** Call f(T &) for each element of the transaction view, in order. */
+    template <class F>
+    void for_each(F &&f) const
+    {
+        LL_TXN_FOREACH(t_, &visit_<std::remove_reference_t<F>>, (void *)&f);
+    }
+
+    /**
+     * Apply the buffered changes. Returns 0 on success, -1 on an empty txn,
+     * LL_TXN_EXPIRED if the snapshot lease ran out (nothing is applied).
+     */
+    int commit()
+    {
+        if (!t_)
+            return -1;
+        return ll_txn_commit(std::exchange(t_, nullptr));
+    }
+
+    void rollback() noexcept
+    {
+        if (t_)
+            ll_txn_rollback(std::exchange(t_, nullptr));
+    }
+
+private:
+    friend class list<T, Link>;
+    explicit txn(ll_txn_t *t) noexcept : t_(t) {}
+
+    template <class F>
+    static void visit_(void *e, void *f)
+    {
+        (*static_cast<F *>(f))(*static_cast<T *>(e));
+    }
+
+    ll_txn_t *t_;
+};
+
+/**
+ * Lock-free list of T linked through the LL_ENTRY member Link. Neither
+ * copyable nor movable: other threads hold its address.
+ */
+template <class T, ll_atomic_uintptr_t T::*Link>
+class list {
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using reference = T &;
+    using txn_type = ll::txn<T, Link>;
+
+    /**
+     * Forward iterator over the snapshot taken by begin(). Iterators compare
+     * equal when they stand on the same element; end() is past the last.
+     * The iterator begin() returns holds the walk's read pin until it
+     * reaches end() or is destroyed; copies share that pin and must not
+     * outlive it.
+     */
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T *;
+        using reference = T &;
+
+        iterator() noexcept : it_(), cur_(nullptr) {}
+        iterator(const iterator &o) noexcept : it_(o.it_), cur_(o.cur_) { it_.pin.slot = nullptr; }
+        iterator(iterator &&o) noexcept : it_(o.it_), cur_(o.cur_) { o.it_.pin.slot = nullptr; }
+        iterator &operator=(const iterator &o) noexcept
+        {
+            if (this != &o) {
+                ll_iter_end(&it_);
+                it_ = o.it_;
+                it_.pin.slot = nullptr;
+                cur_ = o.cur_;
+            }
+            return *this;
+        }
+        iterator &operator=(iterator &&o) noexcept
+        {
+            if (this != &o) {
+                ll_iter_end(&it_);
+                it_ = o.it_;
+                o.it_.pin.slot = nullptr;
+                cur_ = o.cur_;
+            }
+            return *this;
+        }
+        ~iterator() { ll_unpin_(&it_.pin); }
+
+        reference operator*() const noexcept { return *cur_; }
+        pointer operator->() const noexcept { return cur_; }
+        iterator &operator++()
+        {
+            ll_iter_next(&it_);
+            settle_();
+            return *this;
+        }
+        iterator operator++(int)
+        {
+            iterator old = *this;
+            ++*this;
+            return old;
+        }
+        friend bool operator==(const iterator &a, const iterator &b) noexcept
+        {
+            return a.cur_ == b.cur_;
+        }
+        friend bool operator!=(const iterator &a, const iterator &b) noexcept
+        {
+            return a.cur_ != b.cur_;
+        }
+
+    private:
+        friend class list;
+        explicit iterator(detail::head *h) : it_()
+        {
+            ll_iter_begin(&it_, &h->head, &h->commit_id, &h->ctl);
+            settle_();
+        }
+        /* ll_iter_get is NULL exactly when the iterator is exhausted. */
+        void settle_() { cur_ = static_cast<T *>(ll_iter_get(&it_)); }
+
+        ll_iter_t it_;
+        T *cur_;
+    };
+    using const_iterator = iterator;
+
+    list() noexcept
+    {
+        detail::head *h = native();
+        LL_INIT(h);
+    }
+    /**
+     * Allocate the list's node wrappers, transactions and write-set buffers
+     * from "mr", which must outlive the list.
+     */
+    explicit list(std::pmr::memory_resource *mr) noexcept : list()
+    {
+        LL_SET_ALLOCATOR(native(), &pmr_alloc_, &pmr_free_, mr);
+    }
+    list(const list &) = delete;
+    list &operator=(const list &) = delete;
+
+    /** Called with each element removed by remove() once it is safe to free. */
+    void set_disposer(void (*fn)(T *)) noexcept
+    {
+        h_.free_cb = reinterpret_cast<void (*)(detail::elm *)>(fn);
+    }
+
+    /**
+     * Hand removed elements to fn in batches instead of to the disposer,
+     * optionally on the deferred-free thread (see LL_SET_FREE_BATCH).
+     */
+    void set_batch_disposer(ll_free_batch_fn fn, bool deferred = false) noexcept
+    {
+        LL_SET_FREE_BATCH(native(), fn, deferred);
+    }
+
+    /** Store-free plain reads, reclaimed at quiescent states (see LL_SET_QSBR). */
+    void set_qsbr(bool on) noexcept { LL_SET_QSBR(native(), on); }
+
+    /** LL_SINGLE_WRITER or LL_SINGLE_THREADED fast paths (see LL_SET_THREADING); call before sharing. */
+    void set_threading(int mode) noexcept { LL_SET_THREADING(native(), mode); }
+
+    /** Reclaim in "domain" instead of the default one (see LL_SET_DOMAIN); call before sharing. */
+    void set_domain(ll_domain_t *domain) noexcept { LL_SET_DOMAIN(native(), domain); }
+
+    /** Batch concurrent commits on this list (see LL_SET_GROUP_COMMIT). */
+    void set_group_commit(bool on) noexcept { LL_SET_GROUP_COMMIT(native(), on); }
+
+    /** Limit how long a transaction's snapshot holds back reclaim (see LL_SET_SNAPSHOT_LEASE). */
+    void set_snapshot_lease(std::uint64_t lease_us) noexcept { LL_SET_SNAPSHOT_LEASE(native(), lease_us); }
+
+    /** Bound the removed nodes awaiting reclaim (see LL_SET_GARBAGE_LIMIT). */
+    void set_garbage_limit(size_type nodes, unsigned max_wait_us = 0) noexcept
+    {
+        LL_SET_GARBAGE_LIMIT(native(), nodes, max_wait_us);
+    }
+    ll_garbage_stats_t garbage_stats() const noexcept
+    {
+        ll_garbage_stats_t st;
+        LL_GARBAGE_STATS(native(), &st);
+        return st;
+    }
+
+    void push_front(T &e) { LL_INSERT_HEAD(native(), &e, link); }
+    void push_back(T &e) { LL_INSERT_TAIL(native(), &e, link); }
+    /** No-op if anchor is not in the list. */
+    void insert_after(T &anchor, T &e) { LL_INSERT_AFTER(native(), &anchor, &e, link); }
+    /** Returns the old head, or nullptr if empty; the caller owns it. */
+    T *pop_front() { return LL_REMOVE_HEAD(native(), T, link); }
+    /**
+     * Keep the list sorted by cmp, as a priority queue (see LL_SET_ORDER);
+     * call before sharing. Use push() and pop_min() on it.
+     */
+    void set_order(int (*cmp)(const T *, const T *)) noexcept
+    {
+        LL_SET_ORDER(native(), reinterpret_cast<ll_order_fn>(cmp));
+    }
+    /** Let pop_min() take any of the first "width" elements (see LL_SET_RELAXED_MIN). */
+    void set_relaxed_min(unsigned width) noexcept { LL_SET_RELAXED_MIN(native(), width); }
+    void push(T &e) { LL_INSERT_ORDERED(native(), &e, link); }
+    /** Returns the least element, or nullptr if empty; the caller owns it. */
+    T *pop_min() { return LL_REMOVE_MIN(native(), T, link); }
+    /** Returns true if e was found and removed. */
+    bool remove(T &e) { return LL_REMOVE(native(), &e, link) == 0; }
+
+    bool contains(const T &e) const { return LL_CONTAINS(native(), &e, link); }
+    bool empty() const { return LL_IS_EMPTY(native()); }
+    size_type size() const { return LL_SIZE(native(), T, link); }
+
+    iterator begin() const { return iterator(native()); }
+    iterator end() const noexcept { return iterator(); }
+
+    /** Start a transaction; the result is empty on allocation failure. */
+    txn_type begin_txn() { return txn_type(LL_TXN_START(native(), T, link)); }
+
+    /** The underlying head, for mixing with the C macros. */
+    detail::head *native() const noexcept { return &h_; }
+
+private:
+    static void *pmr_alloc_(std::size_t size, std::size_t align, void *mr) noexcept
+    {
+        try {
+            return static_cast<std::pmr::memory_resource *>(mr)->allocate(size, align);
+        } catch (...) {
+            return nullptr;
+        }
+    }
+    static void pmr_free_(void *p, std::size_t size, std::size_t align, void *mr) noexcept
+    {
+        static_cast<std::pmr::memory_resource *>(mr)->deallocate(p, size, align);
+    }
+
+    mutable detail::head h_;
+};
+
+} // namespace ll
+
+#endif /* LIST_HPP */
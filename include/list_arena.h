@@ -0,0 +1,143 @@
+/**
+ * Concurrent Linked List - File-backed arena (persistent list)
+ *
+ * The whole list lives in one memory-mapped file: the head, the commit id,
+ * the versioned nodes and the user payloads. Links are arena-relative
+ * offsets instead of raw pointers, so the file can be mapped at any address
+ * and reopened later without rebuilding the list.
+ *
+ * Reopening after ll_arena_close() is O(1): the header carries a clean
+ * shutdown marker. If the marker is missing (crash, kill -9), open runs a
+ * bounded validation scan over the allocated region: broken links are cut,
+ * half-finished unlinks are completed lazily, and free lists are rebuilt.
+ *
+ * Payloads are allocated from the arena with ll_arena_alloc() (or
+ * LL_ARENA_NEW) and are what you insert. Snapshot visibility follows the
+ * in-memory list: a node is visible at S iff insert_txn_id <= S and
+ * (removed_txn_id == 0 || removed_txn_id > S).
+ *
+ * Several processes may attach the same arena (a shared file, or a POSIX
+ * shared-memory object via ll_arena_shm_open) and exchange elements with the
+ * same lock-free operations; no syscalls are made on the data path. Each
+ * process registers itself on open, and the reader slots and locks of a
+ * process that dies are reaped by the survivors. A thread gives its reader
+ * slots back when it exits.
+ *
+ * Capacity is fixed at creation; the mapping never moves.
+ */
+
+#ifndef LIST_ARENA_H
+#define LIST_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ll_arena ll_arena_t;
+
+/** Callback for LL_ARENA_FOREACH: (payload, userdata). */
+typedef void (*ll_arena_foreach_fn)(void *elm, void *userdata);
+
+/**
+ * Open (or create) a file-backed arena. "size" is the capacity used when the
+ * file does not exist yet; an existing file keeps its own size. Returns NULL
+ * and sets errno on failure (EINVAL for a file that is not an arena, EAGAIN
+ * when too many processes are attached).
+ */
+ll_arena_t *ll_arena_open(const char *path, size_t size);
+
+/**
+ * Same as ll_arena_open, but backed by the POSIX shared-memory object "name"
+ * (e.g. "/jobs"). The first process creates it with "size"; later ones
+ * attach. The object outlives its users until ll_arena_shm_unlink.
+ */
+ll_arena_t *ll_arena_shm_open(const char *name, size_t size);
+int ll_arena_shm_unlink(const char *name);
+
+/**
+ * Detach this handle and give back the reader slots its threads took.
+ * Other handles on the same arena, in this process or others, keep
+ * theirs. The last process to detach reclaims, flushes the mapping and
+ * marks it clean so the next open is O(1). Returns 0 on success, -1
+ * (errno set) otherwise: EBUSY, with nothing closed, while a walk through
+ * this handle (a foreach, or a read on another thread) is still running.
+ */
+int ll_arena_close(ll_arena_t *a);
+
+/** Flush the mapping to the backing file (msync). */
+int ll_arena_sync(ll_arena_t *a);
+
+/** True if open had to run the crash-recovery scan. */
+bool ll_arena_recovered(const ll_arena_t *a);
+
+/**
+ * Allocate a payload of "size" bytes (16-byte aligned, zeroed) in the arena.
+ * Returns NULL when the arena is full.
+ */
+void *ll_arena_alloc(ll_arena_t *a, size_t size);
+
+/**
+ * Free a payload that is not in the list (never inserted, or returned by
+ * ll_arena_remove_head). Payloads removed with ll_arena_remove are freed by
+ * the arena itself once no reader can see them.
+ */
+void ll_arena_free(ll_arena_t *a, void *elm);
+
+/** Convert between pointers into the mapping and arena-relative offsets. */
+uint64_t ll_arena_off(const ll_arena_t *a, const void *p);
+void *ll_arena_ptr(const ll_arena_t *a, uint64_t off);
+
+/**
+ * One user-defined root pointer persisted in the header, e.g. to find
+ * application metadata again after reopening. NULL clears it.
+ */
+void ll_arena_set_root(ll_arena_t *a, void *p);
+void *ll_arena_root(const ll_arena_t *a);
+
+/* List operations; "elm" must come from ll_arena_alloc on the same arena. */
+int ll_arena_insert_head(ll_arena_t *a, void *elm);
+int ll_arena_insert_tail(ll_arena_t *a, void *elm);
+int ll_arena_insert_after(ll_arena_t *a, void *after_elm, void *elm);
+/*
+ * remove_head takes the first element visible at the commit id current on
+ * entry. It returns NULL if every element left was inserted after that,
+ * so a racing insert can leave the list non-empty after a NULL return.
+ */
+void *ll_arena_remove_head(ll_arena_t *a);
+int ll_arena_remove(ll_arena_t *a, void *elm);
+bool ll_arena_contains(ll_arena_t *a, const void *elm);
+size_t ll_arena_size(ll_arena_t *a);
+void ll_arena_foreach(ll_arena_t *a, ll_arena_foreach_fn cb, void *userdata);
+
+/**
+ * Unlink nodes no snapshot can see and free those no reader still holds.
+ * Runs automatically every so many removals and on close. An explicit
+ * call that finds nodes held back also reaps the slots of dead processes;
+ * the automatic passes do that at most every 100 ms. Returns the number of
+ * nodes unlinked.
+ */
+size_t ll_arena_reclaim(ll_arena_t *a);
+
+/*
+ * Typed helpers in the style of the in-memory list macros.
+ * Example: struct item *p = LL_ARENA_NEW(a, struct item);
+ */
+#define LL_ARENA_NEW(a, type)            ((type *)ll_arena_alloc((a), sizeof(type)))
+#define LL_ARENA_INSERT_HEAD(a, elm)     ll_arena_insert_head((a), (void *)(elm))
+#define LL_ARENA_INSERT_TAIL(a, elm)     ll_arena_insert_tail((a), (void *)(elm))
+#define LL_ARENA_INSERT_AFTER(a, after_elm, elm) \
+    ll_arena_insert_after((a), (void *)(after_elm), (void *)(elm))
+#define LL_ARENA_REMOVE_HEAD(a, type)    ((type *)ll_arena_remove_head(a))
+#define LL_ARENA_REMOVE(a, elm)          ll_arena_remove((a), (void *)(elm))
+#define LL_ARENA_CONTAINS(a, elm)        ll_arena_contains((a), (const void *)(elm))
+#define LL_ARENA_FOREACH(a, cb, userdata) ll_arena_foreach((a), (cb), (userdata))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIST_ARENA_H */
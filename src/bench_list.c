@@ -0,0 +1,663 @@
+/**
+ * Micro-benchmarks for the concurrent linked list.
+ * Usage: bench_list [elements] [rounds]
+ * Each figure is the time of one whole operation (e.g. one full traversal).
+ * Built twice: bench_list calls into the library, bench_list_header_only
+ * defines LIST_HEADER_ONLY so the read fast paths are inlined.
+ */
+#include "list.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+struct item {
+    int value;
+    LL_ENTRY(item, link);
+};
+LL_HEAD(list_head, item);
+LL_GENERATE(list_head, item, link)
+
+#ifdef LIST_HEADER_ONLY
+#define BENCH_MODE "LIST_HEADER_ONLY (inline fast paths)"
+#else
+#define BENCH_MODE "library calls"
+#endif
+
+static volatile long sink;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void report(const char *label, double ns, long ops)
+{
+    printf("  %-40s %12.1f ns/op\n", label, ns / (double)ops);
+}
+
+static int item_cmp_value(const struct item *e, const void *key)
+{
+    return e->value != *(const int *)key;
+}
+
+static void bench_call_overhead(struct list_head *lst, int rounds)
+{
+    printf("Call overhead, one-element list\n");
+    long ops = (long)rounds * 100;
+    double t;
+    long acc = 0;
+
+    t = now_ns();
+    for (long r = 0; r < ops; r++)
+        acc += LL_IS_EMPTY(lst);
+    report("LL_IS_EMPTY", now_ns() - t, ops);
+
+    struct item *var;
+    t = now_ns();
+    for (long r = 0; r < ops; r++)
+        LL_FOREACH(var, lst, struct item, link)
+            acc += var->value;
+    report("LL_FOREACH (begin/has/get/next)", now_ns() - t, ops);
+
+    sink = acc;
+}
+
+static void bench_generated(struct list_head *lst, struct item *last, int n, int rounds)
+{
+    printf("Read paths over %d elements: out-of-line vs LL_GENERATE\n", n);
+    double t;
+    long acc = 0;
+
+    t = now_ns();
+    for (int r = 0; r < rounds; r++)
+        acc += LL_CONTAINS(lst, last, link);
+    report("LL_CONTAINS (last element)", now_ns() - t, rounds);
+    t = now_ns();
+    for (int r = 0; r < rounds; r++)
+        acc += list_head_LL_CONTAINS(lst, last);
+    report("list_head_LL_CONTAINS", now_ns() - t, rounds);
+
+    t = now_ns();
+    for (int r = 0; r < rounds; r++)
+        acc += (long)LL_SIZE(lst, struct item, link);
+    report("LL_SIZE", now_ns() - t, rounds);
+    t = now_ns();
+    for (int r = 0; r < rounds; r++)
+        acc += (long)list_head_LL_SIZE(lst);
+    report("list_head_LL_SIZE", now_ns() - t, rounds);
+
+    struct item *var;
+    t = now_ns();
+    for (int r = 0; r < rounds; r++)
+        LL_FOREACH(var, lst, struct item, link)
+            acc += var->value;
+    report("LL_FOREACH (sum)", now_ns() - t, rounds);
+    t = now_ns();
+    for (int r = 0; r < rounds; r++)
+        LL_GFOREACH(var, list_head, lst)
+            acc += var->value;
+    report("LL_GFOREACH (sum)", now_ns() - t, rounds);
+
+    int key = last->value;
+    t = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        LL_FOREACH(var, lst, struct item, link)
+            if (item_cmp_value(var, &key) == 0)
+                break;
+        acc += var ? var->value : 0;
+    }
+    report("find by value via LL_FOREACH", now_ns() - t, rounds);
+    t = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        var = list_head_LL_FIND(lst, item_cmp_value, &key);
+        acc += var ? var->value : 0;
+    }
+    report("list_head_LL_FIND", now_ns() - t, rounds);
+
+    sink = acc;
+}
+
+static void count_cb(void *elm, void *userdata)
+{
+    (void)elm;
+    (*(long *)userdata)++;
+}
+
+static void bench_txn_view(struct list_head *lst, int n, int rounds)
+{
+    printf("Transaction view walk over %d elements\n", n);
+    ll_txn_t *txn = LL_TXN_START(lst, struct item, link);
+    if (!txn)
+        return;
+    long acc = 0;
+    double t = now_ns();
+    for (int r = 0; r < rounds; r++)
+        LL_TXN_FOREACH(txn, count_cb, &acc);
+    report("LL_TXN_FOREACH, no changes", now_ns() - t, rounds);
+
+    t = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        struct item *var;
+        LL_TXN_FOREACH_ITER(var, txn, struct item)
+            acc++;
+    }
+    report("LL_TXN_FOREACH_ITER, no changes", now_ns() - t, rounds);
+
+    /* First match near the front: the cursor stops, the callback cannot. */
+    int key = n / 10;
+    t = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        struct item *var;
+        LL_TXN_FOREACH_ITER(var, txn, struct item)
+            if (var->value == key)
+                break;
+        acc += var ? var->value : 0;
+    }
+    report("find n/10 via LL_TXN_FOREACH_ITER", now_ns() - t, rounds);
+
+    int i = 0;
+    struct item *var;
+    LL_FOREACH(var, lst, struct item, link)
+        if (i++ % 2)
+            LL_TXN_REMOVE(txn, var, link);
+    t = now_ns();
+    for (int r = 0; r < rounds; r++)
+        LL_TXN_FOREACH(txn, count_cb, &acc);
+    report("LL_TXN_FOREACH, half removed", now_ns() - t, rounds);
+    ll_txn_rollback(txn);
+    sink = acc;
+}
+
+static void sum_cb(void *elm, void *userdata)
+{
+    *(long *)userdata += ((struct item *)elm)->value;
+}
+
+static void sum_identity(void *acc, void *userdata)
+{
+    (void)userdata;
+    *(long *)acc = 0;
+}
+
+static void sum_map(void *acc, const void *elm, void *userdata)
+{
+    (void)userdata;
+    *(long *)acc += ((const struct item *)elm)->value;
+}
+
+static void sum_combine(void *acc, const void *other, void *userdata)
+{
+    (void)userdata;
+    *(long *)acc += *(const long *)other;
+}
+
+static void bench_reduce(struct list_head *lst, int n, int rounds)
+{
+    static const ll_reduce_ops_t sum_ops = { sizeof(long), sum_identity, sum_map, sum_combine };
+    printf("Sum at a snapshot over %d elements\n", n);
+    long acc = 0;
+    double t = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        ll_txn_t *txn = LL_TXN_START(lst, struct item, link);
+        if (!txn)
+            return;
+        LL_TXN_FOREACH(txn, sum_cb, &acc);
+        ll_txn_rollback(txn);
+    }
+    report("LL_TXN_START + LL_TXN_FOREACH", now_ns() - t, rounds);
+    long sum;
+    t = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        LL_SNAPSHOT_REDUCE(lst, 1, &sum_ops, &sum, NULL);
+        acc += sum;
+    }
+    report("LL_SNAPSHOT_REDUCE", now_ns() - t, rounds);
+    sink = acc;
+}
+
+static void bench_to_array(struct list_head *lst, int n, int rounds)
+{
+    printf("Copy a snapshot into an array of %d pointers\n", n);
+    long acc = 0;
+    double t = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        struct item **arr = NULL, *var;
+        size_t len = 0, cap = 0;
+        LL_FOREACH(var, lst, struct item, link) {
+            if (len == cap) {
+                cap = cap ? cap * 2 : 16;
+                struct item **p = realloc(arr, cap * sizeof(*arr));
+                if (!p)
+                    break;
+                arr = p;
+            }
+            arr[len++] = var;
+        }
+        acc += (long)len;
+        free(arr);
+    }
+    report("LL_FOREACH into a growing array", now_ns() - t, rounds);
+    t = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        struct item **arr;
+        size_t len;
+        LL_SNAPSHOT_TO_ARRAY(lst, 0, &arr, &len);
+        acc += (long)len;
+        free(arr);
+    }
+    report("LL_SNAPSHOT_TO_ARRAY", now_ns() - t, rounds);
+    sink = acc;
+}
+
+/*
+ * Single-threaded free-list pool of 256-byte blocks, plugged in with
+ * LL_SET_ALLOCATOR to compare against the C library allocator.
+ */
+#define POOL_BLOCK 256
+
+struct pool { void *free; };
+
+static void *pool_alloc(size_t size, size_t align, void *ctx)
+{
+    struct pool *p = ctx;
+    if (size > POOL_BLOCK || align > 16)
+        return aligned_alloc(align, (size + align - 1) / align * align);
+    if (p->free) {
+        void *b = p->free;
+        p->free = *(void **)b;
+        return b;
+    }
+    return aligned_alloc(16, POOL_BLOCK);
+}
+
+static void pool_free(void *b, size_t size, size_t align, void *ctx)
+{
+    struct pool *p = ctx;
+    if (size > POOL_BLOCK || align > 16) {
+        free(b);
+        return;
+    }
+    *(void **)b = p->free;
+    p->free = b;
+}
+
+static void pool_drain(struct pool *p)
+{
+    while (p->free) {
+        void *b = p->free;
+        p->free = *(void **)b;
+        free(b);
+    }
+}
+
+static void bench_allocator_churn(struct list_head *lst, const char *label, int rounds)
+{
+    struct item x = { 0, 0 };
+    char buf[64];
+    double t;
+    long ops = (long)rounds * 10;
+
+    t = now_ns();
+    for (long r = 0; r < ops; r++) {
+        LL_INSERT_HEAD(lst, &x, link);
+        LL_REMOVE_HEAD(lst, struct item, link);
+    }
+    snprintf(buf, sizeof(buf), "insert + remove_head (%s)", label);
+    report(buf, now_ns() - t, ops);
+
+    t = now_ns();
+    for (long r = 0; r < ops; r++) {
+        ll_txn_t *txn = LL_TXN_START(lst, struct item, link);
+        LL_TXN_INSERT_HEAD(txn, &x, link);
+        ll_txn_commit(txn);
+        LL_REMOVE_HEAD(lst, struct item, link);
+    }
+    snprintf(buf, sizeof(buf), "1-op txn + remove_head (%s)", label);
+    report(buf, now_ns() - t, ops);
+}
+
+static void bench_allocators(int rounds)
+{
+    printf("Allocator hooks: C library vs free-list pool\n");
+    struct list_head lst;
+    struct list_head *lst_p = &lst;
+    LL_INIT(lst_p);
+    bench_allocator_churn(lst_p, "libc", rounds);
+
+    struct pool pool = { NULL };
+    LL_INIT(lst_p);
+    LL_SET_ALLOCATOR(lst_p, pool_alloc, pool_free, &pool);
+    bench_allocator_churn(lst_p, "pool", rounds);
+    pool_drain(&pool);
+}
+
+static void bench_threading(int rounds)
+{
+    static const struct { int mode; const char *name; } modes[] = {
+        { LL_MULTI_WRITER, "multi-writer" },
+        { LL_SINGLE_WRITER, "single-writer" },
+        { LL_SINGLE_THREADED, "single-threaded" },
+    };
+    printf("Plain operations by threading mode (LL_SET_THREADING)\n");
+    struct item x = { 0, 0 }, y = { 1, 0 };
+    long ops = (long)rounds * 10;
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        struct list_head lst;
+        struct list_head *lst_p = &lst;
+        LL_INIT(lst_p);
+        LL_SET_THREADING(lst_p, modes[m].mode);
+        char buf[64];
+        double t = now_ns();
+        for (long r = 0; r < ops; r++) {
+            LL_INSERT_HEAD(lst_p, &x, link);
+            LL_REMOVE_HEAD(lst_p, struct item, link);
+        }
+        snprintf(buf, sizeof(buf), "insert + remove_head (%s)", modes[m].name);
+        report(buf, now_ns() - t, ops);
+
+        LL_INSERT_HEAD(lst_p, &x, link);
+        t = now_ns();
+        for (long r = 0; r < ops; r++) {
+            LL_INSERT_AFTER(lst_p, &x, &y, link);
+            LL_REMOVE(lst_p, &y, link);
+        }
+        snprintf(buf, sizeof(buf), "insert_after + remove (%s)", modes[m].name);
+        report(buf, now_ns() - t, ops);
+        while (LL_REMOVE_HEAD(lst_p, struct item, link))
+            ;
+        ll_txn_commit(LL_TXN_START(lst_p, struct item, link));
+    }
+}
+
+/* One committer: each txn pushes its next element and removes its previous one. */
+struct committer {
+    struct list_head *lst;
+    struct item *elems;
+    int n;
+};
+
+static void *commit_worker(void *arg)
+{
+    struct committer *c = arg;
+    for (int k = 0; k < c->n; k++) {
+        ll_txn_t *txn = LL_TXN_START(c->lst, struct item, link);
+        if (!txn)
+            continue;
+        LL_TXN_INSERT_HEAD(txn, &c->elems[k], link);
+        if (k > 0)
+            LL_TXN_REMOVE(txn, &c->elems[k - 1], link);
+        ll_txn_commit(txn);
+    }
+    return NULL;
+}
+
+static void bench_commit_scaling(int rounds)
+{
+    enum { MAX_COMMITTERS = 8 };
+    printf("Concurrent small commits: per-commit vs LL_SET_GROUP_COMMIT (total throughput)\n");
+    struct item *elems = malloc(sizeof(*elems) * (size_t)rounds * MAX_COMMITTERS);
+    if (!elems)
+        return;
+    for (int group = 0; group < 2; group++) {
+        for (int threads = 1; threads <= MAX_COMMITTERS; threads *= 2) {
+            struct list_head lst;
+            struct list_head *lst_p = &lst;
+            LL_INIT(lst_p);
+            LL_SET_GROUP_COMMIT(lst_p, group);
+            pthread_t th[MAX_COMMITTERS];
+            struct committer c[MAX_COMMITTERS];
+            double t = now_ns();
+            for (int i = 0; i < threads; i++) {
+                c[i] = (struct committer){ lst_p, elems + (size_t)i * rounds, rounds };
+                pthread_create(&th[i], NULL, commit_worker, &c[i]);
+            }
+            for (int i = 0; i < threads; i++)
+                pthread_join(th[i], NULL);
+            t = now_ns() - t;
+            char buf[64];
+            snprintf(buf, sizeof(buf), "%s, %d thread%s", group ? "group commit" : "per-commit",
+                     threads, threads > 1 ? "s" : "");
+            printf("  %-40s %12.0f commits/s\n", buf, (double)rounds * threads / (t / 1e9));
+            while (LL_REMOVE_HEAD(lst_p, struct item, link))
+                ;
+        }
+    }
+    free(elems);
+}
+
+static int item_order(const struct item *a, const struct item *b)
+{
+    return (a->value > b->value) - (a->value < b->value);
+}
+
+/* One priority-queue user: push its elements in a scrambled order, popping one per push. */
+static void *pq_worker(void *arg)
+{
+    struct committer *c = arg;
+    for (int k = 0; k < c->n; k++) {
+        LL_INSERT_ORDERED(c->lst, &c->elems[k], link);
+        LL_REMOVE_MIN(c->lst, struct item, link);
+    }
+    return NULL;
+}
+
+static void bench_pq_scaling(int rounds)
+{
+    enum { MAX_THREADS = 8 };
+    printf("Priority queue push + pop-min: strict vs LL_SET_RELAXED_MIN (total throughput)\n");
+    struct item *elems = malloc(sizeof(*elems) * (size_t)rounds * MAX_THREADS);
+    if (!elems)
+        return;
+    for (int i = 0; i < rounds * MAX_THREADS; i++)
+        elems[i].value = (int)(((unsigned)i * 2654435761u) >> 8);
+    for (int relaxed = 0; relaxed < 2; relaxed++) {
+        for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+            struct list_head lst;
+            struct list_head *lst_p = &lst;
+            LL_INIT(lst_p);
+            LL_SET_ORDER(lst_p, item_order);
+            LL_SET_RELAXED_MIN(lst_p, relaxed ? (unsigned)threads * 4 : 0);
+            /* A standing backlog so pops have somewhere to spread. */
+            struct item base[64];
+            for (int i = 0; i < 64; i++) {
+                base[i].value = i << 20;
+                LL_INSERT_ORDERED(lst_p, &base[i], link);
+            }
+            pthread_t th[MAX_THREADS];
+            struct committer c[MAX_THREADS];
+            double t = now_ns();
+            for (int i = 0; i < threads; i++) {
+                c[i] = (struct committer){ lst_p, elems + (size_t)i * rounds, rounds };
+                pthread_create(&th[i], NULL, pq_worker, &c[i]);
+            }
+            for (int i = 0; i < threads; i++)
+                pthread_join(th[i], NULL);
+            t = now_ns() - t;
+            char buf[64];
+            snprintf(buf, sizeof(buf), "%s, %d thread%s", relaxed ? "relaxed" : "strict",
+                     threads, threads > 1 ? "s" : "");
+            printf("  %-40s %12.0f ops/s\n", buf, (double)rounds * threads / (t / 1e9));
+            while (LL_REMOVE_MIN(lst_p, struct item, link))
+                ;
+            ll_txn_commit(LL_TXN_START(lst_p, struct item, link));
+        }
+    }
+    free(elems);
+}
+
+/* About 50ns of work per element, like a filter or a checksum would be. */
+static void scan_cb(void *elm, void *userdata)
+{
+    uint64_t h = (uint64_t)((struct item *)elm)->value;
+    for (int i = 0; i < 16; i++)
+        h = h * 6364136223846793005u + 1442695040888963407u;
+    if (h == 0)
+        ++*(volatile long *)userdata;
+}
+
+static void bench_parallel_scan(void)
+{
+    enum { N = 1 << 18, MAX_THREADS = 8 };
+    printf("Full scan with per-element work: LL_PARALLEL_CALLBACKS (%d elements)\n", N);
+    struct item *elems = malloc(sizeof(*elems) * N);
+    if (!elems)
+        return;
+    struct list_head lst;
+    struct list_head *lst_p = &lst;
+    LL_INIT(lst_p);
+    for (int i = N - 1; i >= 0; i--) {
+        elems[i].value = i;
+        LL_INSERT_HEAD(lst_p, &elems[i], link);
+    }
+    long hits = 0;
+    for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+        double t = now_ns();
+        LL_PARALLEL_CALLBACKS(lst_p, threads, scan_cb, &hits);
+        t = now_ns() - t;
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%d thread%s", threads, threads > 1 ? "s" : "");
+        printf("  %-40s %12.2f ms\n", buf, t / 1e6);
+    }
+    sink += hits;
+    while (LL_REMOVE_HEAD(lst_p, struct item, link))
+        ;
+    ll_txn_commit(LL_TXN_START(lst_p, struct item, link));
+    free(elems);
+}
+
+/*
+ * Task scheduling: every worker pushes a task and takes one back, either
+ * through one shared list or through its own deque, stealing from the
+ * others when its deque is empty.
+ */
+enum { SCHED_MAX_THREADS = 8 };
+static ll_wsdeque_t sched_dq[SCHED_MAX_THREADS];
+
+struct sched_worker {
+    struct committer c;
+    int id, threads;
+};
+
+static void *shared_list_worker(void *arg)
+{
+    struct sched_worker *w = arg;
+    for (int k = 0; k < w->c.n; k++) {
+        LL_INSERT_HEAD(w->c.lst, &w->c.elems[k], link);
+        struct item *e = LL_REMOVE_HEAD(w->c.lst, struct item, link);
+        if (e)
+            sink += e->value;
+    }
+    return NULL;
+}
+
+static void *deque_worker(void *arg)
+{
+    struct sched_worker *w = arg;
+    ll_wsdeque_t *own = &sched_dq[w->id];
+    for (int k = 0; k < w->c.n; k++) {
+        LL_WSDEQUE_PUSH(own, &w->c.elems[k]);
+        struct item *e = LL_WSDEQUE_POP(own, struct item);
+        for (int v = 1; !e && v < w->threads; v++)
+            e = LL_WSDEQUE_STEAL(&sched_dq[(w->id + v) % w->threads], struct item);
+        if (e)
+            sink += e->value;
+    }
+    return NULL;
+}
+
+static void bench_task_scheduling(int rounds)
+{
+    printf("Task push + take: shared list vs per-thread LL_WSDEQUE (total throughput)\n");
+    struct item *elems = malloc(sizeof(*elems) * (size_t)rounds * SCHED_MAX_THREADS);
+    if (!elems)
+        return;
+    for (int i = 0; i < rounds * SCHED_MAX_THREADS; i++)
+        elems[i].value = i;
+    for (int deques = 0; deques < 2; deques++) {
+        for (int threads = 1; threads <= SCHED_MAX_THREADS; threads *= 2) {
+            struct list_head lst;
+            struct list_head *lst_p = &lst;
+            LL_INIT(lst_p);
+            for (int i = 0; i < threads; i++)
+                if (deques && LL_WSDEQUE_INIT(&sched_dq[i])) {
+                    free(elems);
+                    return;
+                }
+            pthread_t th[SCHED_MAX_THREADS];
+            struct sched_worker w[SCHED_MAX_THREADS];
+            double t = now_ns();
+            for (int i = 0; i < threads; i++) {
+                w[i] = (struct sched_worker){
+                    { lst_p, elems + (size_t)i * rounds, rounds }, i, threads };
+                pthread_create(&th[i], NULL, deques ? deque_worker : shared_list_worker, &w[i]);
+            }
+            for (int i = 0; i < threads; i++)
+                pthread_join(th[i], NULL);
+            t = now_ns() - t;
+            char buf[64];
+            snprintf(buf, sizeof(buf), "%s, %d thread%s", deques ? "deques" : "shared list",
+                     threads, threads > 1 ? "s" : "");
+            printf("  %-40s %12.0f ops/s\n", buf, (double)rounds * threads / (t / 1e9));
+            if (deques) {
+                for (int i = 0; i < threads; i++)
+                    LL_WSDEQUE_DESTROY(&sched_dq[i]);
+            } else {
+                while (LL_REMOVE_HEAD(lst_p, struct item, link))
+                    ;
+                ll_txn_commit(LL_TXN_START(lst_p, struct item, link));
+            }
+        }
+    }
+    free(elems);
+}
+
+int main(int argc, char **argv)
+{
+    int n = argc > 1 ? atoi(argv[1]) : 1000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 20000;
+    if (n <= 0 || rounds <= 0) {
+        fprintf(stderr, "usage: %s [elements] [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    struct list_head lst;
+    struct list_head *lst_p = &lst;
+    LL_INIT(lst_p);
+    struct item *last = NULL;
+    for (int i = 0; i < n; i++) {
+        struct item *e = malloc(sizeof(*e));
+        if (!e)
+            return 1;
+        e->value = i;
+        LL_INSERT_TAIL(lst_p, e, link);
+        last = e;
+    }
+
+    printf("Mode: %s\n", BENCH_MODE);
+    struct list_head one;
+    struct list_head *one_p = &one;
+    struct item single = { 1, 0 };
+    LL_INIT(one_p);
+    LL_INSERT_HEAD(one_p, &single, link);
+    bench_call_overhead(one_p, rounds);
+    LL_REMOVE_HEAD(one_p, struct item, link);
+
+    bench_generated(lst_p, last, n, rounds);
+    bench_txn_view(lst_p, n, rounds / 10 ? rounds / 10 : 1);
+    bench_reduce(lst_p, n, rounds / 10 ? rounds / 10 : 1);
+    bench_to_array(lst_p, n, rounds / 10 ? rounds / 10 : 1);
+    bench_allocators(rounds);
+    bench_threading(rounds);
+    bench_commit_scaling(rounds);
+    bench_pq_scaling(rounds);
+    bench_task_scheduling(rounds);
+    bench_parallel_scan();
+
+    struct item *p;
+    while ((p = LL_REMOVE_HEAD(lst_p, struct item, link)) != NULL)
+        free(p);
+    return 0;
+}
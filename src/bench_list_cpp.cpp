@@ -0,0 +1,121 @@
+/**
+ * Benchmark: C++ wrapper (list.hpp) vs the same operations written against
+ * the C macros. Usage: bench_list_cpp [elements] [rounds]
+ * Each pair should report the same time; the wrapper adds no work.
+ */
+#include "list.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+struct item {
+    int value;
+    LL_ENTRY(item, link);
+};
+using item_list = ll::list<item, &item::link>;
+
+static volatile long sink;
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void report(const char *label, double ns, long ops)
+{
+    printf("  %-40s %12.1f ns/op\n", label, ns / (double)ops);
+}
+
+static void bench_reads(item_list &lst, item *last, int n, int rounds)
+{
+    printf("Read paths over %d elements: C macros vs ll::list\n", n);
+    ll::detail::head *h = lst.native();
+    double t;
+    long acc = 0;
+
+    item *var;
+    t = now_ns();
+    for (int r = 0; r < rounds; r++)
+        LL_FOREACH(var, h, struct item, link)
+            acc += var->value;
+    report("LL_FOREACH (sum)", now_ns() - t, rounds);
+    t = now_ns();
+    for (int r = 0; r < rounds; r++)
+        for (item &e : lst)
+            acc += e.value;
+    report("range-for (sum)", now_ns() - t, rounds);
+
+    t = now_ns();
+    for (int r = 0; r < rounds; r++)
+        acc += LL_CONTAINS(h, last, link);
+    report("LL_CONTAINS (last element)", now_ns() - t, rounds);
+    t = now_ns();
+    for (int r = 0; r < rounds; r++)
+        acc += lst.contains(*last);
+    report("list::contains", now_ns() - t, rounds);
+
+    t = now_ns();
+    for (int r = 0; r < rounds; r++)
+        acc += (long)LL_SIZE(h, struct item, link);
+    report("LL_SIZE", now_ns() - t, rounds);
+    t = now_ns();
+    for (int r = 0; r < rounds; r++)
+        acc += (long)lst.size();
+    report("list::size", now_ns() - t, rounds);
+
+    sink = acc;
+}
+
+static void bench_txn(item_list &lst, int rounds)
+{
+    printf("Transaction insert + remove, committed\n");
+    ll::detail::head *h = lst.native();
+    item x = {};
+    double t;
+
+    t = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        ll_txn_t *txn = LL_TXN_START(h, struct item, link);
+        LL_TXN_INSERT_HEAD(txn, &x, link);
+        ll_txn_commit(txn);
+        LL_REMOVE_HEAD(h, struct item, link);
+    }
+    report("LL_TXN_START/INSERT_HEAD/commit", now_ns() - t, rounds);
+    t = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        auto txn = lst.begin_txn();
+        txn.push_front(x);
+        txn.commit();
+        lst.pop_front();
+    }
+    report("ll::txn push_front/commit", now_ns() - t, rounds);
+}
+
+int main(int argc, char **argv)
+{
+    int n = argc > 1 ? atoi(argv[1]) : 1000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 20000;
+    if (n <= 0 || rounds <= 0) {
+        fprintf(stderr, "usage: %s [elements] [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    item_list lst;
+    std::vector<item> elems(n);
+    for (int i = 0; i < n; i++) {
+        elems[i].value = i;
+        lst.push_back(elems[i]);
+    }
+
+    bench_reads(lst, &elems[n - 1], n, rounds);
+
+    item_list scratch;
+    bench_txn(scratch, rounds);
+
+    while (lst.pop_front())
+        ;
+    return 0;
+}
@@ -8,385 +8,1935 @@
  * transactions; snapshot is defined by ID.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
+/* The library always provides the out-of-line fast paths, whatever LIST_HEADER_ONLY says. */
+#undef LIST_HEADER_ONLY
 #include "list.h"
+#include <pthread.h>
+#include <sched.h>
 #include <stdalign.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <stdatomic.h>
 
-/* Versioned wrapper: list chains these; each holds user element + version ids. */
-typedef struct versioned_node {
-    void *user_elm;
-    uint64_t insert_txn_id;
-    _Atomic uint64_t removed_txn_id;  /* 0 = not removed */
-    atomic_uintptr_t next;
-} versioned_node_t;
+/* Versioned wrapper: list chains these; each holds user element + version ids (see list.h). */
+typedef ll_vnode_t versioned_node_t;
 
 static inline versioned_node_t *get_wrapper(uintptr_t u)
 {
-    return (versioned_node_t *)(u & ~(uintptr_t)1UL);
+    return ll_vnode_(u);
 }
 
 static int visible(versioned_node_t *w, uint64_t snapshot_version)
 {
-    if (!w)
-        return 0;
-    uint64_t rid = atomic_load_explicit(&w->removed_txn_id, memory_order_acquire);
-    return w->insert_txn_id <= snapshot_version && (rid == 0 || rid > snapshot_version);
+    return w && ll_vnode_visible_(w, snapshot_version);
+}
+
+/*
+ * Reclamation domain: the active snapshots and walks (eras) that
+ * reclaim on a list has to respect. Lists share the default domain unless
+ * given their own (LL_SET_DOMAIN); reclaim only scans its list's domain, so
+ * lists in different domains never hold back each other's garbage. Each
+ * thread has one slot, the same in every domain.
+ */
+#define MAX_THREADS 32
+struct ll_domain {
+    _Atomic(uint64_t) active_snapshot_version[MAX_THREADS];
+    _Atomic(uint64_t) snapshot_deadline[MAX_THREADS];   /* monotonic ns; 0 = no lease */
+    _Atomic(uint64_t) snapshot_open[MAX_THREADS];
+    _Atomic(uint64_t) overflow;  /* walks and transactions of threads without a slot */
+    struct ll_domain *next;      /* in "domains" */
+};
+static ll_domain_t default_domain;
+
+/* Every live domain, for threads to clear their entries on exit. */
+static ll_domain_t *domains = &default_domain;
+static _Atomic(int) domains_busy;
+
+static void domains_lock(void)
+{
+    while (atomic_exchange_explicit(&domains_busy, 1, memory_order_acquire))
+        sched_yield();
+}
+
+static void domains_unlock(void)
+{
+    atomic_store_explicit(&domains_busy, 0, memory_order_release);
+}
+
+ll_domain_t *ll_domain_create(void)
+{
+    ll_domain_t *d = (ll_domain_t *)calloc(1, sizeof(ll_domain_t));
+    if (!d)
+        return NULL;
+    domains_lock();
+    d->next = domains;
+    domains = d;
+    domains_unlock();
+    return d;
+}
+
+void ll_domain_destroy(ll_domain_t *d)
+{
+    if (!d || d == &default_domain)
+        return;
+    domains_lock();
+    ll_domain_t **link = &domains;
+    while (*link != d)
+        link = &(*link)->next;
+    *link = d->next;
+    domains_unlock();
+    free(d);
 }
 
-void ll_init_(atomic_uintptr_t *head, ll_commit_id_t *commit_id)
+void ll_init_(atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl)
 {
+    ctl->alloc.alloc = NULL;
+    ctl->alloc.free = NULL;
+    ctl->alloc.ctx = NULL;
+    ctl->domain = &default_domain;
+    atomic_store_explicit(&ctl->pending, (uintptr_t)0, memory_order_relaxed);
+    atomic_store_explicit(&ctl->popped, (uintptr_t)0, memory_order_relaxed);
+    atomic_store_explicit(&ctl->held_min_rid, UINT64_MAX, memory_order_relaxed);
+    atomic_store_explicit(&ctl->backlog, 0, memory_order_relaxed);
+    atomic_store_explicit(&ctl->reclaiming, 0, memory_order_relaxed);
+    atomic_store_explicit(&ctl->cursor, (ll_vnode_t *)NULL, memory_order_relaxed);
+    ctl->reclaim_budget = LL_RECLAIM_BUDGET;
+    ctl->free_batch = NULL;
+    ctl->free_deferred = false;
+    ctl->snapshot_lease_ns = 0;
+    atomic_store_explicit(&ctl->garbage, (size_t)0, memory_order_relaxed);
+    atomic_store_explicit(&ctl->garbage_peak, (size_t)0, memory_order_relaxed);
+    atomic_store_explicit(&ctl->nodes, (size_t)0, memory_order_relaxed);
+    ctl->garbage_limit = 0;
+    ctl->garbage_wait_us = 0;
+    atomic_store_explicit(&ctl->n_forced, (uint64_t)0, memory_order_relaxed);
+    atomic_store_explicit(&ctl->n_throttled, (uint64_t)0, memory_order_relaxed);
+    ctl->held = NULL;
+    ctl->n_held = ctl->n_unlinked = ctl->credit = 0;
+    ctl->limbo[0] = ctl->limbo[1] = NULL;
+    ctl->limbo_epoch = 0;
+    ctl->limbo_period = 0;
+    ctl->qsbr = false;
+    ctl->threading = LL_MULTI_WRITER;
+    ctl->order = NULL;
+    ctl->spray = 0;
+    ctl->retired[0] = ctl->retired[1] = NULL;
+    atomic_store_explicit(&ctl->group_commit, 0, memory_order_relaxed);
+    atomic_store_explicit(&ctl->gc_leader, 0, memory_order_relaxed);
+    atomic_store_explicit(&ctl->gc_queue, (uintptr_t)0, memory_order_relaxed);
     atomic_store_explicit(head, (uintptr_t)0, memory_order_release);
     atomic_store_explicit(commit_id, 1, memory_order_release);
 }
 
-/* Hazard pointers: 2 slots per thread so we can hold prev and curr during traversal. */
-#define MAX_HP_THREADS 32
-#define HP_SLOTS_PER_THREAD 2
-static _Atomic(void *) hazard_ptrs[MAX_HP_THREADS * HP_SLOTS_PER_THREAD];
-static _Atomic(int) hp_next_index;
-static _Thread_local int my_hp_base = -1;
+/* --- Allocation: everything list.c allocates goes through the head's allocator --- */
 
-static int get_hp_base(void)
+void ll_set_allocator_(ll_ctl_t *ctl,
+    void *(*alloc_fn)(size_t, size_t, void *),
+    void (*free_fn)(void *, size_t, size_t, void *), void *ctx)
 {
-    if (my_hp_base >= 0)
-        return my_hp_base;
-    int i = atomic_fetch_add(&hp_next_index, 1);
-    if (i >= MAX_HP_THREADS)
-        return -1;
-    my_hp_base = i * HP_SLOTS_PER_THREAD;
-    return my_hp_base;
+    if (!alloc_fn || !free_fn)
+        alloc_fn = NULL, free_fn = NULL, ctx = NULL;
+    ctl->alloc.alloc = alloc_fn;
+    ctl->alloc.free = free_fn;
+    ctl->alloc.ctx = ctx;
 }
 
-static void hp_acquire(void *p)
+void ll_set_domain_(ll_ctl_t *ctl, ll_domain_t *d)
 {
-    int i = get_hp_base();
-    if (i >= 0)
-        atomic_store_explicit(&hazard_ptrs[i], p, memory_order_release);
+    ctl->domain = d ? d : &default_domain;
 }
 
-static void hp_acquire_1(void *p)
+void ll_set_free_batch_(ll_ctl_t *ctl, ll_free_batch_fn fn, int deferred)
 {
-    int i = get_hp_base();
-    if (i >= 0)
-        atomic_store_explicit(&hazard_ptrs[i + 1], p, memory_order_release);
+    ctl->free_batch = fn;
+    ctl->free_deferred = fn && deferred;
 }
 
-static void hp_release(void)
+void ll_set_qsbr_(ll_ctl_t *ctl, int on)
 {
-    int i = get_hp_base();
-    if (i >= 0) {
-        atomic_store_explicit(&hazard_ptrs[i], NULL, memory_order_release);
-        atomic_store_explicit(&hazard_ptrs[i + 1], NULL, memory_order_release);
+    ctl->qsbr = on != 0;
+}
+
+void ll_set_threading_(ll_ctl_t *ctl, int mode)
+{
+    ctl->threading = mode;
+}
+
+void ll_set_order_(ll_ctl_t *ctl, ll_order_fn cmp)
+{
+    ctl->order = cmp;
+}
+
+void ll_set_relaxed_min_(ll_ctl_t *ctl, unsigned width)
+{
+    ctl->spray = width;
+}
+
+void ll_set_reclaim_budget_(ll_ctl_t *ctl, size_t nodes)
+{
+    ctl->reclaim_budget = nodes;
+}
+
+void ll_set_snapshot_lease_(ll_ctl_t *ctl, uint64_t lease_us)
+{
+    ctl->snapshot_lease_ns = lease_us * 1000;
+}
+
+void ll_set_garbage_limit_(ll_ctl_t *ctl, size_t nodes, unsigned max_wait_us)
+{
+    ctl->garbage_limit = nodes;
+    ctl->garbage_wait_us = max_wait_us;
+}
+
+void ll_garbage_stats_(ll_ctl_t *ctl, ll_garbage_stats_t *stats)
+{
+    stats->garbage = atomic_load_explicit(&ctl->garbage, memory_order_relaxed);
+    stats->peak = atomic_load_explicit(&ctl->garbage_peak, memory_order_relaxed);
+    stats->forced = atomic_load_explicit(&ctl->n_forced, memory_order_relaxed);
+    stats->throttled = atomic_load_explicit(&ctl->n_throttled, memory_order_relaxed);
+}
+
+void ll_set_group_commit_(ll_ctl_t *ctl, int on)
+{
+    atomic_store_explicit(&ctl->group_commit, on != 0, memory_order_release);
+}
+
+static void *mem_alloc(const ll_ctl_t *ctl, size_t size, size_t align)
+{
+    if (ctl->alloc.alloc)
+        return ctl->alloc.alloc(size, align, ctl->alloc.ctx);
+    /* malloc covers the fundamental alignments; aligned_alloc wants a multiple of align. */
+    if (align > alignof(max_align_t))
+        return aligned_alloc(align, (size + align - 1) & ~(align - 1));
+    return malloc(size);
+}
+
+static void mem_free(const ll_ctl_t *ctl, void *p, size_t size, size_t align)
+{
+    if (!p)
+        return;
+    if (ctl->alloc.free)
+        ctl->alloc.free(p, size, align, ctl->alloc.ctx);
+    else
+        free(p);
+}
+
+/* realloc for pointer-aligned buffers; custom allocators get alloc + copy + free. */
+static void *mem_grow(const ll_ctl_t *ctl, void *p, size_t old_size, size_t new_size)
+{
+    if (!ctl->alloc.alloc)
+        return realloc(p, new_size);
+    void *q = ctl->alloc.alloc(new_size, alignof(void *), ctl->alloc.ctx);
+    if (q && p) {
+        memcpy(q, p, old_size);
+        ctl->alloc.free(p, old_size, alignof(void *), ctl->alloc.ctx);
+    }
+    return q;
+}
+
+/*
+ * ctl->nodes counts the wrappers allocated and not yet freed, which bounds
+ * what any snapshot can see (LL_SNAPSHOT_TO_ARRAY sizes its output by it).
+ * Under LL_SET_THREADING only the writer allocates or frees them.
+ */
+static void nodes_add(ll_ctl_t *ctl, size_t d)
+{
+    if (ctl->threading)
+        atomic_store_explicit(&ctl->nodes, atomic_load_explicit(&ctl->nodes, memory_order_relaxed) + d,
+                              memory_order_relaxed);
+    else
+        atomic_fetch_add_explicit(&ctl->nodes, d, memory_order_relaxed);
+}
+
+static versioned_node_t *node_alloc(ll_ctl_t *ctl)
+{
+    versioned_node_t *w = (versioned_node_t *)mem_alloc(ctl, sizeof(versioned_node_t),
+                                                        alignof(versioned_node_t));
+    if (w)
+        nodes_add(ctl, 1);
+    return w;
+}
+
+static void node_free(ll_ctl_t *ctl, versioned_node_t *w)
+{
+    mem_free(ctl, w, sizeof(versioned_node_t), alignof(versioned_node_t));
+    nodes_add(ctl, (size_t)-1);
+}
+
+/*
+ * Each thread's entry in every domain is at my_slot. Slots are handed out
+ * in order, then reused from slot_free once threads exit (see
+ * thread_exit); -1 once all MAX_THREADS are taken.
+ */
+LL_STATIC_ASSERT_(MAX_THREADS <= 32, "slot_free is a 32-bit mask");
+static _Atomic(int) slot_next;
+static _Atomic(uint32_t) slot_free;
+static _Thread_local int my_slot = -1;
+
+static void thread_hook(void);
+
+static int thread_slot(void)
+{
+    if (my_slot >= 0)
+        return my_slot;
+    int i;
+    uint32_t mask = atomic_load_explicit(&slot_free, memory_order_acquire);
+    for (;;) {
+        if (!mask) {
+            i = atomic_load_explicit(&slot_next, memory_order_relaxed);
+            while (i < MAX_THREADS &&
+                   !atomic_compare_exchange_weak_explicit(&slot_next, &i, i + 1,
+                                                          memory_order_relaxed, memory_order_relaxed))
+                ;
+            if (i >= MAX_THREADS)
+                return -1;
+            break;
+        }
+        i = __builtin_ctz(mask);
+        if (atomic_compare_exchange_weak_explicit(&slot_free, &mask, mask & ~(UINT32_C(1) << i),
+                                                  memory_order_acquire, memory_order_acquire))
+            break;
     }
+    my_slot = i;
+    thread_hook();
+    return my_slot;
+}
+
+/*
+ * Active snapshot versions for reclaim, per domain: only free nodes
+ * removed before min(active). The transactions open on a thread share its entry: it holds
+ * the oldest of their snapshots and the latest of their lease deadlines
+ * (none if any of them has none). Once that deadline passes,
+ * min_active_snapshot revokes the entry; by then every lease it covered
+ * has run out. SNAP_BUSY marks an entry whose owner is walking the list
+ * right now, which is never revoked. snapshot_open counts the transactions
+ * sharing an entry (low half) in the current generation (high half); a
+ * fresh generation starts whenever the entry was empty or revoked, so
+ * transactions that expired and were never closed stop counting.
+ */
+#define SNAP_BUSY (UINT64_C(1) << 63)
+#define OPEN_GEN(w) ((w) >> 32)
+#define OPEN_COUNT(w) ((w) & 0xffffffffu)
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
 }
 
-/* Active snapshot versions for reclaim: only free nodes removed before min(active). */
-static _Atomic(uint64_t) active_snapshot_version[MAX_HP_THREADS];
+/* Revoke entry i if it is idle and past its deadline. */
+static bool snapshot_lapse(ll_domain_t *dom, int i, uint64_t v, uint64_t *now)
+{
+    if (v & SNAP_BUSY)
+        return false;
+    uint64_t d = atomic_load_explicit(&dom->snapshot_deadline[i], memory_order_seq_cst);
+    if (!d)
+        return false;
+    if (!*now)
+        *now = now_ns();
+    return *now >= d &&
+           atomic_compare_exchange_strong_explicit(&dom->active_snapshot_version[i], &v, (uint64_t)0,
+                                                   memory_order_seq_cst, memory_order_relaxed);
+}
 
-static uint64_t min_active_snapshot(void)
+static uint64_t min_active_snapshot(ll_domain_t *d)
 {
-    uint64_t min = UINT64_MAX;
-    for (int i = 0; i < MAX_HP_THREADS; i++) {
-        uint64_t v = atomic_load_explicit(&active_snapshot_version[i], memory_order_acquire);
-        if (v != 0 && v < min)
+    uint64_t min = UINT64_MAX, now = 0;
+    for (int i = 0; i < MAX_THREADS; i++) {
+        uint64_t v = atomic_load_explicit(&d->active_snapshot_version[i], memory_order_seq_cst);
+        if (v == 0)
+            continue;
+        if (!(v & SNAP_BUSY) &&
+            (!OPEN_COUNT(atomic_load_explicit(&d->snapshot_open[i], memory_order_seq_cst)) ||
+             snapshot_lapse(d, i, v, &now)))
+            continue;   /* left over from closed transactions, or lease ran out */
+        v &= ~SNAP_BUSY;
+        if (v < min)
             min = v;
     }
+    /* A thread without a slot publishes no snapshot: nothing may be unlinked under it. */
+    if (atomic_load_explicit(&d->overflow, memory_order_seq_cst))
+        return 0;
     return min;  /* UINT64_MAX if no active txns */
 }
 
-/* Thread-local list of unlinked nodes waiting to be freed when no hp references them. */
-static _Thread_local versioned_node_t *retired_list;
+/*
+ * Add a transaction at snapshot v with lease deadline d to entry i (this
+ * thread's) of dom; returns the generation it joined.
+ */
+static uint64_t snapshot_register(ll_domain_t *dom, int i, uint64_t v, uint64_t d)
+{
+    _Atomic(uint64_t) *slot = &dom->active_snapshot_version[i];
+    uint64_t held = atomic_load_explicit(slot, memory_order_relaxed), now = 0;
+    uint64_t w = atomic_load_explicit(&dom->snapshot_open[i], memory_order_acquire);
+    bool join = held && (held & SNAP_BUSY || (OPEN_COUNT(w) && !snapshot_lapse(dom, i, held, &now)));
+    if (join) {
+        uint64_t held_d = atomic_load_explicit(&dom->snapshot_deadline[i], memory_order_relaxed);
+        d = held_d && d ? (held_d > d ? held_d : d) : 0;
+        if ((held & ~SNAP_BUSY) < v)
+            v = held & ~SNAP_BUSY;
+        v |= held & SNAP_BUSY;
+    }
+    atomic_store_explicit(&dom->snapshot_deadline[i], d, memory_order_seq_cst);
+    atomic_store_explicit(slot, v, memory_order_seq_cst);
+    uint64_t nw;
+    do {
+        nw = join ? w + 1 : ((OPEN_GEN(w) + 1) << 32 | 1);
+    } while (!atomic_compare_exchange_weak_explicit(&dom->snapshot_open[i], &w, nw,
+                                                    memory_order_seq_cst, memory_order_acquire));
+    return OPEN_GEN(nw);
+}
 
-static int any_hp_equals(void *p)
+/*
+ * Drop a transaction of generation gen from entry i, putting back
+ * "restore" if it held the entry busy. Nothing to drop if the entry has
+ * moved on to a later generation.
+ */
+static void snapshot_release(ll_domain_t *d, int i, uint64_t gen, uint64_t restore)
 {
-    for (int i = 0; i < MAX_HP_THREADS * HP_SLOTS_PER_THREAD; i++) {
-        if (atomic_load_explicit(&hazard_ptrs[i], memory_order_acquire) == p)
-            return 1;
+    if (i < 0) {
+        atomic_fetch_sub_explicit(&d->overflow, 1, memory_order_release);
+        return;
     }
-    return 0;
+    uint64_t w = atomic_load_explicit(&d->snapshot_open[i], memory_order_acquire);
+    while (OPEN_GEN(w) == gen && OPEN_COUNT(w))
+        if (atomic_compare_exchange_weak_explicit(&d->snapshot_open[i], &w, w - 1,
+                                                  memory_order_acq_rel, memory_order_acquire))
+            break;
+    if (restore)
+        atomic_store_explicit(&d->active_snapshot_version[i], restore, memory_order_release);
 }
 
-static void reclaim(atomic_uintptr_t *head, ll_commit_id_t *commit_id, void (*free_cb)(void *))
+/*
+ * Every walk over a list pins this thread's slot for its duration, so
+ * nothing it can reach is freed under it (see reclaim): a transaction's
+ * snapshot already there is held busy, otherwise the current commit id is
+ * pinned. Nothing to undo if a caller up the stack already pinned. A
+ * thread without a slot counts itself in the domain's overflow instead,
+ * which stops reclaim from unlinking or freeing anything until it is done
+ * (see eras_scan). A plain reader's walk can run user code (an iterator's
+ * loop body); if that opens a transaction on this thread, unpinning leaves
+ * the entry at the pinned era for it instead of clearing it.
+ */
+typedef ll_pin_t walk_pin_t;
+
+static walk_pin_t walk_pin(ll_domain_t *d, ll_commit_id_t *commit_id)
 {
-    uint64_t min_active = min_active_snapshot();
-    if (min_active == UINT64_MAX)
-        min_active = atomic_load_explicit(commit_id, memory_order_acquire);
-    versioned_node_t *prev = NULL;
-    uintptr_t prev_next = atomic_load_explicit(head, memory_order_acquire);
-    versioned_node_t *curr = get_wrapper(prev_next);
-    while (curr) {
-        uint64_t rid = atomic_load_explicit(&curr->removed_txn_id, memory_order_acquire);
-        int reclaimable = (rid != 0 && rid < min_active);
-        uintptr_t next_val = atomic_load_explicit(&curr->next, memory_order_acquire);
-        versioned_node_t *next = get_wrapper(next_val);
-        if (reclaimable) {
-            hp_acquire(curr);
-            uintptr_t unlink_val = (uintptr_t)curr;
-            int unlinked = 0;
-            if (prev) {
-                if (atomic_compare_exchange_weak_explicit(&prev->next, &unlink_val, next_val,
-                                                          memory_order_release, memory_order_acquire))
-                    unlinked = 1;
-            } else {
-                if (atomic_compare_exchange_weak_explicit(head, &unlink_val, next_val,
-                                                          memory_order_release, memory_order_acquire))
-                    unlinked = 1;
-            }
-            if (unlinked) {
-                hp_release();
-                /* Push to retire list; free only when no hazard ptr references this node. */
-                atomic_store_explicit(&curr->next, (uintptr_t)retired_list, memory_order_release);
-                retired_list = curr;
-                curr = next;
-                continue;
-            }
-            hp_release();
-        }
-        prev = curr;
-        prev_next = (uintptr_t)curr;
-        curr = next;
-    }
-    /* Free retired nodes that no hazard ptr references. */
-    versioned_node_t *still_held = NULL;
-    while (retired_list) {
-        versioned_node_t *n = retired_list;
-        retired_list = get_wrapper(atomic_load_explicit(&n->next, memory_order_acquire));
-        if (any_hp_equals(n)) {
-            atomic_store_explicit(&n->next, (uintptr_t)still_held, memory_order_release);
-            still_held = n;
-        } else {
-            void *user = n->user_elm;
-            free(n);
-            if (free_cb)
-                free_cb(user);
-        }
+    walk_pin_t pin = {NULL, NULL, 0, 0};
+    int i = thread_slot();
+    if (i < 0) {
+        atomic_fetch_add_explicit(&d->overflow, 1, memory_order_seq_cst);
+        pin.slot = &d->overflow;
+        return pin;
     }
-    retired_list = still_held;
+    _Atomic(uint64_t) *slot = &d->active_snapshot_version[i];
+    uint64_t v = atomic_load_explicit(slot, memory_order_relaxed);
+    if (v & SNAP_BUSY)
+        return pin;
+    pin.slot = slot;
+    pin.open = &d->snapshot_open[i];
+    pin.open_w = atomic_load_explicit(pin.open, memory_order_relaxed);
+    if (v && OPEN_COUNT(pin.open_w) &&
+        atomic_compare_exchange_strong_explicit(slot, &v, v | SNAP_BUSY,
+                                                memory_order_seq_cst, memory_order_relaxed)) {
+        pin.restore = v;
+        return pin;
+    }
+    atomic_store_explicit(slot, atomic_load_explicit(commit_id, memory_order_acquire) | SNAP_BUSY,
+                          memory_order_seq_cst);
+    return pin;
 }
 
-void ll_insert_head_(atomic_uintptr_t *head, ll_commit_id_t *commit_id, void *elm)
+static void walk_unpin(const walk_pin_t *pin)
 {
-    uint64_t C = atomic_fetch_add_explicit(commit_id, 1, memory_order_acq_rel);
-    versioned_node_t *w = (versioned_node_t *)aligned_alloc(alignof(versioned_node_t), sizeof(versioned_node_t));
-    if (!w)
+    if (!pin->slot)
         return;
-    w->user_elm = elm;
-    w->insert_txn_id = C;
-    atomic_store_explicit(&w->removed_txn_id, (uint64_t)0, memory_order_release);
-    uintptr_t old_head;
+    if (!pin->open) {
+        atomic_fetch_sub_explicit(pin->slot, 1, memory_order_release);
+        return;
+    }
+    uint64_t v = pin->restore;
+    uint64_t w = atomic_load_explicit(pin->open, memory_order_relaxed);
+    if (w != pin->open_w && OPEN_COUNT(w))
+        v = atomic_load_explicit(pin->slot, memory_order_relaxed) & ~SNAP_BUSY;
+    atomic_store_explicit(pin->slot, v, memory_order_release);
+}
+
+ll_pin_t ll_read_pin_(ll_ctl_t *ctl, ll_commit_id_t *commit_id)
+{
+    if (ctl->qsbr) {
+        walk_pin_t none = {NULL, NULL, 0, 0};
+        return none;
+    }
+    return walk_pin(ctl->domain, commit_id);
+}
+
+void ll_read_unpin_(ll_pin_t *pin)
+{
+    walk_unpin(pin);
+    pin->slot = NULL;
+}
+
+/*
+ * Reclamation is driven by removals, not by walking the list. Whoever sets
+ * a node's removed_txn_id pushes it on ctl->pending; reclaim adopts those
+ * into ctl->held and, once a removal is older than every active snapshot,
+ * unlinks the node during a walk paid for by the removals themselves
+ * (RECLAIM_CREDIT steps each, at most reclaim_budget per call), resuming
+ * at ctl->cursor. One thread reclaims a list at a time.
+ *
+ * Unlinking sets bit 0 of the node's next first, so nothing is linked
+ * after a node on its way out, and leaves next otherwise intact, so a walk
+ * standing on it still reaches the rest of the list. Unlinked nodes (and
+ * those remove_head could not free at once) wait in limbo until every
+ * walk that may stand on them has ended, then on the retired lists until
+ * no open transaction's era pins them (see eras_scan). All of these chains
+ * link through retire_next.
+ */
+#define RECLAIM_CREDIT 32
+
+static void chain_push(atomic_uintptr_t *chain, versioned_node_t *first, versioned_node_t *last)
+{
+    uintptr_t old = atomic_load_explicit(chain, memory_order_acquire);
     do {
-        old_head = atomic_load_explicit(head, memory_order_acquire);
-        atomic_store_explicit(&w->next, old_head, memory_order_release);
-    } while (!atomic_compare_exchange_weak_explicit(head, &old_head, (uintptr_t)w,
+        last->retire_next = get_wrapper(old);
+    } while (!atomic_compare_exchange_weak_explicit(chain, &old, (uintptr_t)first,
                                                     memory_order_release, memory_order_acquire));
 }
 
-void ll_insert_tail_(atomic_uintptr_t *head, ll_commit_id_t *commit_id, void *elm)
+/* One more removed node for reclaim to free. */
+static void garbage_add(ll_ctl_t *ctl)
 {
-    uint64_t C = atomic_fetch_add_explicit(commit_id, 1, memory_order_acq_rel);
-    versioned_node_t *w = (versioned_node_t *)aligned_alloc(alignof(versioned_node_t), sizeof(versioned_node_t));
-    if (!w)
-        return;
-    w->user_elm = elm;
-    w->insert_txn_id = C;
-    atomic_store_explicit(&w->removed_txn_id, (uint64_t)0, memory_order_release);
-    atomic_store_explicit(&w->next, (uintptr_t)0, memory_order_release);
-    for (;;) {
-        uintptr_t head_val = atomic_load_explicit(head, memory_order_acquire);
-        versioned_node_t *curr = get_wrapper(head_val);
-        if (!curr) {
-            if (atomic_compare_exchange_weak_explicit(head, &head_val, (uintptr_t)w,
-                                                      memory_order_release, memory_order_acquire))
-                return;
-            continue;
-        }
-        hp_acquire(curr);
-        if (atomic_load_explicit(head, memory_order_acquire) != head_val) {
-            hp_release();
-            continue;
-        }
-        versioned_node_t *prev = curr;
-        for (;;) {
-            uintptr_t next_val = atomic_load_explicit(&prev->next, memory_order_acquire);
-            versioned_node_t *next = get_wrapper(next_val);
-            if (!next)
-                break;
-            hp_acquire(next);
-            prev = next;
-        }
-        uintptr_t expected = (uintptr_t)0;
-        if (atomic_compare_exchange_weak_explicit(&prev->next, &expected, (uintptr_t)w,
-                                                  memory_order_release, memory_order_acquire)) {
-            hp_release();
-            return;
-        }
-        hp_release();
-    }
+    size_t n = atomic_fetch_add_explicit(&ctl->garbage, 1, memory_order_relaxed) + 1;
+    size_t peak = atomic_load_explicit(&ctl->garbage_peak, memory_order_relaxed);
+    while (n > peak &&
+           !atomic_compare_exchange_weak_explicit(&ctl->garbage_peak, &peak, n,
+                                                  memory_order_relaxed, memory_order_relaxed))
+        ;
 }
 
-/* Insert elm after the node whose user_elm is after_elm. Lock-free; uses current commit_id snapshot for visibility. */
-void ll_insert_after_(atomic_uintptr_t *head, ll_commit_id_t *commit_id, void *after_elm, void *elm)
+/* w's removed_txn_id was just set by the caller: let reclaim find it. */
+static void pending_push(ll_ctl_t *ctl, versioned_node_t *w)
 {
-    uint64_t C = atomic_fetch_add_explicit(commit_id, 1, memory_order_acq_rel);
-    uint64_t S = C; /* visibility for finding after_elm: current commit */
-    versioned_node_t *w = (versioned_node_t *)aligned_alloc(alignof(versioned_node_t), sizeof(versioned_node_t));
-    if (!w)
-        return;
-    w->user_elm = elm;
-    w->insert_txn_id = C;
-    atomic_store_explicit(&w->removed_txn_id, (uint64_t)0, memory_order_release);
+    garbage_add(ctl);
+    chain_push(&ctl->pending, w, w);
+}
 
-    for (;;) {
-        uintptr_t head_val = atomic_load_explicit(head, memory_order_acquire);
-        versioned_node_t *curr = get_wrapper(head_val);
-        if (!curr) {
-            free(w);
-            return; /* after_elm not in list */
-        }
-        hp_acquire(curr);
-        if (atomic_load_explicit(head, memory_order_acquire) != head_val) {
-            hp_release();
-            continue;
-        }
-        while (curr) {
-            if (curr->user_elm == after_elm && visible(curr, S)) {
-                uintptr_t old_next = atomic_load_explicit(&curr->next, memory_order_acquire);
-                atomic_store_explicit(&w->next, old_next, memory_order_release);
-                if (atomic_compare_exchange_weak_explicit(&curr->next, &old_next, (uintptr_t)w,
-                                                         memory_order_release, memory_order_acquire)) {
-                    hp_release();
-                    return;
-                }
-                /* CAS failed: retry with fresh next */
-                continue;
-            }
-            versioned_node_t *next = get_wrapper(atomic_load_explicit(&curr->next, memory_order_acquire));
-            if (!next) {
-                hp_release();
-                free(w);
-                return; /* after_elm not found */
-            }
-            hp_acquire(next);  /* advance: hold next, drop curr */
-            curr = next;
-        }
-        hp_release();
-    }
+/* Take the unlink of w by marking its next; false if someone already has. */
+static bool mark_next(versioned_node_t *w)
+{
+    uintptr_t n = atomic_load_explicit(&w->next, memory_order_acquire);
+    while (!(n & 1))
+        if (atomic_compare_exchange_weak_explicit(&w->next, &n, n | 1,
+                                                  memory_order_seq_cst, memory_order_acquire))
+            return true;
+    return false;
 }
 
-void *ll_remove_head_(atomic_uintptr_t *head, ll_commit_id_t *commit_id)
+/*
+ * Unlink w, whose next the caller has marked. prev is where w was last
+ * seen (NULL: at the head); if that link has moved on, find w's
+ * predecessor again, waiting out one that is being unlinked itself.
+ */
+static void unlink_marked(atomic_uintptr_t *head, versioned_node_t *prev, versioned_node_t *w)
 {
-    uint64_t S = atomic_load_explicit(commit_id, memory_order_acquire);
+    uintptr_t succ = (uintptr_t)get_wrapper(atomic_load_explicit(&w->next, memory_order_acquire));
     for (;;) {
-        uintptr_t head_val = atomic_load_explicit(head, memory_order_acquire);
-        versioned_node_t *w = get_wrapper(head_val);
-        if (!w)
-            return NULL;
-        hp_acquire(w);
-        if (atomic_load_explicit(head, memory_order_acquire) != head_val) {
-            hp_release();
-            continue;
-        }
-        if (visible(w, S)) {
-            uintptr_t next_val = atomic_load_explicit(&w->next, memory_order_acquire);
-            if (atomic_compare_exchange_weak_explicit(head, &head_val, next_val,
-                                                      memory_order_release, memory_order_acquire)) {
-                void *user = w->user_elm;
-                hp_release();
-                free(w);
-                return user;
-            }
-            hp_release();
-            continue;
-        }
-        /* Head not visible; traverse to find first visible and unlink it. */
-        versioned_node_t *prev = w;
-        versioned_node_t *curr = get_wrapper(atomic_load_explicit(&w->next, memory_order_acquire));
-        int cas_failed = 0;
-        while (curr) {
-            hp_acquire_1(curr);
-            if (visible(curr, S)) {
-                uintptr_t unmarked = (uintptr_t)get_wrapper(atomic_load_explicit(&curr->next, memory_order_acquire));
-                uintptr_t prev_next = (uintptr_t)curr;
-                if (atomic_compare_exchange_weak_explicit(&prev->next, &prev_next, unmarked,
-                                                          memory_order_release, memory_order_acquire)) {
-                    void *user = curr->user_elm;
-                    hp_release();
-                    free(curr);
-                    return user;
-                }
-                cas_failed = 1;
-                break;
-            }
+        uintptr_t expected = (uintptr_t)w;
+        if (atomic_compare_exchange_strong_explicit(prev ? &prev->next : head, &expected, succ,
+                                                    memory_order_release, memory_order_acquire))
+            return;
+        if (prev && expected == ((uintptr_t)w | 1))
+            sched_yield();   /* prev is on its way out; its unlinker relinks w */
+        prev = NULL;
+        versioned_node_t *curr = get_wrapper(atomic_load_explicit(head, memory_order_acquire));
+        while (curr && curr != w) {
             prev = curr;
             curr = get_wrapper(atomic_load_explicit(&curr->next, memory_order_acquire));
         }
-        hp_release();
-        if (cas_failed)
-            continue;  /* Retry outer loop */
-        return NULL;   /* No visible node (list logically empty) */
+        if (!curr)
+            return;
     }
 }
 
-int ll_remove_(atomic_uintptr_t *head, ll_commit_id_t *commit_id,
-                            void (*free_cb)(void *), void *elm)
+static void reclaim_adopt(ll_ctl_t *ctl, uint64_t *held_min)
 {
-    (void)free_cb;
-    uint64_t C = atomic_fetch_add_explicit(commit_id, 1, memory_order_acq_rel);
-    versioned_node_t *curr = get_wrapper(atomic_load_explicit(head, memory_order_acquire));
-    while (curr) {
-        if (curr->user_elm == elm) {
-            atomic_store_explicit(&curr->removed_txn_id, C, memory_order_release);
-            return 0;
-        }
-        curr = get_wrapper(atomic_load_explicit(&curr->next, memory_order_acquire));
+    versioned_node_t *n = get_wrapper(atomic_exchange_explicit(&ctl->pending, (uintptr_t)0,
+                                                               memory_order_acquire));
+    while (n) {
+        versioned_node_t *next = n->retire_next;
+        uint64_t rid = atomic_load_explicit(&n->removed_txn_id, memory_order_relaxed);
+        if (rid < *held_min)
+            *held_min = rid;
+        n->retire_next = ctl->held;
+        ctl->held = n;
+        ctl->n_held++;
+        ctl->credit += RECLAIM_CREDIT;
+        n = next;
     }
-    return -1;
 }
 
-bool ll_contains_(atomic_uintptr_t *head, ll_commit_id_t *commit_id, const void *elm)
+/*
+ * Walk from the cursor, unlinking what no snapshot can see; returns how
+ * many. A forced walk ignores credit and budget and covers the whole list.
+ */
+static size_t reclaim_walk(atomic_uintptr_t *head, ll_ctl_t *ctl, uint64_t min_active, bool force)
 {
-    uint64_t S = atomic_load_explicit(commit_id, memory_order_acquire);
-    versioned_node_t *curr = get_wrapper(atomic_load_explicit(head, memory_order_acquire));
-    while (curr) {
-        if (curr->user_elm == elm && visible(curr, S))
-            return true;
+    size_t budget = ctl->credit;
+    if (ctl->reclaim_budget && budget > ctl->reclaim_budget)
+        budget = ctl->reclaim_budget;
+    versioned_node_t *prev = atomic_load_explicit(&ctl->cursor, memory_order_acquire);
+    if (force) {
+        budget = SIZE_MAX;
+        prev = NULL;
+    } else if (prev && (atomic_load_explicit(&prev->next, memory_order_acquire) & 1)) {
+        prev = NULL;   /* popped since; start over */
+    }
+    versioned_node_t *curr = get_wrapper(atomic_load_explicit(prev ? &prev->next : head,
+                                                              memory_order_acquire));
+    size_t visits = 0, unlinked = 0;
+    while (curr && visits < budget) {
+        visits++;
+        uint64_t rid = atomic_load_explicit(&curr->removed_txn_id, memory_order_acquire);
+        if (rid != 0 && rid < min_active && mark_next(curr)) {
+            unlink_marked(head, prev, curr);
+            unlinked++;
+        } else {
+            prev = curr;
+        }
         curr = get_wrapper(atomic_load_explicit(&curr->next, memory_order_acquire));
     }
-    return false;
+    ctl->credit = visits < ctl->credit ? ctl->credit - visits : 0;
+    /* Publish the resume point, then make sure remove_head didn't take it meanwhile. */
+    versioned_node_t *cursor = curr ? prev : NULL;
+    atomic_store_explicit(&ctl->cursor, cursor, memory_order_seq_cst);
+    if (cursor && (atomic_load_explicit(&cursor->next, memory_order_seq_cst) & 1))
+        atomic_store_explicit(&ctl->cursor, (versioned_node_t *)NULL, memory_order_relaxed);
+    return unlinked;
 }
 
-bool ll_is_empty_(atomic_uintptr_t *head)
+/* Move unlinked nodes from held onto *out; returns the oldest removal still held. */
+static uint64_t reclaim_sweep(ll_ctl_t *ctl, versioned_node_t **out)
 {
-    return get_wrapper(atomic_load_explicit(head, memory_order_acquire)) == NULL;
+    uint64_t held_min = UINT64_MAX;
+    versioned_node_t **link = &ctl->held;
+    while (*link) {
+        versioned_node_t *n = *link;
+        if (atomic_load_explicit(&n->next, memory_order_relaxed) & 1) {
+            *link = n->retire_next;
+            n->retire_next = *out;
+            *out = n;
+            ctl->n_held--;
+        } else {
+            uint64_t rid = atomic_load_explicit(&n->removed_txn_id, memory_order_relaxed);
+            if (rid < held_min)
+                held_min = rid;
+            link = &n->retire_next;
+        }
+    }
+    ctl->n_unlinked = 0;
+    if (ctl->credit > ctl->n_held * RECLAIM_CREDIT)
+        ctl->credit = ctl->n_held * RECLAIM_CREDIT;
+    return held_min;
 }
 
-size_t ll_size_(atomic_uintptr_t *head, ll_commit_id_t *commit_id)
+/*
+ * Hazard eras, with commit ids as the era clock: each domain entry
+ * publishes one era, and nothing is published per node visited. A busy
+ * entry is a walk in progress, pinned at a commit id no later than when it
+ * started, so a node unlinked by commit id E is safe from walks once
+ * walk_min > E. An idle entry belongs to open transactions, whose only
+ * hold on the list between operations is an iterator parked on a node
+ * visible to them; such an era pins a node only if it falls within the
+ * node's lifetime [insert_txn_id, removed_txn_id). An entry shared by
+ * several transactions holds the oldest of their snapshots, so only the
+ * upper bound applies to it. Walks and transactions of threads without an
+ * entry count in the domain's overflow; while any is in progress, walk_min
+ * is 0. Only meaningful for nodes already unlinked when the scan starts:
+ * later walks and transactions cannot reach them.
+ */
+typedef struct {
+    uint64_t walk_min;           /* oldest walk in progress; UINT64_MAX if none */
+    int n;
+    uint64_t era[MAX_THREADS];   /* idle transaction snapshots */
+    bool shared[MAX_THREADS];
+} eras_t;
+
+static void eras_scan(ll_domain_t *d, eras_t *e)
 {
-    uint64_t S = atomic_load_explicit(commit_id, memory_order_acquire);
-    size_t n = 0;
-    versioned_node_t *curr = get_wrapper(atomic_load_explicit(head, memory_order_acquire));
-    while (curr) {
-        if (visible(curr, S))
-            n++;
-        curr = get_wrapper(atomic_load_explicit(&curr->next, memory_order_acquire));
+    atomic_thread_fence(memory_order_seq_cst);
+    uint64_t now = 0;
+    e->walk_min = UINT64_MAX;
+    e->n = 0;
+    for (int i = 0; i < MAX_THREADS; i++) {
+        uint64_t v = atomic_load_explicit(&d->active_snapshot_version[i], memory_order_seq_cst);
+        if (v == 0)
+            continue;
+        if (v & SNAP_BUSY) {
+            v &= ~SNAP_BUSY;
+            if (v < e->walk_min)
+                e->walk_min = v;
+            continue;
+        }
+        uint64_t w = atomic_load_explicit(&d->snapshot_open[i], memory_order_seq_cst);
+        if (!OPEN_COUNT(w) || snapshot_lapse(d, i, v, &now))
+            continue;
+        e->era[e->n] = v;
+        e->shared[e->n] = OPEN_COUNT(w) > 1;
+        e->n++;
     }
-    return n;
+    if (atomic_load_explicit(&d->overflow, memory_order_seq_cst))
+        e->walk_min = 0;
 }
 
-/* --- Iterator (snapshot at current commit_id) --- */
-
-void ll_iter_begin(ll_iter_t *it,
-    atomic_uintptr_t *head, ll_commit_id_t *commit_id)
+static bool eras_pin(const eras_t *e, const versioned_node_t *w)
 {
-    it->head = head;
-    it->commit_id = commit_id;
+    uint64_t rid = atomic_load_explicit(&w->removed_txn_id, memory_order_relaxed);
+    for (int i = 0; i < e->n; i++)
+        if (e->era[i] < rid && (e->shared[i] || e->era[i] >= w->insert_txn_id))
+            return true;
+    return false;
+}
+
+/*
+ * Quiescent-state-based reclamation for lists in QSBR mode (LL_SET_QSBR),
+ * whose plain readers publish nothing. Each online reader thread records
+ * in qsbr_seen the grace period it last saw at a quiescent point (0 while
+ * offline). Reclaim opens a new period when it fills limbo and frees
+ * nothing from it until every online thread has seen that period, i.e.
+ * passed a quiescent point since the nodes were unlinked.
+ */
+static _Atomic(uint64_t) qsbr_period = 1;
+static _Atomic(uint64_t) qsbr_seen[MAX_THREADS];
+
+static bool qsbr_past(uint64_t period)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    for (int i = 0; i < MAX_THREADS; i++) {
+        uint64_t seen = atomic_load_explicit(&qsbr_seen[i], memory_order_acquire);
+        if (seen && seen < period)
+            return false;
+    }
+    return true;
+}
+
+int ll_qsbr_online(void)
+{
+    int i = thread_slot();
+    if (i < 0)
+        return -1;   /* qsbr_past could not wait for this thread */
+    atomic_store_explicit(&qsbr_seen[i],
+                          atomic_load_explicit(&qsbr_period, memory_order_acquire),
+                          memory_order_seq_cst);
+    return 0;
+}
+
+void ll_qsbr_offline(void)
+{
+    if (my_slot >= 0)
+        atomic_store_explicit(&qsbr_seen[my_slot], (uint64_t)0,
+                              memory_order_release);
+}
+
+void ll_quiescent_state(void)
+{
+    if (my_slot >= 0 &&
+        atomic_load_explicit(&qsbr_seen[my_slot], memory_order_relaxed))
+        atomic_store_explicit(&qsbr_seen[my_slot],
+                              atomic_load_explicit(&qsbr_period, memory_order_acquire),
+                              memory_order_release);
+}
+
+static void splice(versioned_node_t **dst, versioned_node_t *chain)
+{
+    if (!chain)
+        return;
+    versioned_node_t *t = chain;
+    while (t->retire_next)
+        t = t->retire_next;
+    t->retire_next = *dst;
+    *dst = chain;
+}
+
+/*
+ * Batched disposal (LL_SET_FREE_BATCH): a reclaim pass collects the
+ * elements it frees into one batch and hands it to the list's batch
+ * callback once the pass is over, either on the spot or through a queue
+ * drained by the deferred-free thread. Batches carry their callback and a
+ * copy of the list's allocator, so they do not depend on the list once
+ * queued.
+ */
+#define FREE_BATCH_MIN 64
+
+typedef struct free_batch {
+    struct free_batch *next;     /* in free_queue */
+    ll_free_batch_fn fn;
+    ll_allocator_t alloc;
+    size_t n, cap;
+    void *elms[];
+} free_batch_t;
+
+static atomic_uintptr_t free_queue;
+static _Atomic(uint64_t) free_queued, free_done;   /* batches, for ll_free_flush */
+static _Atomic(int) free_sleeping;
+static _Atomic(int) free_running;   /* free_th is up; set and cleared under free_mu */
+static bool free_stop;              /* under free_mu: exit once the queue is empty */
+static pthread_t free_th;
+static pthread_mutex_t free_mu = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t free_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t free_drained = PTHREAD_COND_INITIALIZER;
+
+static size_t batch_size(size_t cap)
+{
+    return sizeof(free_batch_t) + cap * sizeof(void *);
+}
+
+static void batch_free(free_batch_t *b)
+{
+    if (b->alloc.free)
+        b->alloc.free(b, batch_size(b->cap), alignof(free_batch_t), b->alloc.ctx);
+    else
+        free(b);
+}
+
+/* Add elm to *bp, growing it as needed; false if that fails. */
+static bool batch_add(const ll_ctl_t *ctl, free_batch_t **bp, void *elm)
+{
+    free_batch_t *b = *bp;
+    if (!b || b->n == b->cap) {
+        size_t cap = b ? b->cap * 2 : FREE_BATCH_MIN;
+        free_batch_t *nb = (free_batch_t *)mem_alloc(ctl, batch_size(cap), alignof(free_batch_t));
+        if (!nb)
+            return false;
+        nb->next = NULL;
+        nb->fn = ctl->free_batch;
+        nb->alloc = ctl->alloc;
+        nb->cap = cap;
+        nb->n = 0;
+        if (b) {
+            memcpy(nb->elms, b->elms, b->n * sizeof(void *));
+            nb->n = b->n;
+            batch_free(b);
+        }
+        *bp = b = nb;
+    }
+    b->elms[b->n++] = elm;
+    return true;
+}
+
+/* Run and free a chain of queued batches. */
+static void batches_run(free_batch_t *b)
+{
+    while (b) {
+        free_batch_t *next = b->next;
+        b->fn(b->elms, b->n);
+        batch_free(b);
+        atomic_fetch_add_explicit(&free_done, 1, memory_order_release);
+        b = next;
+    }
+}
+
+static void *free_thread(void *unused)
+{
+    (void)unused;
+    for (;;) {
+        free_batch_t *b = (free_batch_t *)atomic_exchange_explicit(&free_queue, (uintptr_t)0,
+                                                                  memory_order_acquire);
+        if (!b) {
+            pthread_mutex_lock(&free_mu);
+            pthread_cond_broadcast(&free_drained);
+            atomic_store_explicit(&free_sleeping, 1, memory_order_seq_cst);
+            while (!atomic_load_explicit(&free_queue, memory_order_seq_cst) && !free_stop)
+                pthread_cond_wait(&free_wake, &free_mu);
+            atomic_store_explicit(&free_sleeping, 0, memory_order_relaxed);
+            bool stop = free_stop && !atomic_load_explicit(&free_queue, memory_order_seq_cst);
+            pthread_mutex_unlock(&free_mu);
+            if (stop)
+                return NULL;
+            continue;
+        }
+        batches_run(b);
+    }
+}
+
+/* Start the deferred-free thread unless it is up; false if it cannot be started. */
+static bool free_thread_up(void)
+{
+    if (atomic_load_explicit(&free_running, memory_order_acquire))
+        return true;
+    pthread_mutex_lock(&free_mu);
+    if (!atomic_load_explicit(&free_running, memory_order_relaxed) &&
+        pthread_create(&free_th, NULL, free_thread, NULL) == 0)
+        atomic_store_explicit(&free_running, 1, memory_order_release);
+    pthread_mutex_unlock(&free_mu);
+    return atomic_load_explicit(&free_running, memory_order_acquire);
+}
+
+/* Dispose of a pass's batch: queue it for the deferred-free thread, or run it here. */
+static void batch_dispatch(const ll_ctl_t *ctl, free_batch_t *b)
+{
+    if (!b)
+        return;
+    if (ctl->free_deferred) {
+        if (free_thread_up()) {
+            uintptr_t top = atomic_load_explicit(&free_queue, memory_order_relaxed);
+            do {
+                b->next = (free_batch_t *)top;
+            } while (!atomic_compare_exchange_weak_explicit(&free_queue, &top, (uintptr_t)b,
+                                                            memory_order_seq_cst, memory_order_relaxed));
+            atomic_fetch_add_explicit(&free_queued, 1, memory_order_relaxed);
+            if (atomic_load_explicit(&free_sleeping, memory_order_seq_cst)) {
+                pthread_mutex_lock(&free_mu);
+                pthread_cond_signal(&free_wake);
+                pthread_mutex_unlock(&free_mu);
+            }
+            return;
+        }
+    }
+    b->fn(b->elms, b->n);
+    batch_free(b);
+}
+
+void ll_free_flush(void)
+{
+    uint64_t target = atomic_load_explicit(&free_queued, memory_order_relaxed);
+    if (atomic_load_explicit(&free_done, memory_order_acquire) >= target)
+        return;
+    pthread_mutex_lock(&free_mu);
+    while (atomic_load_explicit(&free_done, memory_order_acquire) < target)
+        pthread_cond_wait(&free_drained, &free_mu);
+    pthread_mutex_unlock(&free_mu);
+}
+
+void ll_free_shutdown(void)
+{
+    pthread_mutex_lock(&free_mu);
+    if (!atomic_load_explicit(&free_running, memory_order_relaxed)) {
+        pthread_mutex_unlock(&free_mu);
+        return;
+    }
+    free_stop = true;
+    pthread_cond_signal(&free_wake);
+    pthread_mutex_unlock(&free_mu);
+    pthread_join(free_th, NULL);
+    /* A batch queued as the thread left: run it here. */
+    batches_run((free_batch_t *)atomic_exchange_explicit(&free_queue, (uintptr_t)0,
+                                                         memory_order_acquire));
+    pthread_mutex_lock(&free_mu);
+    free_stop = false;
+    atomic_store_explicit(&free_running, 0, memory_order_relaxed);
+    pthread_cond_broadcast(&free_drained);
+    pthread_mutex_unlock(&free_mu);
+}
+
+/*
+ * Free what no era (or the walk cursor) pins; keep the rest. With a batch
+ * to fill (batchp), the elements go there instead of to free_cb.
+ */
+static void reclaim_free(ll_ctl_t *ctl, versioned_node_t **list, const eras_t *eras,
+                         void (*free_cb)(void *), free_batch_t **batchp)
+{
+    versioned_node_t *cursor = atomic_load_explicit(&ctl->cursor, memory_order_seq_cst);
+    versioned_node_t *n = *list, *still_held = NULL;
+    while (n) {
+        versioned_node_t *next = n->retire_next;
+        if (n == cursor || eras_pin(eras, n)) {
+            n->retire_next = still_held;
+            still_held = n;
+        } else {
+            void *user = n->user_elm;
+            node_free(ctl, n);
+            atomic_fetch_sub_explicit(&ctl->garbage, 1, memory_order_relaxed);
+            if (batchp) {
+                if (!batch_add(ctl, batchp, user))
+                    ctl->free_batch(&user, 1);
+            } else if (free_cb) {
+                free_cb(user);
+            }
+        }
+        n = next;
+    }
+    *list = still_held;
+}
+
+static void reclaim(atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl,
+                    void (*free_cb)(void *), bool force)
+{
+    uint64_t min_active = min_active_snapshot(ctl->domain);
+    if (min_active == UINT64_MAX)
+        min_active = atomic_load_explicit(commit_id, memory_order_acquire);
+    /* Nothing new, nothing held is reclaimable yet, nothing waiting to be freed. */
+    if (!atomic_load_explicit(&ctl->pending, memory_order_acquire) &&
+        !atomic_load_explicit(&ctl->popped, memory_order_acquire) &&
+        !atomic_load_explicit(&ctl->backlog, memory_order_acquire) &&
+        atomic_load_explicit(&ctl->held_min_rid, memory_order_acquire) >= min_active)
+        return;
+    if (atomic_load_explicit(&ctl->reclaiming, memory_order_relaxed) ||
+        atomic_exchange_explicit(&ctl->reclaiming, 1, memory_order_acquire))
+        return;   /* the thread reclaiming this list will get to it */
+
+    uint64_t held_min = atomic_load_explicit(&ctl->held_min_rid, memory_order_relaxed);
+    reclaim_adopt(ctl, &held_min);
+    if (held_min < min_active && (ctl->credit || force)) {
+        walk_pin_t pin = walk_pin(ctl->domain, commit_id);
+        ctl->n_unlinked += reclaim_walk(head, ctl, min_active, force);
+        walk_unpin(&pin);
+    }
+
+    /* Limbo holds one generation at a time; refill it once the last one has drained. */
+    bool limbo = ctl->limbo[0] || ctl->limbo[1];
+    if (!limbo) {
+        /* Sweep held once a quarter of it is unlinked, so sweeps stay linear overall. */
+        if (ctl->n_unlinked && (force || ctl->n_unlinked * 4 >= ctl->n_held))
+            held_min = reclaim_sweep(ctl, &ctl->limbo[0]);
+        ctl->limbo[1] = get_wrapper(atomic_exchange_explicit(&ctl->popped, (uintptr_t)0,
+                                                             memory_order_acquire));
+        limbo = ctl->limbo[0] || ctl->limbo[1];
+        if (limbo) {
+            ctl->limbo_epoch = atomic_load_explicit(commit_id, memory_order_seq_cst);
+            if (ctl->qsbr)
+                ctl->limbo_period = atomic_fetch_add_explicit(&qsbr_period, 1, memory_order_seq_cst) + 1;
+        }
+    }
+    eras_t eras;
+    if (limbo || ctl->retired[0] || ctl->retired[1])
+        eras_scan(ctl->domain, &eras);
+    if (limbo && eras.walk_min > ctl->limbo_epoch &&
+        (!ctl->qsbr || qsbr_past(ctl->limbo_period))) {
+        splice(&ctl->retired[0], ctl->limbo[0]);
+        splice(&ctl->retired[1], ctl->limbo[1]);
+        ctl->limbo[0] = ctl->limbo[1] = NULL;
+        limbo = false;
+    }
+    free_batch_t *batch = NULL;
+    reclaim_free(ctl, &ctl->retired[0], &eras, free_cb, ctl->free_batch ? &batch : NULL);
+    reclaim_free(ctl, &ctl->retired[1], &eras, NULL, NULL);
+
+    atomic_store_explicit(&ctl->held_min_rid, held_min, memory_order_relaxed);
+    atomic_store_explicit(&ctl->backlog, limbo || ctl->retired[0] || ctl->retired[1],
+                          memory_order_relaxed);
+    atomic_store_explicit(&ctl->reclaiming, 0, memory_order_release);
+    batch_dispatch(ctl, batch);
+}
+
+/*
+ * Backpressure for LL_SET_GARBAGE_LIMIT: over the limit, reclaim in full;
+ * still over (an old snapshot holds the nodes, or another thread is
+ * reclaiming) and allowed to wait, back off and try again.
+ */
+static void garbage_check(atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl,
+                          void (*free_cb)(void *))
+{
+    size_t limit = ctl->garbage_limit;
+    if (!limit || atomic_load_explicit(&ctl->garbage, memory_order_relaxed) <= limit)
+        return;
+    atomic_fetch_add_explicit(&ctl->n_forced, 1, memory_order_relaxed);
+    reclaim(head, commit_id, ctl, free_cb, true);
+    long wait_ns = (long)ctl->garbage_wait_us * 1000;
+    if (!wait_ns || atomic_load_explicit(&ctl->garbage, memory_order_relaxed) <= limit)
+        return;
+    atomic_fetch_add_explicit(&ctl->n_throttled, 1, memory_order_relaxed);
+    struct timespec ts = {0, 1000};
+    while (wait_ns > 0 && atomic_load_explicit(&ctl->garbage, memory_order_relaxed) > limit) {
+        if (ts.tv_nsec > wait_ns)
+            ts.tv_nsec = wait_ns;
+        nanosleep(&ts, NULL);
+        wait_ns -= ts.tv_nsec;
+        if (ts.tv_nsec < 1000000)
+            ts.tv_nsec *= 2;
+        reclaim(head, commit_id, ctl, free_cb, true);
+    }
+}
+
+/* A fresh wrapper for elm, inserted at commit C; NULL on allocation failure. */
+static versioned_node_t *node_make(ll_ctl_t *ctl, void *elm, uint64_t C)
+{
+    versioned_node_t *w = node_alloc(ctl);
+    if (!w)
+        return NULL;
+    w->user_elm = elm;
+    w->insert_txn_id = C;
+    atomic_store_explicit(&w->removed_txn_id, (uint64_t)0, memory_order_release);
+    atomic_store_explicit(&w->next, (uintptr_t)0, memory_order_release);
+    w->retire_next = NULL;
+    return w;
+}
+
+/* Link the chain first..last in front of the current head. */
+static void link_head(atomic_uintptr_t *head, versioned_node_t *first, versioned_node_t *last)
+{
+    uintptr_t old_head;
+    do {
+        old_head = atomic_load_explicit(head, memory_order_acquire);
+        atomic_store_explicit(&last->next, old_head, memory_order_release);
+    } while (!atomic_compare_exchange_weak_explicit(head, &old_head, (uintptr_t)first,
+                                                    memory_order_release, memory_order_acquire));
+}
+
+/* Link the chain starting at first (last->next already 0) after the current tail. */
+static void link_tail(atomic_uintptr_t *head, versioned_node_t *first)
+{
+    for (;;) {
+        uintptr_t head_val = atomic_load_explicit(head, memory_order_acquire);
+        versioned_node_t *prev = get_wrapper(head_val);
+        if (!prev) {
+            if (atomic_compare_exchange_weak_explicit(head, &head_val, (uintptr_t)first,
+                                                      memory_order_release, memory_order_acquire))
+                return;
+            continue;
+        }
+        for (;;) {
+            uintptr_t next_val = atomic_load_explicit(&prev->next, memory_order_acquire);
+            versioned_node_t *next = get_wrapper(next_val);
+            if (!next)
+                break;
+            prev = next;
+        }
+        uintptr_t expected = (uintptr_t)0;
+        if (atomic_compare_exchange_weak_explicit(&prev->next, &expected, (uintptr_t)first,
+                                                  memory_order_release, memory_order_acquire))
+            return;
+        if (expected & 1)
+            sched_yield();  /* the tail is being unlinked */
+    }
+}
+
+/*
+ * A list in LL_SINGLE_WRITER or LL_SINGLE_THREADED mode has one thread
+ * making every change and running every reclaim, so its plain operations
+ * take ids with a load and a store instead of fetch_add, link and unlink
+ * with stores instead of CAS loops, and need no walk pin. A single writer
+ * publishes with release stores for its readers; a single thread needs no
+ * ordering at all. Unlinking still marks the node's next, which the
+ * reclaim cursor relies on.
+ */
+static inline memory_order solo_order(const ll_ctl_t *ctl)
+{
+    return ctl->threading == LL_SINGLE_THREADED ? memory_order_relaxed : memory_order_release;
+}
+
+static uint64_t solo_take_id(ll_commit_id_t *commit_id, const ll_ctl_t *ctl)
+{
+    uint64_t C = atomic_load_explicit(commit_id, memory_order_relaxed);
+    atomic_store_explicit(commit_id, C + 1, solo_order(ctl));
+    return C;
+}
+
+/* garbage_add and chain_push without the read-modify-writes. */
+static void solo_push(ll_ctl_t *ctl, atomic_uintptr_t *chain, versioned_node_t *w)
+{
+    size_t n = atomic_load_explicit(&ctl->garbage, memory_order_relaxed) + 1;
+    atomic_store_explicit(&ctl->garbage, n, memory_order_relaxed);
+    if (n > atomic_load_explicit(&ctl->garbage_peak, memory_order_relaxed))
+        atomic_store_explicit(&ctl->garbage_peak, n, memory_order_relaxed);
+    w->retire_next = get_wrapper(atomic_load_explicit(chain, memory_order_relaxed));
+    atomic_store_explicit(chain, (uintptr_t)w, memory_order_relaxed);
+}
+
+/* The link that points at the last node (the head if empty). */
+static atomic_uintptr_t *solo_tail_link(atomic_uintptr_t *head)
+{
+    atomic_uintptr_t *link = head;
+    versioned_node_t *w;
+    while ((w = get_wrapper(atomic_load_explicit(link, memory_order_relaxed))) != NULL)
+        link = &w->next;
+    return link;
+}
+
+static void solo_insert_after(atomic_uintptr_t *head, ll_ctl_t *ctl,
+                              void *after_elm, void *elm, uint64_t C)
+{
+    versioned_node_t *curr = get_wrapper(atomic_load_explicit(head, memory_order_relaxed));
+    while (curr && !(curr->user_elm == after_elm && visible(curr, C)))
+        curr = get_wrapper(atomic_load_explicit(&curr->next, memory_order_relaxed));
+    if (!curr)
+        return;   /* after_elm not in list */
+    versioned_node_t *w = node_make(ctl, elm, C);
+    if (!w)
+        return;
+    atomic_store_explicit(&w->next, atomic_load_explicit(&curr->next, memory_order_relaxed),
+                          memory_order_relaxed);
+    atomic_store_explicit(&curr->next, (uintptr_t)w, solo_order(ctl));
+}
+
+/* Claim and unlink the first node live at a fresh id; NULL if there is none. */
+static versioned_node_t *solo_pop(atomic_uintptr_t *head, ll_commit_id_t *commit_id,
+                                  const ll_ctl_t *ctl)
+{
+    uint64_t C = solo_take_id(commit_id, ctl);
+    atomic_uintptr_t *link = head;
+    versioned_node_t *w;
+    while ((w = get_wrapper(atomic_load_explicit(link, memory_order_relaxed))) != NULL &&
+           (w->insert_txn_id > C || atomic_load_explicit(&w->removed_txn_id, memory_order_relaxed)))
+        link = &w->next;
+    if (!w)
+        return NULL;
+    uintptr_t succ = atomic_load_explicit(&w->next, memory_order_relaxed);
+    atomic_store_explicit(&w->removed_txn_id, C, solo_order(ctl));
+    atomic_store_explicit(&w->next, succ | 1, memory_order_relaxed);
+    atomic_store_explicit(link, succ, solo_order(ctl));
+    return w;
+}
+
+static bool solo_mark_one(atomic_uintptr_t *head, ll_ctl_t *ctl, const void *elm, uint64_t C)
+{
+    versioned_node_t *curr = get_wrapper(atomic_load_explicit(head, memory_order_relaxed));
+    for (; curr; curr = get_wrapper(atomic_load_explicit(&curr->next, memory_order_relaxed))) {
+        if (curr->user_elm == elm &&
+            !atomic_load_explicit(&curr->removed_txn_id, memory_order_relaxed)) {
+            atomic_store_explicit(&curr->removed_txn_id, C, solo_order(ctl));
+            solo_push(ctl, &ctl->pending, curr);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ll_insert_head_(atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl, void *elm)
+{
+    if (ctl->threading) {
+        versioned_node_t *w = node_make(ctl, elm, solo_take_id(commit_id, ctl));
+        if (w) {
+            atomic_store_explicit(&w->next, atomic_load_explicit(head, memory_order_relaxed),
+                                  memory_order_relaxed);
+            atomic_store_explicit(head, (uintptr_t)w, solo_order(ctl));
+        }
+        return;
+    }
+    uint64_t C = atomic_fetch_add_explicit(commit_id, 1, memory_order_acq_rel);
+    versioned_node_t *w = node_make(ctl, elm, C);
+    if (w)
+        link_head(head, w, w);
+}
+
+void ll_insert_tail_(atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl, void *elm)
+{
+    if (ctl->threading) {
+        versioned_node_t *w = node_make(ctl, elm, solo_take_id(commit_id, ctl));
+        if (w)
+            atomic_store_explicit(solo_tail_link(head), (uintptr_t)w, solo_order(ctl));
+        return;
+    }
+    uint64_t C = atomic_fetch_add_explicit(commit_id, 1, memory_order_acq_rel);
+    versioned_node_t *w = node_make(ctl, elm, C);
+    if (!w)
+        return;
+    walk_pin_t pin = walk_pin(ctl->domain, commit_id);
+    link_tail(head, w);
+    walk_unpin(&pin);
+}
+
+/* Insert elm after the node whose user_elm is after_elm, as of commit C. Lock-free. */
+static void insert_after_at(atomic_uintptr_t *head, ll_ctl_t *ctl,
+                            void *after_elm, void *elm, uint64_t C)
+{
+    uint64_t S = C; /* visibility for finding after_elm: current commit */
+    versioned_node_t *w = node_make(ctl, elm, C);
+    if (!w)
+        return;
+
+    for (;;) {
+        uintptr_t head_val = atomic_load_explicit(head, memory_order_acquire);
+        versioned_node_t *curr = get_wrapper(head_val);
+        if (!curr) {
+            node_free(ctl, w);
+            return; /* after_elm not in list */
+        }
+        while (curr) {
+            if (curr->user_elm == after_elm && visible(curr, S)) {
+                uintptr_t old_next = atomic_load_explicit(&curr->next, memory_order_acquire);
+                if (old_next & 1)
+                    break;      /* anchor is being unlinked: look again */
+                atomic_store_explicit(&w->next, old_next, memory_order_release);
+                if (atomic_compare_exchange_weak_explicit(&curr->next, &old_next, (uintptr_t)w,
+                                                         memory_order_release, memory_order_acquire))
+                    return;
+                /* CAS failed: retry with fresh next */
+                continue;
+            }
+            versioned_node_t *next = get_wrapper(atomic_load_explicit(&curr->next, memory_order_acquire));
+            if (!next) {
+                node_free(ctl, w);
+                return; /* after_elm not found */
+            }
+            curr = next;
+        }
+    }
+}
+
+void ll_insert_after_(atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl,
+                      void *after_elm, void *elm)
+{
+    if (ctl->threading) {
+        solo_insert_after(head, ctl, after_elm, elm, solo_take_id(commit_id, ctl));
+        return;
+    }
+    uint64_t C = atomic_fetch_add_explicit(commit_id, 1, memory_order_acq_rel);
+    walk_pin_t pin = walk_pin(ctl->domain, commit_id);
+    insert_after_at(head, ctl, after_elm, elm, C);
+    walk_unpin(&pin);
+}
+
+/*
+ * head and commit_id side by side form a tagged pointer: where the build
+ * has a double-width CAS (x86-64 cmpxchg16b, -mcx16) and LL_HEAD's
+ * alignment put them in one 16-byte word, remove_head swaps the head out
+ * and takes its commit id in a single CAS, the commit id doubling as the
+ * ABA tag. Anything else takes the portable path.
+ */
+#if defined(__x86_64__) && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+#define HAVE_TAGGED_HEAD 1
+typedef unsigned __int128 tagged_t;
+
+/*
+ * Mixed-size atomics: the 16-byte CAS below overlaps commit_id, which
+ * every other path updates with 8-byte fetch_adds and stores and reads
+ * with 8-byte loads. C11 leaves that undefined; x86-64 defines it. A
+ * lock cmpxchg16b on an aligned word and a locked 8-byte RMW on half of
+ * it are ordered against each other like any two locked operations, and
+ * an aligned 8-byte load sees one half either before or after the CAS.
+ * Keep this path on x86-64 only.
+ */
+#ifndef __x86_64__
+#error "pop_tagged's mixed-size atomics are only defined on x86-64"
+#endif
+_Static_assert(sizeof(atomic_uintptr_t) == 8 && sizeof(ll_commit_id_t) == 8 &&
+               sizeof(tagged_t) == 16,
+               "head and commit_id must split the tagged word in two halves");
+
+static inline bool tagged_head(atomic_uintptr_t *head, ll_commit_id_t *commit_id)
+{
+    return (uintptr_t)commit_id == (uintptr_t)head + sizeof(uintptr_t) &&
+           ((uintptr_t)head & (sizeof(tagged_t) - 1)) == 0;
+}
+
+static inline bool tagged_cas(atomic_uintptr_t *head, uintptr_t w, uint64_t c,
+                              uintptr_t succ, uint64_t c_new)
+{
+    return __sync_bool_compare_and_swap((tagged_t *)(void *)head,
+                                        (tagged_t)c << 64 | w, (tagged_t)c_new << 64 | succ);
+}
+
+/* removed_txn_id of a head node remove_head has claimed but not yet stamped; still visible. */
+#define RID_CLAIMED UINT64_MAX
+
+/*
+ * Pop the head node if it is live: claim it, mark it, then move the head
+ * to its successor and the commit id from c to c + 1 in one CAS, stamping
+ * the node removed at c. If an insert_head got in front meanwhile, fall
+ * back to a fresh id and an ordinary unlink. NULL (nothing changed) when
+ * the head node is not poppable; the caller then walks.
+ */
+static versioned_node_t *pop_tagged(atomic_uintptr_t *head, ll_commit_id_t *commit_id)
+{
+    uint64_t c = atomic_load_explicit(commit_id, memory_order_acquire);
+    versioned_node_t *w = get_wrapper(atomic_load_explicit(head, memory_order_acquire));
+    uint64_t live = 0;
+    if (!w || w->insert_txn_id > c ||
+        !atomic_compare_exchange_strong_explicit(&w->removed_txn_id, &live, RID_CLAIMED,
+                                                 memory_order_acq_rel, memory_order_relaxed))
+        return NULL;
+    mark_next(w);   /* nobody else marks a node that is not removed */
+    uintptr_t succ = (uintptr_t)get_wrapper(atomic_load_explicit(&w->next, memory_order_acquire));
+    while (get_wrapper(atomic_load_explicit(head, memory_order_acquire)) == w) {
+        if (tagged_cas(head, (uintptr_t)w, c, succ, c + 1)) {
+            atomic_store_explicit(&w->removed_txn_id, c, memory_order_release);
+            return w;
+        }
+        c = atomic_load_explicit(commit_id, memory_order_acquire);
+    }
+    c = atomic_fetch_add_explicit(commit_id, 1, memory_order_acq_rel);
+    atomic_store_explicit(&w->removed_txn_id, c, memory_order_release);
+    unlink_marked(head, NULL, w);
+    return w;
+}
+#endif
+
+/* Portable pop: take a fresh id, then claim and unlink the first node live at it. */
+static versioned_node_t *pop_walk(atomic_uintptr_t *head, ll_commit_id_t *commit_id)
+{
+    uint64_t C = atomic_fetch_add_explicit(commit_id, 1, memory_order_acq_rel);
+    versioned_node_t *prev = NULL;
+    versioned_node_t *curr = get_wrapper(atomic_load_explicit(head, memory_order_acquire));
+    while (curr) {
+        uint64_t live = 0;
+        if (curr->insert_txn_id <= C &&
+            atomic_compare_exchange_strong_explicit(&curr->removed_txn_id, &live, C,
+                                                    memory_order_acq_rel, memory_order_relaxed))
+            break;
+        prev = curr;
+        curr = get_wrapper(atomic_load_explicit(&curr->next, memory_order_acquire));
+    }
+    if (curr) {
+        mark_next(curr);
+        unlink_marked(head, prev, curr);
+    }
+    return curr;
+}
+
+/*
+ * Dispose of the wrapper of a popped node, already unlinked and unpinned.
+ * It goes through ctl->popped and limbo like any removed node, unless no
+ * reader can still reach it: without QSBR every walk, plain reads included,
+ * pins its era, so once all eras are past the unlink and neither a
+ * transaction's era nor the reclaim cursor is on the node it is freed at
+ * once; a thread without a slot walking holds walk_min at 0. A pop
+ * that frees at once also runs a pass while earlier pops' wrappers wait,
+ * and so does every POP_RECLAIM_EVERY'th deferred one, so pop-only use
+ * does not pile up garbage waiting for a commit.
+ */
+#define POP_RECLAIM_EVERY 64
+
+static void pop_retire(atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl,
+                       void (*free_cb)(void *), versioned_node_t *w)
+{
+    bool readers_pinned = !ctl->qsbr;
+    uint64_t unlinked_at = atomic_load_explicit(commit_id, memory_order_seq_cst);
+    eras_t eras;
+    if (readers_pinned)
+        eras_scan(ctl->domain, &eras);
+    if (readers_pinned && eras.walk_min > unlinked_at && !eras_pin(&eras, w) &&
+        w != atomic_load_explicit(&ctl->cursor, memory_order_seq_cst)) {
+        node_free(ctl, w);
+        if (atomic_load_explicit(&ctl->popped, memory_order_relaxed))
+            reclaim(head, commit_id, ctl, free_cb, false);
+        return;
+    }
+    if (ctl->threading) {
+        solo_push(ctl, &ctl->popped, w);
+    } else {
+        garbage_add(ctl);
+        chain_push(&ctl->popped, w, w);
+    }
+    if (atomic_load_explicit(&ctl->garbage, memory_order_relaxed) % POP_RECLAIM_EVERY == 0)
+        reclaim(head, commit_id, ctl, free_cb, false);
+    garbage_check(head, commit_id, ctl, free_cb);
+}
+
+/*
+ * Pop the first element nobody has removed. The node is claimed by setting
+ * its removed_txn_id, which keeps committers off it; the walk pin is at or
+ * below that id until the node is unlinked, which keeps reclaim off it too.
+ */
+void *ll_remove_head_(atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl,
+                      void (*free_cb)(void *))
+{
+    walk_pin_t pin = {NULL, NULL, 0, 0};
+    versioned_node_t *curr = NULL;
+    if (ctl->threading) {
+        curr = solo_pop(head, commit_id, ctl);
+    } else {
+        pin = walk_pin(ctl->domain, commit_id);
+#ifdef HAVE_TAGGED_HEAD
+        if (tagged_head(head, commit_id))
+            curr = pop_tagged(head, commit_id);
+#endif
+        if (!curr)
+            curr = pop_walk(head, commit_id);
+    }
+    void *user = curr ? curr->user_elm : NULL;
+    walk_unpin(&pin);
+    if (curr)
+        pop_retire(head, commit_id, ctl, free_cb, curr);
+    return user;
+}
+
+/* Mark the first live wrapper of elm removed at C; false if there is none. */
+static bool mark_one(atomic_uintptr_t *head, ll_ctl_t *ctl, const void *elm, uint64_t C)
+{
+    versioned_node_t *curr = get_wrapper(atomic_load_explicit(head, memory_order_acquire));
+    for (; curr; curr = get_wrapper(atomic_load_explicit(&curr->next, memory_order_acquire))) {
+        uint64_t live = 0;
+        if (curr->user_elm == elm &&
+            atomic_compare_exchange_strong_explicit(&curr->removed_txn_id, &live, C,
+                                                    memory_order_release, memory_order_relaxed)) {
+            pending_push(ctl, curr);
+            return true;
+        }
+    }
+    return false;
+}
+
+int ll_remove_(atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl,
+               void (*free_cb)(void *), void *elm)
+{
+    bool found;
+    if (ctl->threading) {
+        found = solo_mark_one(head, ctl, elm, solo_take_id(commit_id, ctl));
+    } else {
+        uint64_t C = atomic_fetch_add_explicit(commit_id, 1, memory_order_acq_rel);
+        walk_pin_t pin = walk_pin(ctl->domain, commit_id);
+        found = mark_one(head, ctl, elm, C);
+        walk_unpin(&pin);
+    }
+    if (found)
+        garbage_check(head, commit_id, ctl, free_cb);
+    return found ? 0 : -1;
+}
+
+/*
+ * --- Ordered lists (LL_SET_ORDER) ---
+ * An ordered insert links its node in front of the first node whose
+ * element sorts after it. Removed nodes keep their place until unlinked,
+ * so everything linked stays sorted and the first live node is the
+ * minimum. The link is a CAS on the predecessor's next, which fails while
+ * the predecessor is being unlinked, as for insert_after.
+ */
+static void insert_ordered_at(atomic_uintptr_t *head, const ll_ctl_t *ctl, versioned_node_t *w)
+{
+    for (;;) {
+        atomic_uintptr_t *link = head;
+        uintptr_t v = atomic_load_explicit(link, memory_order_acquire);
+        versioned_node_t *curr;
+        while ((curr = get_wrapper(v)) != NULL && ctl->order(curr->user_elm, w->user_elm) <= 0) {
+            link = &curr->next;
+            v = atomic_load_explicit(link, memory_order_acquire);
+        }
+        if (v & 1) {
+            sched_yield();   /* the predecessor is being unlinked */
+            continue;
+        }
+        atomic_store_explicit(&w->next, v, memory_order_relaxed);
+        if (atomic_compare_exchange_strong_explicit(link, &v, (uintptr_t)w,
+                                                    memory_order_release, memory_order_relaxed))
+            return;
+    }
+}
+
+/* insert_ordered_at for the one writer: nothing else links or unlinks meanwhile. */
+static void solo_insert_ordered(atomic_uintptr_t *head, const ll_ctl_t *ctl, versioned_node_t *w)
+{
+    atomic_uintptr_t *link = head;
+    versioned_node_t *curr;
+    while ((curr = get_wrapper(atomic_load_explicit(link, memory_order_relaxed))) != NULL &&
+           ctl->order(curr->user_elm, w->user_elm) <= 0)
+        link = &curr->next;
+    atomic_store_explicit(&w->next, atomic_load_explicit(link, memory_order_relaxed),
+                          memory_order_relaxed);
+    atomic_store_explicit(link, (uintptr_t)w, solo_order(ctl));
+}
+
+void ll_insert_ordered_(atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl, void *elm)
+{
+    if (ctl->threading) {
+        versioned_node_t *w = node_make(ctl, elm, solo_take_id(commit_id, ctl));
+        if (w)
+            solo_insert_ordered(head, ctl, w);
+        return;
+    }
+    uint64_t C = atomic_fetch_add_explicit(commit_id, 1, memory_order_acq_rel);
+    versioned_node_t *w = node_make(ctl, elm, C);
+    if (!w)
+        return;
+    walk_pin_t pin = walk_pin(ctl->domain, commit_id);
+    insert_ordered_at(head, ctl, w);
+    walk_unpin(&pin);
+}
+
+/*
+ * Relaxed delete-min (LL_SET_RELAXED_MIN), after the SprayList: skip a
+ * random number of live nodes below the spray width and claim the next,
+ * moving on if another remover got it first. With fewer live nodes than
+ * the skip, start over and take the first. Under LL_SET_THREADING there is
+ * only one remover, and delete-min is the strict solo pop.
+ */
+static _Thread_local uint32_t spray_seed;
+
+static unsigned spray_pick(unsigned width)
+{
+    uint32_t x = spray_seed ? spray_seed : (uint32_t)(uintptr_t)&spray_seed | 1;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    spray_seed = x;
+    return x % width;
+}
+
+static versioned_node_t *pop_spray(atomic_uintptr_t *head, ll_commit_id_t *commit_id, unsigned width)
+{
+    uint64_t C = atomic_fetch_add_explicit(commit_id, 1, memory_order_acq_rel);
+    for (unsigned skip = spray_pick(width);; skip = 0) {
+        versioned_node_t *prev = NULL;
+        versioned_node_t *curr = get_wrapper(atomic_load_explicit(head, memory_order_acquire));
+        for (unsigned seen = 0; curr;
+             prev = curr, curr = get_wrapper(atomic_load_explicit(&curr->next, memory_order_acquire))) {
+            uint64_t live = 0;
+            if (curr->insert_txn_id > C ||
+                atomic_load_explicit(&curr->removed_txn_id, memory_order_acquire) || seen++ < skip)
+                continue;
+            if (atomic_compare_exchange_strong_explicit(&curr->removed_txn_id, &live, C,
+                                                        memory_order_acq_rel, memory_order_relaxed)) {
+                mark_next(curr);
+                unlink_marked(head, prev, curr);
+                return curr;
+            }
+        }
+        if (!skip)
+            return NULL;
+    }
+}
+
+void *ll_remove_min_(atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl,
+                     void (*free_cb)(void *))
+{
+    if (ctl->spray < 2 || ctl->threading)   /* one remover: nobody to spread out from */
+        return ll_remove_head_(head, commit_id, ctl, free_cb);
+    walk_pin_t pin = walk_pin(ctl->domain, commit_id);
+    versioned_node_t *curr = pop_spray(head, commit_id, ctl->spray);
+    void *user = curr ? curr->user_elm : NULL;
+    walk_unpin(&pin);
+    if (curr)
+        pop_retire(head, commit_id, ctl, free_cb, curr);
+    return user;
+}
+
+bool ll_contains_(atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl,
+                  const void *elm)
+{
+    walk_pin_t pin = ll_read_pin_(ctl, commit_id);
+    uint64_t S = atomic_load_explicit(commit_id, memory_order_acquire);
+    versioned_node_t *curr = get_wrapper(atomic_load_explicit(head, memory_order_acquire));
+    while (curr && !(curr->user_elm == elm && visible(curr, S)))
+        curr = get_wrapper(atomic_load_explicit(&curr->next, memory_order_acquire));
+    walk_unpin(&pin);
+    return curr != NULL;
+}
+
+bool ll_is_empty_(atomic_uintptr_t *head)
+{
+    return get_wrapper(atomic_load_explicit(head, memory_order_acquire)) == NULL;
+}
+
+size_t ll_size_(atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl)
+{
+    walk_pin_t pin = ll_read_pin_(ctl, commit_id);
+    uint64_t S = atomic_load_explicit(commit_id, memory_order_acquire);
+    size_t n = 0;
+    versioned_node_t *curr = get_wrapper(atomic_load_explicit(head, memory_order_acquire));
+    while (curr) {
+        if (visible(curr, S))
+            n++;
+        curr = get_wrapper(atomic_load_explicit(&curr->next, memory_order_acquire));
+    }
+    walk_unpin(&pin);
+    return n;
+}
+
+/*
+ * Parallel snapshot scans (LL_PARALLEL_CALLBACKS, LL_SNAPSHOT_REDUCE).
+ * Only the per-element work is parallel; the walk is not. The calling
+ * thread holds a walk pin for the whole scan and reads S after taking it,
+ * so no element visible at S is freed before the scan ends. It walks the chain alone and
+ * copies the elements visible at S into chunks of PAR_CHUNK, queueing each
+ * once it is full; workers claim chunks in order and run over their
+ * arrays. Only the caller follows next pointers, so a node unlinked
+ * meanwhile (by a pop, or the relaxed delete-min from the middle) cannot
+ * make a worker run past its chunk into the next one. A serial scan, or a
+ * chunk there is no memory for, is visited from a chunk on the stack as
+ * soon as it fills.
+ */
+#define PAR_CHUNK 512
+
+typedef struct par_chunk {
+    _Atomic(struct par_chunk *) next;
+    size_t n;
+    void *elm[PAR_CHUNK];
+} par_chunk_t;
+
+/* Visit elm[0..n) on behalf of worker "id". */
+typedef void (*par_visit_fn)(void *const *elm, size_t n, int id, void *arg);
+
+typedef struct {
+    par_chunk_t queue;           /* sentinel; chunks hang off queue.next */
+    _Atomic(par_chunk_t *) claimed;
+    _Atomic(int) split_done;
+    const ll_ctl_t *ctl;
+    uint64_t S;
+    bool serial;
+    par_visit_fn visit;
+    void *arg;
+} par_scan_t;
+
+typedef struct {
+    par_scan_t *scan;
+    int id;
+} par_worker_t;
+
+static void par_drain(par_scan_t *s, int id)
+{
+    for (;;) {
+        par_chunk_t *c = atomic_load_explicit(&s->claimed, memory_order_acquire);
+        par_chunk_t *n = atomic_load_explicit(&c->next, memory_order_acquire);
+        if (!n) {
+            if (atomic_load_explicit(&s->split_done, memory_order_acquire) &&
+                !atomic_load_explicit(&c->next, memory_order_acquire))
+                return;
+            sched_yield();
+            continue;
+        }
+        if (atomic_compare_exchange_weak_explicit(&s->claimed, &c, n,
+                                                  memory_order_acq_rel, memory_order_relaxed))
+            s->visit(n->elm, n->n, id, s->arg);
+    }
+}
+
+static void *par_worker(void *arg)
+{
+    par_worker_t *w = (par_worker_t *)arg;
+    par_drain(w->scan, w->id);
+    return NULL;
+}
+
+/* Queue a full (or the last) chunk after tail, or visit it here if it is the spare. */
+static par_chunk_t *par_queue(par_scan_t *s, par_chunk_t *tail, par_chunk_t *c,
+                              const par_chunk_t *spare)
+{
+    if (c == spare) {
+        s->visit(c->elm, c->n, 0, s->arg);
+        return tail;
+    }
+    atomic_store_explicit(&tail->next, c, memory_order_release);
+    return c;
+}
+
+static void par_split(par_scan_t *s, versioned_node_t *w)
+{
+    par_chunk_t spare, *tail = &s->queue, *c = NULL;
+    for (; w; w = get_wrapper(atomic_load_explicit(&w->next, memory_order_acquire))) {
+        if (!visible(w, s->S))
+            continue;
+        if (!c) {
+            c = s->serial ? NULL
+                          : (par_chunk_t *)mem_alloc(s->ctl, sizeof(*c), alignof(par_chunk_t));
+            if (!c)
+                c = &spare;
+            atomic_init(&c->next, NULL);
+            c->n = 0;
+        }
+        c->elm[c->n++] = w->user_elm;
+        if (c->n == PAR_CHUNK) {
+            tail = par_queue(s, tail, c, &spare);
+            c = NULL;
+        }
+    }
+    if (c)
+        par_queue(s, tail, c, &spare);
+    atomic_store_explicit(&s->split_done, 1, memory_order_release);
+}
+
+/*
+ * Run visit over every element visible at one pinned snapshot, from
+ * nthreads threads (worker ids 0..nthreads-1, 0 being the caller).
+ * Returns how many threads took part.
+ */
+static int par_scan(atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl,
+                    int nthreads, par_visit_fn visit, void *arg)
+{
+    walk_pin_t pin = walk_pin(ctl->domain, commit_id);
+    par_scan_t s;
+    s.queue.n = 0;
+    atomic_init(&s.queue.next, NULL);
+    atomic_init(&s.claimed, &s.queue);
+    atomic_init(&s.split_done, 0);
+    s.ctl = ctl;
+    s.S = atomic_load_explicit(commit_id, memory_order_acquire);
+    s.visit = visit;
+    s.arg = arg;
+    versioned_node_t *first = get_wrapper(atomic_load_explicit(head, memory_order_acquire));
+    if (nthreads > MAX_THREADS)
+        nthreads = MAX_THREADS;
+    s.serial = nthreads <= 1 || !first;
+    if (s.serial) {
+        par_split(&s, first);
+        walk_unpin(&pin);
+        return 1;
+    }
+
+    pthread_t th[MAX_THREADS];
+    par_worker_t w[MAX_THREADS];
+    int started = 0;
+    for (int i = 1; i < nthreads; i++) {
+        w[started] = (par_worker_t){ &s, started + 1 };
+        if (pthread_create(&th[started], NULL, par_worker, &w[started]) == 0)
+            started++;
+    }
+    par_split(&s, first);
+    par_drain(&s, 0);
+    for (int i = 0; i < started; i++)
+        pthread_join(th[i], NULL);
+    walk_unpin(&pin);
+
+    par_chunk_t *c = atomic_load_explicit(&s.queue.next, memory_order_relaxed);
+    while (c) {
+        par_chunk_t *next = atomic_load_explicit(&c->next, memory_order_relaxed);
+        mem_free(ctl, c, sizeof(*c), alignof(par_chunk_t));
+        c = next;
+    }
+    return started + 1;
+}
+
+typedef struct {
+    ll_txn_foreach_fn cb;
+    void *userdata;
+    _Atomic(size_t) visited;
+} par_foreach_t;
+
+static void foreach_visit(void *const *elm, size_t n, int id, void *arg)
+{
+    par_foreach_t *f = (par_foreach_t *)arg;
+    (void)id;
+    for (size_t i = 0; i < n; i++)
+        f->cb(elm[i], f->userdata);
+    atomic_fetch_add_explicit(&f->visited, n, memory_order_relaxed);
+}
+
+size_t ll_parallel_callbacks_(atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl,
+    int nthreads, ll_txn_foreach_fn cb, void *userdata)
+{
+    par_foreach_t f = { cb, userdata, 0 };
+    par_scan(head, commit_id, ctl, nthreads, foreach_visit, &f);
+    return atomic_load_explicit(&f.visited, memory_order_relaxed);
+}
+
+typedef struct {
+    const ll_reduce_ops_t *ops;
+    void *userdata;
+    char *partial;               /* one accumulator per thread, stride apart */
+    size_t stride;
+} par_reduce_t;
+
+static void reduce_visit(void *const *elm, size_t n, int id, void *arg)
+{
+    par_reduce_t *r = (par_reduce_t *)arg;
+    void *acc = r->partial + (size_t)id * r->stride;
+    for (size_t i = 0; i < n; i++)
+        r->ops->map(acc, elm[i], r->userdata);
+}
+
+int ll_snapshot_reduce_(atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl,
+    int nthreads, const ll_reduce_ops_t *ops, void *result, void *userdata)
+{
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > MAX_THREADS)
+        nthreads = MAX_THREADS;
+    /* Whole cache lines each, so the threads' accumulators don't share one. */
+    size_t stride = (ops->acc_size + 63) & ~(size_t)63;
+    par_reduce_t r = { ops, userdata, NULL, stride };
+    if (nthreads > 1 && !(r.partial = (char *)mem_alloc(ctl, stride * (size_t)nthreads, 64)))
+        return -1;
+    if (!r.partial)
+        r.partial = (char *)result;
+    for (int i = 0; i < nthreads; i++)
+        ops->identity(r.partial + (size_t)i * stride, userdata);
+    int used = par_scan(head, commit_id, ctl, nthreads, reduce_visit, &r);
+    if (r.partial != (char *)result) {
+        memcpy(result, r.partial, ops->acc_size);
+        for (int i = 1; i < used; i++)
+            ops->combine(result, r.partial + (size_t)i * stride, userdata);
+        mem_free(ctl, r.partial, stride * (size_t)nthreads, 64);
+    }
+    return 0;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p) ((void)(p))
+#endif
+
+/* Room for more than *cap pointers: a bigger block, keeping the first n. */
+static void **array_grow(const ll_allocator_t *arena, void **a, size_t n, size_t *cap)
+{
+    size_t nc = *cap * 2 + 16;
+    void **b;
+    if (arena) {
+        b = (void **)arena->alloc(nc * sizeof(void *), alignof(void *), arena->ctx);
+        if (b && n)
+            memcpy(b, a, n * sizeof(void *));
+    } else {
+        b = (void **)realloc(a, nc * sizeof(void *));
+    }
+    if (b)
+        *cap = nc;
+    return b;
+}
+
+/*
+ * Every node visible at S is alive, and so counted in ctl->nodes, from
+ * the walk pin until the unpin, except for the odd insert still being
+ * linked when S was read; the array grows for those. Each hop issues the
+ * load of the next node before checking this one.
+ */
+int ll_snapshot_to_array_(atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl,
+    uint64_t S, void ***out, size_t *n, const ll_allocator_t *arena)
+{
+    walk_pin_t pin = walk_pin(ctl->domain, commit_id);
+    if (!S)
+        S = atomic_load_explicit(commit_id, memory_order_acquire);
+    size_t cap = atomic_load_explicit(&ctl->nodes, memory_order_acquire), k = 0;
+    void **a = NULL;
+    if (cap) {
+        a = (void **)(arena ? arena->alloc(cap * sizeof(void *), alignof(void *), arena->ctx)
+                            : malloc(cap * sizeof(void *)));
+        if (!a)
+            goto fail;
+    }
+    versioned_node_t *w = get_wrapper(atomic_load_explicit(head, memory_order_acquire));
+    while (w) {
+        versioned_node_t *next = get_wrapper(atomic_load_explicit(&w->next, memory_order_acquire));
+        if (next)
+            PREFETCH(next);
+        if (visible(w, S)) {
+            if (k == cap) {
+                void **b = array_grow(arena, a, k, &cap);
+                if (!b)
+                    goto fail;
+                a = b;
+            }
+            a[k++] = w->user_elm;
+        }
+        w = next;
+    }
+    walk_unpin(&pin);
+    if (!k && !arena) {
+        free(a);
+        a = NULL;
+    }
+    *out = a;
+    *n = k;
+    return 0;
+
+fail:
+    walk_unpin(&pin);
+    if (!arena)
+        free(a);
+    *out = NULL;
+    *n = 0;
+    return -1;
+}
+
+/* --- Iterator (snapshot at current commit_id; pinned until it runs out or ends) --- */
+
+void ll_iter_begin(ll_iter_t *it,
+    atomic_uintptr_t *head, ll_commit_id_t *commit_id, ll_ctl_t *ctl)
+{
+    it->pin = ll_read_pin_(ctl, commit_id);
+    it->head = head;
+    it->commit_id = commit_id;
     it->snapshot_version = atomic_load_explicit(commit_id, memory_order_acquire);
     it->begun = 1;
     it->cur = get_wrapper(atomic_load_explicit(head, memory_order_acquire));
     while (it->cur && !visible((versioned_node_t *)it->cur, it->snapshot_version))
         it->cur = get_wrapper(atomic_load_explicit(&((versioned_node_t *)it->cur)->next, memory_order_acquire));
+    if (!it->cur)
+        ll_read_unpin_(&it->pin);
 }
 
 bool ll_iter_has(ll_iter_t *it)
@@ -398,33 +1948,316 @@ void ll_iter_next(ll_iter_t *it)
 {
     if (!it->cur)
         return;
-    versioned_node_t *w = (versioned_node_t *)it->cur;
-    it->cur = get_wrapper(atomic_load_explicit(&w->next, memory_order_acquire));
-    while (it->cur && !visible((versioned_node_t *)it->cur, it->snapshot_version))
-        it->cur = get_wrapper(atomic_load_explicit(&((versioned_node_t *)it->cur)->next, memory_order_acquire));
+    versioned_node_t *w = (versioned_node_t *)it->cur;
+    it->cur = get_wrapper(atomic_load_explicit(&w->next, memory_order_acquire));
+    while (it->cur && !visible((versioned_node_t *)it->cur, it->snapshot_version))
+        it->cur = get_wrapper(atomic_load_explicit(&((versioned_node_t *)it->cur)->next, memory_order_acquire));
+    if (!it->cur)
+        ll_read_unpin_(&it->pin);
+}
+
+void *ll_iter_get(ll_iter_t *it)
+{
+    return it->cur ? ((versioned_node_t *)it->cur)->user_elm : NULL;
+}
+
+void ll_iter_end(ll_iter_t *it)
+{
+    ll_read_unpin_(&it->pin);
+    it->cur = NULL;
+}
+
+/* --- Transaction: snapshot = commit_id at start; no copy --- */
+
+/*
+ * Each write set starts in a small buffer inside struct ll_txn and only
+ * moves to the heap past TXN_INLINE entries, so short transactions do no
+ * buffer allocations. Finished transactions that came from the C library
+ * allocator are kept in a one-entry per-thread cache and reused by the next
+ * LL_TXN_START on that thread; lists with a custom allocator always free
+ * theirs, since that allocator's lifetime is tied to its list.
+ */
+#define TXN_INLINE 4
+
+/*
+ * Insert-after request: insert elm after anchor. Removing one from the write
+ * set clears elm and leaves the slot, so call order within an anchor's group
+ * is kept. next_same links the group (index + 1; 0 ends it) once indexed.
+ */
+typedef struct { void *anchor; void *elm; size_t next_same; } ins_after_t;
+
+/*
+ * Open-addressing pointer index over a write set, built the first time a
+ * view walk has more changes than fit the inline buffers and kept up to
+ * date by every later change. For the removed set only keys matter; for
+ * insert-after groups first/last are the (index + 1) ends of the chain.
+ */
+typedef struct { const void *key; size_t first, last; } idx_slot_t;
+typedef struct { idx_slot_t *slots; size_t cap, n; } ptr_index_t;
+
+struct ll_txn {
+    atomic_uintptr_t *head;
+    ll_commit_id_t *commit_id;
+    ll_ctl_t *ctl;
+    void (*free_cb)(void *);
+    uint64_t snapshot_version;   /* snapshot at this id; no copy */
+    bool cacheable;              /* allocated from the C library */
+    void **inserted_head;
+    size_t n_ins_head;
+    size_t cap_ins_head;
+    void **inserted_tail;
+    size_t n_ins_tail;
+    size_t cap_ins_tail;
+    ins_after_t *ins_after;
+    size_t n_ins_after;
+    size_t cap_ins_after;
+    void **removed;
+    size_t n_removed;
+    size_t cap_removed;
+    void *inline_head[TXN_INLINE];
+    void *inline_tail[TXN_INLINE];
+    ins_after_t inline_after[TXN_INLINE];
+    void *inline_removed[TXN_INLINE];
+    bool indexed;                /* removed_idx / anchor_idx are valid */
+    ptr_index_t removed_idx;
+    ptr_index_t anchor_idx;
+    int snapshot_slot;           /* entry in the domain's active_snapshot_version, or -1 (overflow) */
+    bool expired;                /* the snapshot's lease ran out */
+    uint64_t deadline;           /* lease end, monotonic ns; 0 = none */
+    uint64_t lease_gen;          /* generation of the entry it joined */
+    uint64_t commit_restore;     /* txn_enter's restore value, for batch_done */
+    struct ll_txn *gc_next;      /* group commit queue / batch link */
+    _Atomic(int) gc_done;        /* set by the leader once applied */
+};
+
+static _Thread_local ll_txn_t *txn_cache;
+
+/* Make room for one more element of elem_size bytes in *arr (inline or heap). */
+static int reserve(ll_txn_t *txn, void *arr, size_t n, size_t *cap, size_t elem_size,
+                   void *inline_buf)
+{
+    if (n < *cap)
+        return 0;
+    void *old = *(void **)arr;
+    size_t new_cap = *cap * 2;
+    void *p;
+    if (old == inline_buf) {
+        p = mem_alloc(txn->ctl, new_cap * elem_size, alignof(void *));
+        if (p)
+            memcpy(p, old, *cap * elem_size);
+    } else {
+        p = mem_grow(txn->ctl, old, *cap * elem_size, new_cap * elem_size);
+    }
+    if (!p)
+        return -1;
+    *(void **)arr = p;
+    *cap = new_cap;
+    return 0;
+}
+
+static int append(ll_txn_t *txn, void ***arr, size_t *n, size_t *cap, void **inline_buf, void *ptr)
+{
+    if (reserve(txn, arr, *n, cap, sizeof(void *), inline_buf))
+        return -1;
+    (*arr)[(*n)++] = ptr;
+    return 0;
+}
+
+static void buf_free(ll_txn_t *txn, void *arr, size_t cap, size_t elem_size, void *inline_buf)
+{
+    if (arr != inline_buf)
+        mem_free(txn->ctl, arr, cap * elem_size, alignof(void *));
+}
+
+/* --- Write-set index --- */
+
+static size_t idx_hash(const void *p, size_t cap)
+{
+    uint64_t h = (uint64_t)(uintptr_t)p * 0x9E3779B97F4A7C15ull;
+    return (size_t)(h >> 32) & (cap - 1);
+}
+
+static idx_slot_t *idx_find(const ptr_index_t *ix, const void *key)
+{
+    if (!ix->cap)
+        return NULL;
+    for (size_t i = idx_hash(key, ix->cap);; i = (i + 1) & (ix->cap - 1)) {
+        if (ix->slots[i].key == key)
+            return &ix->slots[i];
+        if (!ix->slots[i].key)
+            return NULL;
+    }
+}
+
+static void idx_free(const ll_ctl_t *ctl, ptr_index_t *ix)
+{
+    mem_free(ctl, ix->slots, ix->cap * sizeof(idx_slot_t), alignof(idx_slot_t));
+    ix->slots = NULL;
+    ix->cap = ix->n = 0;
+}
+
+/* Find or add key; NULL on allocation failure. Kept at most half full. */
+static idx_slot_t *idx_insert(const ll_ctl_t *ctl, ptr_index_t *ix, const void *key)
+{
+    if (2 * (ix->n + 1) > ix->cap) {
+        size_t cap = ix->cap ? ix->cap * 2 : 16;
+        idx_slot_t *slots = (idx_slot_t *)mem_alloc(ctl, cap * sizeof(idx_slot_t), alignof(idx_slot_t));
+        if (!slots)
+            return NULL;
+        memset(slots, 0, cap * sizeof(idx_slot_t));
+        ptr_index_t grown = { slots, cap, ix->n };
+        for (size_t i = 0; i < ix->cap; i++) {
+            if (!ix->slots[i].key)
+                continue;
+            size_t j = idx_hash(ix->slots[i].key, cap);
+            while (slots[j].key)
+                j = (j + 1) & (cap - 1);
+            slots[j] = ix->slots[i];
+        }
+        idx_free(ctl, ix);
+        *ix = grown;
+    }
+    size_t i = idx_hash(key, ix->cap);
+    while (ix->slots[i].key && ix->slots[i].key != key)
+        i = (i + 1) & (ix->cap - 1);
+    if (!ix->slots[i].key) {
+        ix->slots[i].key = key;
+        ix->slots[i].first = ix->slots[i].last = 0;
+        ix->n++;
+    }
+    return &ix->slots[i];
+}
+
+static void txn_drop_index(ll_txn_t *txn)
+{
+    idx_free(txn->ctl, &txn->removed_idx);
+    idx_free(txn->ctl, &txn->anchor_idx);
+    txn->indexed = false;
+}
+
+static int index_removed(ll_txn_t *txn, const void *elm)
+{
+    return idx_insert(txn->ctl, &txn->removed_idx, elm) ? 0 : -1;
+}
+
+/* Append pair i to its anchor's group. */
+static int index_ins_after(ll_txn_t *txn, size_t i)
+{
+    idx_slot_t *g = idx_insert(txn->ctl, &txn->anchor_idx, txn->ins_after[i].anchor);
+    if (!g)
+        return -1;
+    txn->ins_after[i].next_same = 0;
+    if (g->last)
+        txn->ins_after[g->last - 1].next_same = i + 1;
+    else
+        g->first = i + 1;
+    g->last = i + 1;
+    return 0;
+}
+
+/*
+ * Index the write set if it is too large to scan per node. On allocation
+ * failure the walk just stays on the linear paths.
+ */
+static void txn_build_index(ll_txn_t *txn)
+{
+    if (txn->indexed || txn->n_removed + txn->n_ins_after <= TXN_INLINE)
+        return;
+    txn->indexed = true;
+    for (size_t i = 0; i < txn->n_removed; i++)
+        if (index_removed(txn, txn->removed[i]))
+            goto fail;
+    for (size_t i = 0; i < txn->n_ins_after; i++)
+        if (index_ins_after(txn, i))
+            goto fail;
+    return;
+fail:
+    txn_drop_index(txn);
+}
+
+static void txn_init_buffers(ll_txn_t *txn)
+{
+    txn->inserted_head = txn->inline_head;
+    txn->inserted_tail = txn->inline_tail;
+    txn->ins_after = txn->inline_after;
+    txn->removed = txn->inline_removed;
+    txn->n_ins_head = txn->n_ins_tail = txn->n_ins_after = txn->n_removed = 0;
+    txn->cap_ins_head = txn->cap_ins_tail = txn->cap_ins_after = txn->cap_removed = TXN_INLINE;
+    txn->indexed = false;
+    txn->removed_idx = (ptr_index_t){ NULL, 0, 0 };
+    txn->anchor_idx = (ptr_index_t){ NULL, 0, 0 };
+}
+
+/* Drop spilled write sets and the index; point every buffer back at its inline storage. */
+static void txn_reset_buffers(ll_txn_t *txn)
+{
+    buf_free(txn, txn->inserted_head, txn->cap_ins_head, sizeof(void *), txn->inline_head);
+    buf_free(txn, txn->inserted_tail, txn->cap_ins_tail, sizeof(void *), txn->inline_tail);
+    buf_free(txn, txn->ins_after, txn->cap_ins_after, sizeof(ins_after_t), txn->inline_after);
+    buf_free(txn, txn->removed, txn->cap_removed, sizeof(void *), txn->inline_removed);
+    txn_drop_index(txn);
+    txn_init_buffers(txn);
+}
+
+/* End of a transaction: recycle into this thread's cache, or free. */
+static void txn_release(ll_txn_t *txn)
+{
+    txn_reset_buffers(txn);
+    if (txn->cacheable && !txn_cache) {
+        thread_hook();
+        txn_cache = txn;
+        return;
+    }
+    mem_free(txn->ctl, txn, sizeof(*txn), alignof(ll_txn_t));
 }
 
-void *ll_iter_get(ll_iter_t *it)
+/*
+ * Thread exit: free the cached transaction and give up this thread's
+ * slot. Its snapshot entries are cleared in every domain; a new
+ * generation on each entry expires whatever transactions the thread left
+ * open, so they stop holding back reclaim. Nodes never
+ * wait on a thread, only on their list, so nothing else is left behind.
+ */
+static void thread_exit(void *unused)
 {
-    return it->cur ? ((versioned_node_t *)it->cur)->user_elm : NULL;
+    (void)unused;
+    if (txn_cache) {
+        free(txn_cache);   /* cacheable: C library, inline buffers only */
+        txn_cache = NULL;
+    }
+    int i = my_slot;
+    if (i < 0)
+        return;
+    domains_lock();
+    for (ll_domain_t *d = domains; d; d = d->next) {
+        uint64_t w = atomic_load_explicit(&d->snapshot_open[i], memory_order_relaxed);
+        atomic_store_explicit(&d->snapshot_open[i], (OPEN_GEN(w) + 1) << 32, memory_order_seq_cst);
+        atomic_store_explicit(&d->active_snapshot_version[i], (uint64_t)0, memory_order_seq_cst);
+        atomic_store_explicit(&d->snapshot_deadline[i], (uint64_t)0, memory_order_relaxed);
+    }
+    domains_unlock();
+    atomic_store_explicit(&qsbr_seen[i], (uint64_t)0, memory_order_release);
+    my_slot = -1;
+    atomic_fetch_or_explicit(&slot_free, UINT32_C(1) << i, memory_order_release);
 }
 
-/* --- Transaction: snapshot = commit_id at start; no copy --- */
+static pthread_key_t thread_key;
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+static _Thread_local bool thread_hooked;
 
-#define TXN_INIT_CAP 8
+static void thread_key_init(void)
+{
+    pthread_key_create(&thread_key, thread_exit);
+}
 
-static int append(void ***arr, size_t *n, size_t *cap, void *ptr)
+/* Run thread_exit when this thread ends (the value only has to be non-NULL). */
+static void thread_hook(void)
 {
-    if (*n >= *cap) {
-        size_t new_cap = (*cap == 0) ? TXN_INIT_CAP : *cap * 2;
-        void **p = (void **)realloc(*arr, new_cap * sizeof(void *));
-        if (!p)
-            return -1;
-        *arr = p;
-        *cap = new_cap;
-    }
-    (*arr)[(*n)++] = ptr;
-    return 0;
+    if (thread_hooked)
+        return;
+    thread_hooked = true;
+    pthread_once(&thread_key_once, thread_key_init);
+    pthread_setspecific(thread_key, &thread_key);
 }
 
 static int ptr_in(void **arr, size_t n, const void *ptr)
@@ -446,78 +2279,129 @@ static void remove_from(void **arr, size_t *n, const void *ptr)
     }
 }
 
-struct ll_txn {
-    atomic_uintptr_t *head;
-    ll_commit_id_t *commit_id;
-    void (*free_cb)(void *);
-    uint64_t snapshot_version;   /* snapshot at this id; no copy */
-    void **inserted_head;
-    size_t n_ins_head;
-    size_t cap_ins_head;
-    void **inserted_tail;
-    size_t n_ins_tail;
-    size_t cap_ins_tail;
-    void **insert_after_anchors; /* (anchor, elm) pairs: insert elm after anchor */
-    void **insert_after_elms;
-    size_t n_ins_after;
-    size_t cap_ins_after;
-    void **removed;
-    size_t n_removed;
-    size_t cap_removed;
-};
-
 ll_txn_t *ll_txn_start_(atomic_uintptr_t *head,
-    ll_commit_id_t *commit_id, void (*free_cb)(void *))
+    ll_commit_id_t *commit_id, ll_ctl_t *ctl, void (*free_cb)(void *))
 {
-    ll_txn_t *txn = (ll_txn_t *)calloc(1, sizeof(*txn));
-    if (!txn)
-        return NULL;
+    ll_txn_t *txn;
+    if (!ctl->alloc.alloc && txn_cache) {
+        txn = txn_cache;
+        txn_cache = NULL;
+    } else {
+        txn = (ll_txn_t *)mem_alloc(ctl, sizeof(*txn), alignof(ll_txn_t));
+        if (!txn)
+            return NULL;
+        txn->cacheable = !ctl->alloc.alloc;
+        txn_init_buffers(txn);
+    }
     txn->head = head;
     txn->commit_id = commit_id;
+    txn->ctl = ctl;
     txn->free_cb = free_cb;
     txn->snapshot_version = atomic_load_explicit(commit_id, memory_order_acquire);
-    /* Register so reclaim won't free nodes visible to this snapshot. */
-    int base = get_hp_base();
-    if (base >= 0)
-        atomic_store_explicit(&active_snapshot_version[base / HP_SLOTS_PER_THREAD], txn->snapshot_version, memory_order_release);
+    txn->expired = false;
+    txn->deadline = ctl->snapshot_lease_ns ? now_ns() + ctl->snapshot_lease_ns : 0;
+    /* Register so reclaim won't free nodes visible to this snapshot (until the lease runs out). */
+    txn->snapshot_slot = thread_slot();
+    if (txn->snapshot_slot >= 0) {
+        txn->lease_gen = snapshot_register(ctl->domain, txn->snapshot_slot, txn->snapshot_version,
+                                           txn->deadline);
+    } else {
+        /* No entry: hold back all reclaim in the domain until commit or rollback, with no lease. */
+        atomic_fetch_add_explicit(&ctl->domain->overflow, 1, memory_order_seq_cst);
+        txn->snapshot_version = atomic_load_explicit(commit_id, memory_order_acquire);
+    }
     return txn;
 }
 
+/* Past its own lease, or the entry was revoked or moved on: expired for good. */
+static bool txn_expired(ll_txn_t *txn)
+{
+    if (!txn->expired && txn->snapshot_slot >= 0 &&
+        ((txn->deadline && now_ns() >= txn->deadline) ||
+         OPEN_GEN(atomic_load_explicit(&txn->ctl->domain->snapshot_open[txn->snapshot_slot],
+                                       memory_order_seq_cst)) != txn->lease_gen))
+        txn->expired = true;
+    return txn->expired;
+}
+
+/*
+ * Hold the snapshot busy while walking the list, so it cannot be revoked
+ * under the walk; false if the txn has expired. *restore is what
+ * txn_leave puts back (0: an enclosing operation already holds it).
+ */
+static bool txn_enter(ll_txn_t *txn, uint64_t *restore)
+{
+    *restore = 0;
+    if (txn_expired(txn))
+        return false;
+    if (txn->snapshot_slot < 0)
+        return true;
+    _Atomic(uint64_t) *slot = &txn->ctl->domain->active_snapshot_version[txn->snapshot_slot];
+    uint64_t v = atomic_load_explicit(slot, memory_order_relaxed);
+    if (v & SNAP_BUSY)
+        return true;
+    if (v && atomic_compare_exchange_strong_explicit(slot, &v, v | SNAP_BUSY, memory_order_seq_cst,
+                                                     memory_order_relaxed)) {
+        *restore = v;
+        return true;
+    }
+    txn->expired = true;   /* revoked */
+    return false;
+}
+
+static void txn_leave(ll_txn_t *txn, uint64_t restore)
+{
+    if (restore)
+        atomic_store_explicit(&txn->ctl->domain->active_snapshot_version[txn->snapshot_slot],
+                              restore, memory_order_release);
+}
+
+int ll_txn_status(ll_txn_t *txn)
+{
+    return txn_expired(txn) ? LL_TXN_EXPIRED : 0;
+}
+
+uint64_t ll_txn_snapshot(ll_txn_t *txn)
+{
+    return txn->snapshot_version;
+}
+
 void ll_txn_insert_head_(ll_txn_t *txn, void *elm)
 {
-    append(&txn->inserted_head, &txn->n_ins_head, &txn->cap_ins_head, elm);
+    append(txn, &txn->inserted_head, &txn->n_ins_head, &txn->cap_ins_head, txn->inline_head, elm);
 }
 
 void ll_txn_insert_tail_(ll_txn_t *txn, void *elm)
 {
-    append(&txn->inserted_tail, &txn->n_ins_tail, &txn->cap_ins_tail, elm);
+    append(txn, &txn->inserted_tail, &txn->n_ins_tail, &txn->cap_ins_tail, txn->inline_tail, elm);
 }
 
-static int append_pair(void ***anchors, void ***elms, size_t *n, size_t *cap, void *anchor, void *elm)
+void ll_txn_insert_after_(ll_txn_t *txn, void *after_elm, void *elm)
 {
-    if (*n >= *cap) {
-        size_t new_cap = (*cap == 0) ? TXN_INIT_CAP : *cap * 2;
-        void **a = (void **)realloc(*anchors, new_cap * sizeof(void *));
-        void **e = (void **)realloc(*elms, new_cap * sizeof(void *));
-        if (!a || !e) {
-            if (a) free(a);
-            if (e) free(e);
-            return -1;
-        }
-        *anchors = a;
-        *elms = e;
-        *cap = new_cap;
-    }
-    (*anchors)[*n] = anchor;
-    (*elms)[*n] = elm;
-    (*n)++;
-    return 0;
+    if (reserve(txn, &txn->ins_after, txn->n_ins_after, &txn->cap_ins_after, sizeof(ins_after_t),
+                txn->inline_after))
+        return;
+    txn->ins_after[txn->n_ins_after].anchor = after_elm;
+    txn->ins_after[txn->n_ins_after].elm = elm;
+    txn->ins_after[txn->n_ins_after].next_same = 0;
+    txn->n_ins_after++;
+    if (txn->indexed && index_ins_after(txn, txn->n_ins_after - 1))
+        txn_drop_index(txn);
 }
 
-void ll_txn_insert_after_(ll_txn_t *txn, void *after_elm, void *elm)
+static int ins_after_find(const ll_txn_t *txn, const void *elm)
+{
+    for (size_t i = 0; i < txn->n_ins_after; i++)
+        if (txn->ins_after[i].elm == elm)
+            return (int)i;
+    return -1;
+}
+
+static bool removed_has(const ll_txn_t *txn, const void *elm)
 {
-    append_pair(&txn->insert_after_anchors, &txn->insert_after_elms,
-                &txn->n_ins_after, &txn->cap_ins_after, after_elm, elm);
+    if (txn->indexed)
+        return idx_find(&txn->removed_idx, elm) != NULL;
+    return ptr_in(txn->removed, txn->n_removed, elm);
 }
 
 void ll_txn_remove_(ll_txn_t *txn, void *elm)
@@ -530,27 +2414,27 @@ void ll_txn_remove_(ll_txn_t *txn, void *elm)
         remove_from(txn->inserted_tail, &txn->n_ins_tail, elm);
         return;
     }
-    if (txn->insert_after_elms && ptr_in(txn->insert_after_elms, txn->n_ins_after, elm)) {
-        /* Remove (anchor, elm) pair: swap with last and decrement */
-        for (size_t i = 0; i < txn->n_ins_after; i++) {
-            if (txn->insert_after_elms[i] == elm) {
-                txn->n_ins_after--;
-                txn->insert_after_anchors[i] = txn->insert_after_anchors[txn->n_ins_after];
-                txn->insert_after_elms[i] = txn->insert_after_elms[txn->n_ins_after];
-                return;
-            }
-        }
+    int i = ins_after_find(txn, elm);
+    if (i >= 0) {
+        /* Clear the pair in place so its group keeps call order. */
+        txn->ins_after[i].elm = NULL;
         return;
     }
     /* Check if elm is in list at snapshot_version (traverse once). */
+    uint64_t restore;
+    if (!txn_enter(txn, &restore))
+        return;
     versioned_node_t *curr = get_wrapper(atomic_load_explicit(txn->head, memory_order_acquire));
     while (curr) {
         if (curr->user_elm == elm && visible(curr, txn->snapshot_version)) {
-            append(&txn->removed, &txn->n_removed, &txn->cap_removed, elm);
-            return;
+            if (append(txn, &txn->removed, &txn->n_removed, &txn->cap_removed, txn->inline_removed, elm) == 0
+                && txn->indexed && index_removed(txn, elm))
+                txn_drop_index(txn);
+            break;
         }
         curr = get_wrapper(atomic_load_explicit(&curr->next, memory_order_acquire));
     }
+    txn_leave(txn, restore);
 }
 
 bool ll_txn_contains_(ll_txn_t *txn, const void *elm)
@@ -559,38 +2443,169 @@ bool ll_txn_contains_(ll_txn_t *txn, const void *elm)
         return true;
     if (ptr_in(txn->inserted_tail, txn->n_ins_tail, elm))
         return true;
-    if (txn->insert_after_elms && ptr_in(txn->insert_after_elms, txn->n_ins_after, elm))
+    if (ins_after_find(txn, elm) >= 0)
         return true;
-    if (ptr_in(txn->removed, txn->n_removed, elm))
+    uint64_t restore;
+    if (removed_has(txn, elm) || !txn_enter(txn, &restore))
         return false;
+    bool found = false;
     versioned_node_t *curr = get_wrapper(atomic_load_explicit(txn->head, memory_order_acquire));
-    while (curr) {
-        if (curr->user_elm == elm && visible(curr, txn->snapshot_version))
-            return true;
+    while (curr && !found) {
+        found = curr->user_elm == elm && visible(curr, txn->snapshot_version);
         curr = get_wrapper(atomic_load_explicit(&curr->next, memory_order_acquire));
     }
-    return false;
+    txn_leave(txn, restore);
+    return found;
 }
 
-void ll_txn_foreach_(ll_txn_t *txn,
-    ll_txn_foreach_fn cb, void *userdata)
+/*
+ * --- Transaction view cursor ---
+ * View order: inserted_head (reversed), then snapshot nodes each followed by
+ * its insert_after group, then inserted_tail. With the write set indexed,
+ * each node costs O(1) plus its own group, so a full walk is O(N + changes).
+ */
+enum { TI_HEAD, TI_NODE, TI_GROUP, TI_TAIL, TI_DONE };
+
+static void txn_iter_step(ll_txn_iter_t *it)
 {
-    /* Transaction view order: inserted_head (reversed), then snapshot with insert_after, then inserted_tail. */
-    for (size_t i = txn->n_ins_head; i > 0; i--)
-        cb(txn->inserted_head[i - 1], userdata);
-    versioned_node_t *curr = get_wrapper(atomic_load_explicit(txn->head, memory_order_acquire));
-    while (curr) {
-        if (visible(curr, txn->snapshot_version) && !ptr_in(txn->removed, txn->n_removed, curr->user_elm)) {
-            cb(curr->user_elm, userdata);
-            for (size_t i = 0; i < txn->n_ins_after; i++) {
-                if (txn->insert_after_anchors[i] == curr->user_elm)
-                    cb(txn->insert_after_elms[i], userdata);
+    ll_txn_t *txn = it->txn;
+    versioned_node_t *node = (versioned_node_t *)it->node;
+    for (;;) {
+        switch (it->phase) {
+        case TI_HEAD:
+            if (it->pos > 0) {
+                it->cur = txn->inserted_head[--it->pos];
+                return;
+            }
+            node = get_wrapper(atomic_load_explicit(txn->head, memory_order_acquire));
+            it->phase = TI_NODE;
+            break;
+        case TI_NODE:
+            while (node && (!visible(node, txn->snapshot_version) || removed_has(txn, node->user_elm)))
+                node = get_wrapper(atomic_load_explicit(&node->next, memory_order_acquire));
+            if (!node) {
+                it->phase = TI_TAIL;
+                it->pos = 0;
+                break;
+            }
+            it->node = node;
+            it->cur = node->user_elm;
+            it->grouped = txn->indexed;
+            if (it->grouped) {
+                idx_slot_t *g = idx_find(&txn->anchor_idx, node->user_elm);
+                it->pos = g ? g->first : 0;
+            } else {
+                it->pos = 0;
+            }
+            it->phase = TI_GROUP;
+            return;
+        case TI_GROUP:
+            if (it->grouped) {
+                while (it->pos) {
+                    ins_after_t *p = &txn->ins_after[it->pos - 1];
+                    it->pos = p->next_same;
+                    if (p->elm) {
+                        it->cur = p->elm;
+                        return;
+                    }
+                }
+            } else {
+                while (it->pos < txn->n_ins_after) {
+                    ins_after_t *p = &txn->ins_after[it->pos++];
+                    if (p->anchor == node->user_elm && p->elm) {
+                        it->cur = p->elm;
+                        return;
+                    }
+                }
+            }
+            node = get_wrapper(atomic_load_explicit(&node->next, memory_order_acquire));
+            it->phase = TI_NODE;
+            break;
+        case TI_TAIL:
+            if (it->pos < txn->n_ins_tail) {
+                it->cur = txn->inserted_tail[it->pos++];
+                return;
             }
+            it->phase = TI_DONE;
+            break;
+        default:
+            it->cur = NULL;
+            return;
         }
-        curr = get_wrapper(atomic_load_explicit(&curr->next, memory_order_acquire));
     }
-    for (size_t i = 0; i < txn->n_ins_tail; i++)
-        cb(txn->inserted_tail[i], userdata);
+}
+
+/* One step with the snapshot held; an expired txn's view ends here. */
+static void txn_iter_step_held(ll_txn_iter_t *it)
+{
+    uint64_t restore;
+    if (!txn_enter(it->txn, &restore)) {
+        it->phase = TI_DONE;
+        it->cur = NULL;
+        return;
+    }
+    txn_iter_step(it);
+    txn_leave(it->txn, restore);
+}
+
+static void txn_iter_init(ll_txn_iter_t *it, ll_txn_t *txn)
+{
+    txn_build_index(txn);
+    it->txn = txn;
+    it->cur = NULL;
+    it->node = NULL;
+    it->pos = txn->n_ins_head;
+    it->phase = TI_HEAD;
+    it->grouped = false;
+}
+
+void ll_txn_iter_begin(ll_txn_iter_t *it, ll_txn_t *txn)
+{
+    txn_iter_init(it, txn);
+    txn_iter_step_held(it);
+}
+
+void ll_txn_iter_next(ll_txn_iter_t *it)
+{
+    if (it->cur)
+        txn_iter_step_held(it);
+}
+
+void *ll_txn_iter_get(const ll_txn_iter_t *it)
+{
+    return it->cur;
+}
+
+size_t ll_txn_iter_batch(ll_txn_iter_t *it, void **out, size_t max)
+{
+    size_t n = 0;
+    if (!it->cur || !max)
+        return 0;
+    uint64_t restore;
+    if (!txn_enter(it->txn, &restore)) {
+        it->phase = TI_DONE;
+        it->cur = NULL;
+        return 0;
+    }
+    while (n < max && it->cur) {
+        out[n++] = it->cur;
+        txn_iter_step(it);
+    }
+    txn_leave(it->txn, restore);
+    return n;
+}
+
+void ll_txn_foreach_(ll_txn_t *txn,
+    ll_txn_foreach_fn cb, void *userdata)
+{
+    ll_txn_iter_t it;
+    uint64_t restore;
+    txn_iter_init(&it, txn);
+    if (!txn_enter(txn, &restore))
+        return;
+    for (txn_iter_step(&it); it.cur; txn_iter_step(&it))
+        cb(it.cur, userdata);
+    txn_leave(txn, restore);
 }
 
 /* Simple map: anchor -> last inserted elm (for applying multiple insert_after with same anchor in order). */
@@ -619,63 +2634,428 @@ static void set_last_for_anchor(anchor_last_t *arr, size_t *n, size_t cap, void
     }
 }
 
-int ll_txn_commit(ll_txn_t *txn)
+/* Apply txn's insert_after pairs at C; several after one anchor go after the previous, in call order. */
+static void apply_ins_after(ll_txn_t *txn, uint64_t C)
 {
-    uint64_t C = atomic_fetch_add_explicit(txn->commit_id, 1, memory_order_acq_rel);
-    for (size_t i = 0; i < txn->n_removed; i++) {
-        versioned_node_t *curr = get_wrapper(atomic_load_explicit(txn->head, memory_order_acquire));
-        while (curr) {
-            if (curr->user_elm == txn->removed[i]) {
-                atomic_store_explicit(&curr->removed_txn_id, C, memory_order_release);
-                break;
+    if (txn->n_ins_after == 0)
+        return;
+    anchor_last_t small[TXN_INLINE];
+    size_t scratch = txn->n_ins_after * sizeof(anchor_last_t);
+    anchor_last_t *last_inserted = txn->n_ins_after <= TXN_INLINE ? small
+        : (anchor_last_t *)mem_alloc(txn->ctl, scratch, alignof(anchor_last_t));
+    if (!last_inserted)
+        return;
+    size_t n_last = 0;
+    for (size_t i = 0; i < txn->n_ins_after; i++) {
+        void *anchor = txn->ins_after[i].anchor;
+        void *elm = txn->ins_after[i].elm;
+        if (!elm)
+            continue;   /* removed from the write set */
+        void *effective = find_last_for_anchor(last_inserted, n_last, anchor);
+        if (!effective)
+            effective = anchor;
+        insert_after_at(txn->head, txn->ctl, effective, elm, C);
+        set_last_for_anchor(last_inserted, &n_last, txn->n_ins_after, anchor, elm);
+    }
+    if (last_inserted != small)
+        mem_free(txn->ctl, last_inserted, scratch, alignof(anchor_last_t));
+}
+
+/*
+ * Mark everything a batch removes at C in one pass over the list, stopping
+ * once every element has been seen. The pending set lives on the stack for
+ * small batches and in a batch-wide index otherwise.
+ */
+static void mark_removed(ll_txn_t *batch, uint64_t C)
+{
+    size_t total = 0;
+    for (ll_txn_t *t = batch; t; t = t->gc_next)
+        total += t->n_removed;
+    if (total == 0)
+        return;
+    void *small[TXN_INLINE];
+    ptr_index_t ix = { NULL, 0, 0 };
+    size_t left = 0;
+    for (ll_txn_t *t = batch; t; t = t->gc_next) {
+        for (size_t i = 0; i < t->n_removed; i++) {
+            if (total <= TXN_INLINE) {
+                if (!ptr_in(small, left, t->removed[i]))
+                    small[left++] = t->removed[i];
+            } else if (!idx_insert(batch->ctl, &ix, t->removed[i])) {
+                idx_free(batch->ctl, &ix);
+                for (t = batch; t; t = t->gc_next)
+                    for (i = 0; i < t->n_removed; i++)
+                        mark_one(batch->head, batch->ctl, t->removed[i], C);
+                return;
             }
-            curr = get_wrapper(atomic_load_explicit(&curr->next, memory_order_acquire));
         }
     }
-    /* Apply insert_after in order; multiple inserts after same anchor go after the previous insert. */
-    if (txn->n_ins_after > 0) {
-        anchor_last_t *last_inserted = (anchor_last_t *)malloc(txn->n_ins_after * sizeof(anchor_last_t));
-        if (last_inserted) {
-            size_t n_last = 0;
-            for (size_t i = 0; i < txn->n_ins_after; i++) {
-                void *anchor = txn->insert_after_anchors[i];
-                void *elm = txn->insert_after_elms[i];
-                void *effective = find_last_for_anchor(last_inserted, n_last, anchor);
-                if (!effective)
-                    effective = anchor;
-                ll_insert_after_(txn->head, txn->commit_id, effective, elm);
-                set_last_for_anchor(last_inserted, &n_last, txn->n_ins_after, anchor, elm);
-            }
-            free(last_inserted);
-        }
-    }
-    for (size_t i = 0; i < txn->n_ins_tail; i++)
-        ll_insert_tail_(txn->head, txn->commit_id, txn->inserted_tail[i]);
-    for (size_t i = txn->n_ins_head; i > 0; i--)
-        ll_insert_head_(txn->head, txn->commit_id, txn->inserted_head[i - 1]);
-    /* Unregister snapshot, then reclaim removed nodes not visible to any active txn. */
-    int base = get_hp_base();
-    if (base >= 0)
-        atomic_store_explicit(&active_snapshot_version[base / HP_SLOTS_PER_THREAD], (uint64_t)0, memory_order_release);
-    reclaim(txn->head, txn->commit_id, txn->free_cb);
-    free(txn->inserted_head);
-    free(txn->inserted_tail);
-    free(txn->insert_after_anchors);
-    free(txn->insert_after_elms);
-    free(txn->removed);
-    free(txn);
-    return 0;
+    if (total > TXN_INLINE)
+        left = ix.n;
+    versioned_node_t *curr = get_wrapper(atomic_load_explicit(batch->head, memory_order_acquire));
+    for (; curr && left; curr = get_wrapper(atomic_load_explicit(&curr->next, memory_order_acquire))) {
+        if (atomic_load_explicit(&curr->removed_txn_id, memory_order_acquire) != 0)
+            continue;
+        const void *elm = curr->user_elm;
+        if (ix.cap) {
+            idx_slot_t *slot = idx_find(&ix, elm);
+            if (!slot || slot->first)
+                continue;
+            slot->first = 1;    /* seen */
+        } else {
+            size_t j = 0;
+            while (j < left && small[j] != elm)
+                j++;
+            if (j == left)
+                continue;
+            small[j] = small[left - 1];
+        }
+        left--;
+        uint64_t live = 0;
+        if (atomic_compare_exchange_strong_explicit(&curr->removed_txn_id, &live, C,
+                                                    memory_order_release, memory_order_relaxed))
+            pending_push(batch->ctl, curr);
+    }
+    idx_free(batch->ctl, &ix);
+}
+
+/*
+ * Apply a batch of transactions on one list (linked through gc_next, in
+ * commit order) under a single commit id: removes, then insert-after, then
+ * all tail inserts and all head inserts, each linked as one pre-built
+ * chain. The result is the same as committing them one after another.
+ */
+static void commit_batch(ll_txn_t *batch)
+{
+    atomic_uintptr_t *head = batch->head;
+    ll_ctl_t *ctl = batch->ctl;
+    uint64_t C = atomic_fetch_add_explicit(batch->commit_id, 1, memory_order_acq_rel);
+    mark_removed(batch, C);
+    for (ll_txn_t *t = batch; t; t = t->gc_next)
+        apply_ins_after(t, C);
+
+    versioned_node_t *first = NULL, *last = NULL;
+    for (ll_txn_t *t = batch; t; t = t->gc_next) {
+        for (size_t i = 0; i < t->n_ins_tail; i++) {
+            versioned_node_t *w = node_make(ctl, t->inserted_tail[i], C);
+            if (!w)
+                continue;
+            if (last)
+                atomic_store_explicit(&last->next, (uintptr_t)w, memory_order_relaxed);
+            else
+                first = w;
+            last = w;
+        }
+    }
+    if (first)
+        link_tail(head, first);
+
+    /* Later head inserts go in front of earlier ones, within and across transactions. */
+    first = last = NULL;
+    for (ll_txn_t *t = batch; t; t = t->gc_next) {
+        for (size_t i = 0; i < t->n_ins_head; i++) {
+            versioned_node_t *w = node_make(ctl, t->inserted_head[i], C);
+            if (!w)
+                continue;
+            atomic_store_explicit(&w->next, (uintptr_t)first, memory_order_relaxed);
+            if (!last)
+                last = w;
+            first = w;
+        }
+    }
+    if (first)
+        link_head(head, first, last);
+}
+
+/* Drop each transaction's snapshot and release its committer. A follower's txn may be gone once gc_done is set. */
+static void batch_done(ll_txn_t *batch)
+{
+    while (batch) {
+        ll_txn_t *next = batch->gc_next;
+        snapshot_release(batch->ctl->domain, batch->snapshot_slot, batch->lease_gen,
+                         batch->commit_restore);
+        atomic_store_explicit(&batch->gc_done, 1, memory_order_release);
+        batch = next;
+    }
+}
+
+#define GC_SPIN 64
+
+static bool gc_try_lead(ll_ctl_t *ctl)
+{
+    return !atomic_load_explicit(&ctl->gc_leader, memory_order_relaxed) &&
+           !atomic_exchange_explicit(&ctl->gc_leader, 1, memory_order_acquire);
+}
+
+/* As leader: apply own (if any) followed by everything queued, then step down. */
+static void gc_lead(ll_ctl_t *ctl, ll_txn_t *own)
+{
+    /* The queue is a stack; reverse it into commit order. */
+    ll_txn_t *q = (ll_txn_t *)atomic_exchange_explicit(&ctl->gc_queue, (uintptr_t)0,
+                                                       memory_order_acquire);
+    ll_txn_t *batch = NULL;
+    while (q) {
+        ll_txn_t *next = q->gc_next;
+        q->gc_next = batch;
+        batch = q;
+        q = next;
+    }
+    if (own) {
+        own->gc_next = batch;
+        batch = own;
+    }
+    if (batch) {
+        commit_batch(batch);
+        batch_done(batch);
+    }
+    atomic_store_explicit(&ctl->gc_leader, 0, memory_order_release);
+}
+
+/*
+ * Group commit: with no leader, lead at once and take the queue along;
+ * otherwise queue txn and wait until a leader has applied it, leading in
+ * turn if the current one steps down first. Returns true if this thread
+ * led a batch (and so owes the reclaim pass).
+ */
+static bool group_commit(ll_txn_t *txn)
+{
+    ll_ctl_t *ctl = txn->ctl;
+    if (gc_try_lead(ctl)) {
+        gc_lead(ctl, txn);
+        return true;
+    }
+    atomic_store_explicit(&txn->gc_done, 0, memory_order_relaxed);
+    uintptr_t old = atomic_load_explicit(&ctl->gc_queue, memory_order_relaxed);
+    do {
+        txn->gc_next = (ll_txn_t *)old;
+    } while (!atomic_compare_exchange_weak_explicit(&ctl->gc_queue, &old, (uintptr_t)txn,
+                                                    memory_order_release, memory_order_relaxed));
+    bool led = false;
+    unsigned spins = 0;
+    while (!atomic_load_explicit(&txn->gc_done, memory_order_acquire)) {
+        if (gc_try_lead(ctl)) {
+            gc_lead(ctl, NULL);
+            led = true;
+        } else if (++spins >= GC_SPIN) {
+            sched_yield();
+            spins = 0;
+        }
+    }
+    return led;
 }
 
 void ll_txn_rollback(ll_txn_t *txn)
 {
-    int base = get_hp_base();
-    if (base >= 0)
-        atomic_store_explicit(&active_snapshot_version[base / HP_SLOTS_PER_THREAD], (uint64_t)0, memory_order_release);
-    free(txn->inserted_head);
-    free(txn->inserted_tail);
-    free(txn->insert_after_anchors);
-    free(txn->insert_after_elms);
-    free(txn->removed);
-    free(txn);
+    snapshot_release(txn->ctl->domain, txn->snapshot_slot, txn->lease_gen, 0);
+    txn_release(txn);
+}
+
+int ll_txn_commit(ll_txn_t *txn)
+{
+    /* Held busy from here until batch_done drops it. */
+    if (!txn_enter(txn, &txn->commit_restore)) {
+        ll_txn_rollback(txn);
+        return LL_TXN_EXPIRED;
+    }
+    bool reclaim_due = true;
+    if (atomic_load_explicit(&txn->ctl->group_commit, memory_order_acquire)) {
+        reclaim_due = group_commit(txn);
+    } else {
+        txn->gc_next = NULL;
+        commit_batch(txn);
+        batch_done(txn);
+    }
+    /* Snapshots are unregistered; reclaim removed nodes not visible to any active txn. */
+    if (reclaim_due)
+        reclaim(txn->head, txn->commit_id, txn->ctl, txn->free_cb, false);
+    garbage_check(txn->head, txn->commit_id, txn->ctl, txn->free_cb);
+    txn_release(txn);
+    return 0;
+}
+
+
+/*
+ * --- Work-stealing deques (LL_WSDEQUE_*) ---
+ * Chase-Lev, with the C11 orderings of Le et al. Position i lives in
+ * slot i & mask of the current ring; top only grows, bottom moves back by
+ * one while the owner takes. A thief pins the deque's epoch in the
+ * deque's own domain before it loads the ring, so a ring outgrown at
+ * epoch E can be freed once every pinned thief started after it
+ * (walk_min > E). The owner frees outgrown rings when it grows again and
+ * at destroy.
+ */
+#define WSDEQUE_INIT_CAP 64
+
+struct ll_wsring {
+    size_t mask;
+    uint64_t retired_at;         /* epoch it was outgrown at */
+    struct ll_wsring *next;      /* on dq->retired */
+    atomic_uintptr_t slot[];
+};
+
+static struct ll_wsring *wsring_new(size_t cap)
+{
+    struct ll_wsring *r = (struct ll_wsring *)malloc(sizeof(*r) + cap * sizeof(atomic_uintptr_t));
+    if (!r)
+        return NULL;
+    r->mask = cap - 1;
+    r->retired_at = 0;
+    r->next = NULL;
+    return r;
+}
+
+int ll_wsdeque_init_(ll_wsdeque_t *dq)
+{
+    struct ll_wsring *r = wsring_new(WSDEQUE_INIT_CAP);
+    ll_domain_t *d = ll_domain_create();
+    if (!r || !d) {
+        free(r);
+        ll_domain_destroy(d);
+        return -1;
+    }
+    atomic_store_explicit(&dq->top, (int64_t)0, memory_order_relaxed);
+    atomic_store_explicit(&dq->bottom, (int64_t)0, memory_order_relaxed);
+    atomic_store_explicit(&dq->ring, r, memory_order_relaxed);
+    atomic_store_explicit(&dq->epoch, (uint64_t)1, memory_order_relaxed);
+    dq->domain = d;
+    dq->retired = NULL;
+    atomic_thread_fence(memory_order_release);
+    return 0;
+}
+
+void ll_wsdeque_destroy_(ll_wsdeque_t *dq)
+{
+    free(atomic_load_explicit(&dq->ring, memory_order_relaxed));
+    while (dq->retired) {
+        struct ll_wsring *r = dq->retired;
+        dq->retired = r->next;
+        free(r);
+    }
+    ll_domain_destroy(dq->domain);
+    dq->domain = NULL;
+}
+
+/* Free the outgrown rings no thief can still be reading. */
+static void wsring_collect(ll_wsdeque_t *dq)
+{
+    eras_t eras;
+    eras_scan(dq->domain, &eras);
+    struct ll_wsring **link = &dq->retired;
+    while (*link) {
+        struct ll_wsring *r = *link;
+        if (eras.walk_min > r->retired_at) {
+            *link = r->next;
+            free(r);
+        } else {
+            link = &r->next;
+        }
+    }
+}
+
+/* Double the ring holding positions t..b-1; NULL (nothing changed) if out of memory. */
+static struct ll_wsring *wsdeque_grow(ll_wsdeque_t *dq, struct ll_wsring *r, int64_t t, int64_t b)
+{
+    struct ll_wsring *n = wsring_new((r->mask + 1) * 2);
+    if (!n)
+        return NULL;
+    for (int64_t i = t; i < b; i++)
+        atomic_store_explicit(&n->slot[i & n->mask],
+                              atomic_load_explicit(&r->slot[i & r->mask], memory_order_relaxed),
+                              memory_order_relaxed);
+    atomic_store_explicit(&dq->ring, n, memory_order_seq_cst);
+    r->retired_at = atomic_fetch_add_explicit(&dq->epoch, 1, memory_order_seq_cst);
+    r->next = dq->retired;
+    dq->retired = r;
+    wsring_collect(dq);
+    return n;
+}
+
+int ll_wsdeque_push_(ll_wsdeque_t *dq, void *elm)
+{
+    int64_t b = atomic_load_explicit(&dq->bottom, memory_order_relaxed);
+    int64_t t = atomic_load_explicit(&dq->top, memory_order_acquire);
+    struct ll_wsring *r = atomic_load_explicit(&dq->ring, memory_order_relaxed);
+    if (b - t > (int64_t)r->mask && !(r = wsdeque_grow(dq, r, t, b)))
+        return -1;
+    atomic_store_explicit(&r->slot[b & r->mask], (uintptr_t)elm, memory_order_relaxed);
+    atomic_store_explicit(&dq->bottom, b + 1, memory_order_release);
+    return 0;
+}
+
+void *ll_wsdeque_pop_(ll_wsdeque_t *dq)
+{
+    int64_t b = atomic_load_explicit(&dq->bottom, memory_order_relaxed) - 1;
+    struct ll_wsring *r = atomic_load_explicit(&dq->ring, memory_order_relaxed);
+    atomic_store_explicit(&dq->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t t = atomic_load_explicit(&dq->top, memory_order_relaxed);
+    if (t > b) {
+        atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+        return NULL;
+    }
+    void *elm = (void *)atomic_load_explicit(&r->slot[b & r->mask], memory_order_relaxed);
+    if (t == b) {
+        /* Last one: race the thieves for it. */
+        if (!atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1,
+                                                     memory_order_seq_cst, memory_order_relaxed))
+            elm = NULL;
+        atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+    }
+    return elm;
+}
+
+/* Take the element at the top into *elm: 1, or 0 if empty, -1 if another taker won. */
+static int wsdeque_take_top(ll_wsdeque_t *dq, void **elm)
+{
+    int64_t t = atomic_load_explicit(&dq->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = atomic_load_explicit(&dq->bottom, memory_order_acquire);
+    if (t >= b)
+        return 0;
+    struct ll_wsring *r = atomic_load_explicit(&dq->ring, memory_order_seq_cst);
+    uintptr_t v = atomic_load_explicit(&r->slot[t & r->mask], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed))
+        return -1;
+    *elm = (void *)v;
+    return 1;
+}
+
+void *ll_wsdeque_steal_(ll_wsdeque_t *dq)
+{
+    walk_pin_t pin = walk_pin(dq->domain, &dq->epoch);
+    void *elm = NULL;
+    while (wsdeque_take_top(dq, &elm) < 0)
+        ;
+    walk_unpin(&pin);
+    return elm;
+}
+
+/*
+ * One CAS per element: the owner takes from the bottom without a CAS
+ * while it sees more than one element, so a thief can only claim the top
+ * position safely, never a range.
+ */
+size_t ll_wsdeque_steal_half_(ll_wsdeque_t *dq, void **out, size_t max)
+{
+    walk_pin_t pin = walk_pin(dq->domain, &dq->epoch);
+    size_t want = (ll_wsdeque_size_(dq) + 1) / 2, n = 0;
+    if (want > max)
+        want = max;
+    while (n < want) {
+        int rc = wsdeque_take_top(dq, &out[n]);
+        if (rc > 0)
+            n++;
+        else if (rc == 0 || n)
+            break;
+    }
+    walk_unpin(&pin);
+    return n;
+}
+
+size_t ll_wsdeque_size_(ll_wsdeque_t *dq)
+{
+    int64_t t = atomic_load_explicit(&dq->top, memory_order_acquire);
+    int64_t b = atomic_load_explicit(&dq->bottom, memory_order_acquire);
+    return b > t ? (size_t)(b - t) : 0;
 }
@@ -0,0 +1,1102 @@
+/**
+ * File-backed arena for the versioned list.
+ * Header, nodes and payloads share one MAP_SHARED mapping; every link is an
+ * offset from the start of the mapping. Blocks come from power-of-two size
+ * classes with lock-free free lists. Reclamation is epoch-like: readers pin
+ * the commit id they started at, unlinked nodes record the commit id at
+ * which they were retired, and a node is freed once no pin is at or before
+ * that id.
+ *
+ * The same mapping may be attached by several processes (a shared file or a
+ * POSIX shared-memory object). Thread slots and the reclaim lock are owned
+ * by a (pid, thread) token, and each attached process registers its pid, so
+ * the slots of a process that died are reaped instead of pinning garbage
+ * forever; a thread that exits releases its own. Liveness checks
+ * (kill(pid, 0)) run on open, close and explicit ll_arena_reclaim calls
+ * that find something held back. Reclaim passes the list operations start
+ * themselves check at most every ARENA_REAP_NS, never on every pass.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "list_arena.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ARENA_MAGIC          0x31414e4552414c4cULL   /* "LLARENA1" */
+#define ARENA_VERSION        2
+#define ARENA_HDR_SIZE       4096
+#define ARENA_MIN_BLOCK      32
+#define ARENA_NCLASSES       24
+#define ARENA_MAX_SLOTS      64
+#define ARENA_MAX_PROCS      32
+#define ARENA_RECLAIM_EVERY  64
+#define ARENA_REAP_NS        100000000ull   /* liveness checks from list operations */
+
+/* Free-list heads pack a 40-bit offset with a 24-bit ABA tag. */
+#define ARENA_OFF_BITS       40
+#define ARENA_OFF_MASK       ((UINT64_C(1) << ARENA_OFF_BITS) - 1)
+#define ARENA_TAG_ONE        (UINT64_C(1) << ARENA_OFF_BITS)
+
+/* Low bit of a next link: node is being unlinked, do not CAS past it. */
+#define ARENA_MARK           UINT64_C(1)
+
+/* Block states; non-zero so untouched (zeroed) space never looks in use. */
+#define BLK_FREE     0xF1u
+#define BLK_ALLOC    0xA1u   /* payload owned by the user */
+#define BLK_LINKED   0x71u   /* node published (or about to be) in the list */
+#define BLK_RETIRED  0xD1u   /* node unlinked, waiting for readers to leave */
+
+#define BLK_OWNS_PAYLOAD  1u /* free the payload together with the node */
+#define BLK_REACHED       2u /* recovery: node reachable from head */
+
+struct arena_hdr {
+    _Atomic uint64_t magic;
+    uint32_t version;
+    uint32_t hdr_size;
+    uint64_t size;
+    _Atomic uint64_t clean;           /* 1 after the last ll_arena_close */
+    _Atomic uint64_t open_lock;       /* pid serializing attach/detach */
+    _Atomic uint64_t bump;            /* next never-used offset */
+    _Atomic uint64_t head;            /* offset of first node; 0 = empty */
+    _Atomic uint64_t commit_id;
+    _Atomic uint64_t root;
+    _Atomic uint64_t retired;         /* unlinked nodes; reclaimer only */
+    _Atomic uint64_t reclaim_owner;   /* token of the reclaimer; 0 = nobody */
+    _Atomic uint64_t pending;         /* removals since last reclaim */
+    _Atomic uint64_t overflow_readers;/* readers that found no free slot */
+    _Atomic uint64_t free_lists[ARENA_NCLASSES];
+    _Atomic uint64_t slot_owner[ARENA_MAX_SLOTS];
+    _Atomic uint64_t pins[ARENA_MAX_SLOTS];
+    _Atomic uint64_t procs[ARENA_MAX_PROCS];  /* pids of attached processes */
+};
+
+_Static_assert(sizeof(struct arena_hdr) <= ARENA_HDR_SIZE, "arena header too large");
+
+/* Every block starts with this; payload or node body follows. */
+typedef struct arena_block {
+    uint32_t size_class;
+    _Atomic uint32_t state;
+    _Atomic uint32_t flags;
+    uint32_t reserved;
+} arena_block_t;
+
+/* Offset-linked counterpart of versioned_node_t. */
+typedef struct arena_node {
+    _Atomic uint64_t next;
+    uint64_t user_elm;                /* offset of the payload block */
+    uint64_t insert_txn_id;
+    _Atomic uint64_t removed_txn_id;  /* 0 = not removed */
+    uint64_t retire_era;              /* commit id when unlinked */
+    uint64_t retire_next;
+} arena_node_t;
+
+#define ARENA_NODE_BYTES (sizeof(arena_block_t) + sizeof(arena_node_t))
+
+struct ll_arena {
+    char *base;
+    struct arena_hdr *hdr;
+    size_t size;
+    int fd;
+    uint64_t pid;
+    bool recovered;
+    _Atomic uint64_t reap_at;         /* monotonic ns; see reap_due */
+    _Atomic uint64_t claimed;         /* bit s: slot s taken by a thread through this handle */
+    ll_arena_t *next;                 /* in open_arenas */
+};
+
+_Static_assert(ARENA_MAX_SLOTS <= 64, "ll_arena.claimed is one bit per slot");
+
+static inline arena_block_t *blk(const ll_arena_t *a, uint64_t off)
+{
+    return (arena_block_t *)(a->base + off);
+}
+
+static inline arena_node_t *node(const ll_arena_t *a, uint64_t off)
+{
+    return (arena_node_t *)(a->base + off + sizeof(arena_block_t));
+}
+
+static inline void *payload(const ll_arena_t *a, uint64_t off)
+{
+    return a->base + off + sizeof(arena_block_t);
+}
+
+static inline _Atomic uint64_t *free_next(const ll_arena_t *a, uint64_t off)
+{
+    return (_Atomic uint64_t *)payload(a, off);
+}
+
+static inline size_t class_size(unsigned c)
+{
+    return (size_t)ARENA_MIN_BLOCK << c;
+}
+
+static int class_for(size_t bytes)
+{
+    for (unsigned c = 0; c < ARENA_NCLASSES; c++)
+        if (class_size(c) >= bytes)
+            return (int)c;
+    return -1;
+}
+
+static int visible(const arena_node_t *w, uint64_t snapshot_version)
+{
+    uint64_t rid = atomic_load_explicit(&w->removed_txn_id, memory_order_acquire);
+    return w->insert_txn_id <= snapshot_version && (rid == 0 || rid > snapshot_version);
+}
+
+/* --- Block allocator --- */
+
+static uint64_t block_alloc(ll_arena_t *a, size_t bytes)
+{
+    int c = class_for(bytes);
+    if (c < 0)
+        return 0;
+    _Atomic uint64_t *fl = &a->hdr->free_lists[c];
+    uint64_t top = atomic_load_explicit(fl, memory_order_acquire);
+    while (top & ARENA_OFF_MASK) {
+        uint64_t off = top & ARENA_OFF_MASK;
+        /* The block may be reused under us; the mapping stays valid and the tag catches it. */
+        uint64_t next = atomic_load_explicit(free_next(a, off), memory_order_relaxed);
+        uint64_t tagged = (next & ARENA_OFF_MASK) | ((top & ~ARENA_OFF_MASK) + ARENA_TAG_ONE);
+        if (atomic_compare_exchange_weak_explicit(fl, &top, tagged,
+                                                  memory_order_acq_rel, memory_order_acquire))
+            return off;
+    }
+    size_t sz = class_size((unsigned)c);
+    uint64_t off = atomic_fetch_add_explicit(&a->hdr->bump, sz, memory_order_relaxed);
+    if (off + sz > a->hdr->size)
+        return 0;  /* arena full */
+    blk(a, off)->size_class = (uint32_t)c;
+    return off;
+}
+
+static void block_free(ll_arena_t *a, uint64_t off)
+{
+    arena_block_t *b = blk(a, off);
+    _Atomic uint64_t *fl = &a->hdr->free_lists[b->size_class];
+    atomic_store_explicit(&b->flags, 0u, memory_order_relaxed);
+    atomic_store_explicit(&b->state, BLK_FREE, memory_order_relaxed);
+    uint64_t top = atomic_load_explicit(fl, memory_order_acquire);
+    uint64_t tagged;
+    do {
+        atomic_store_explicit(free_next(a, off), top & ARENA_OFF_MASK, memory_order_relaxed);
+        tagged = off | ((top & ~ARENA_OFF_MASK) + ARENA_TAG_ONE);
+    } while (!atomic_compare_exchange_weak_explicit(fl, &top, tagged,
+                                                    memory_order_release, memory_order_acquire));
+}
+
+static int block_ok(const ll_arena_t *a, uint64_t off, uint64_t end)
+{
+    if (off < ARENA_HDR_SIZE || off >= end || (off - ARENA_HDR_SIZE) % ARENA_MIN_BLOCK)
+        return 0;
+    uint32_t c = blk(a, off)->size_class;
+    return c < ARENA_NCLASSES && off + class_size(c) <= end;
+}
+
+static uint64_t payload_off(const ll_arena_t *a, const void *elm)
+{
+    if (!elm)
+        return 0;
+    uint64_t off = (uint64_t)((const char *)elm - a->base) - sizeof(arena_block_t);
+    uint64_t end = atomic_load_explicit(&a->hdr->bump, memory_order_acquire);
+    if (end > a->hdr->size)
+        end = a->hdr->size;
+    if (!block_ok(a, off, end) ||
+        atomic_load_explicit(&blk(a, off)->state, memory_order_acquire) != BLK_ALLOC)
+        return 0;
+    return off;
+}
+
+/* --- Process registry --- */
+
+static int pid_alive(uint64_t pid)
+{
+    return kill((pid_t)pid, 0) == 0 || errno == EPERM;
+}
+
+static uint64_t token_pid(uint64_t token)
+{
+    return token >> 32;
+}
+
+/* Drop registrations, slots and the reclaim lock held by processes that no longer exist. */
+static void reap_dead(ll_arena_t *a)
+{
+    struct arena_hdr *h = a->hdr;
+    for (int p = 0; p < ARENA_MAX_PROCS; p++) {
+        uint64_t pid = atomic_load(&h->procs[p]);
+        if (pid && pid != a->pid && !pid_alive(pid))
+            atomic_compare_exchange_strong(&h->procs[p], &pid, (uint64_t)0);
+    }
+    for (int s = 0; s < ARENA_MAX_SLOTS; s++) {
+        uint64_t owner = atomic_load(&h->slot_owner[s]);
+        if (owner && token_pid(owner) != a->pid && !pid_alive(token_pid(owner))) {
+            atomic_store(&h->pins[s], (uint64_t)0);
+            atomic_compare_exchange_strong(&h->slot_owner[s], &owner, (uint64_t)0);
+        }
+    }
+    uint64_t owner = atomic_load(&h->reclaim_owner);
+    if (owner && token_pid(owner) != a->pid && !pid_alive(token_pid(owner)))
+        atomic_compare_exchange_strong(&h->reclaim_owner, &owner, (uint64_t)0);
+}
+
+/*
+ * Reclaim passes started by the list operations themselves check liveness
+ * at most once per ARENA_REAP_NS per handle, so a reader that stays pinned
+ * does not cost a kill() per slot on every pass. Explicit ll_arena_reclaim
+ * calls, open and close always check.
+ */
+static bool reap_due(ll_arena_t *a)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now = (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+    uint64_t at = atomic_load_explicit(&a->reap_at, memory_order_relaxed);
+    return now >= at &&
+           atomic_compare_exchange_strong_explicit(&a->reap_at, &at, now + ARENA_REAP_NS,
+                                                   memory_order_relaxed, memory_order_relaxed);
+}
+
+/* --- Reader pins: one slot per thread; pin = commit id at pin time --- */
+
+#define ARENA_SLOT_CACHE 4   /* initial entries; doubles as a thread reads more arenas */
+
+typedef struct {
+    const struct arena_hdr *hdr;
+    int slot;
+    int depth;
+} arena_slot_t;
+
+static _Atomic uint32_t arena_thread_serial;
+static _Thread_local uint32_t arena_thread_id;
+static _Thread_local arena_slot_t *arena_slots;   /* one entry per arena this thread reads */
+static _Thread_local int arena_nslots;
+
+/*
+ * The arenas this process has open, so a thread that exits can tell which
+ * of its cached slots still point into a live mapping.
+ */
+static pthread_mutex_t open_arenas_lock = PTHREAD_MUTEX_INITIALIZER;
+static ll_arena_t *open_arenas;
+
+static void arenas_add(ll_arena_t *a)
+{
+    pthread_mutex_lock(&open_arenas_lock);
+    a->next = open_arenas;
+    open_arenas = a;
+    pthread_mutex_unlock(&open_arenas_lock);
+}
+
+static void arenas_remove(ll_arena_t *a)
+{
+    pthread_mutex_lock(&open_arenas_lock);
+    ll_arena_t **pp = &open_arenas;
+    while (*pp != a)
+        pp = &(*pp)->next;
+    *pp = a->next;
+    pthread_mutex_unlock(&open_arenas_lock);
+}
+
+/* (pid, thread) pair: unique across every process attached to the mapping. */
+static uint64_t my_token(const ll_arena_t *a)
+{
+    if (!arena_thread_id)
+        arena_thread_id = atomic_fetch_add(&arena_thread_serial, 1) + 1;
+    return (a->pid << 32) | arena_thread_id;
+}
+
+/* Give slot s of a back; the caller is its owner or a's last user. */
+static void slot_release(ll_arena_t *a, int s)
+{
+    atomic_fetch_and(&a->claimed, ~(UINT64_C(1) << s));
+    atomic_store(&a->hdr->pins[s], (uint64_t)0);
+    atomic_store(&a->hdr->slot_owner[s], (uint64_t)0);
+}
+
+/*
+ * Thread exit: give back the slots this thread holds in arenas still open.
+ * One closed meanwhile has already released them, and its header may be
+ * unmapped, so only headers of open arenas are touched.
+ */
+static void thread_exit(void *unused)
+{
+    (void)unused;
+    uint64_t me = ((uint64_t)getpid() << 32) | arena_thread_id;
+    pthread_mutex_lock(&open_arenas_lock);
+    for (int i = 0; i < arena_nslots; i++) {
+        if (!arena_slots[i].hdr)
+            continue;
+        int s = arena_slots[i].slot;
+        for (ll_arena_t *a = open_arenas; a; a = a->next) {
+            if (a->hdr == arena_slots[i].hdr &&
+                atomic_load(&a->hdr->slot_owner[s]) == me) {
+                slot_release(a, s);
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&open_arenas_lock);
+    free(arena_slots);
+    arena_slots = NULL;
+    arena_nslots = 0;
+}
+
+static pthread_key_t thread_key;
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+
+static void thread_key_init(void)
+{
+    pthread_key_create(&thread_key, thread_exit);
+}
+
+/* Run thread_exit when this thread ends (the value only has to be non-NULL). */
+static void thread_hook(void)
+{
+    pthread_once(&thread_key_once, thread_key_init);
+    pthread_setspecific(thread_key, &thread_key);
+}
+
+/*
+ * This thread's entry for a, claiming a slot on first use; -1 if every
+ * slot is taken (or there is no memory for the entry), and the caller
+ * pins as an overflow reader.
+ */
+static int thread_slot(ll_arena_t *a)
+{
+    struct arena_hdr *h = a->hdr;
+    uint64_t me = my_token(a);
+    int spare = -1;
+    for (int i = 0; i < arena_nslots; i++) {
+        if (arena_slots[i].hdr == h) {
+            int s = arena_slots[i].slot;
+            if (atomic_load_explicit(&h->slot_owner[s], memory_order_acquire) == me)
+                return i;
+            arena_slots[i].hdr = NULL;  /* stale: arena was closed and reopened */
+        }
+        if (!arena_slots[i].hdr && spare < 0)
+            spare = i;
+    }
+    if (spare < 0) {
+        int n = arena_nslots ? 2 * arena_nslots : ARENA_SLOT_CACHE;
+        arena_slot_t *grown = (arena_slot_t *)realloc(arena_slots, (size_t)n * sizeof(*grown));
+        if (!grown)
+            return -1;
+        memset(grown + arena_nslots, 0, (size_t)(n - arena_nslots) * sizeof(*grown));
+        spare = arena_nslots;
+        arena_slots = grown;
+        arena_nslots = n;
+        thread_hook();   /* thread_exit frees the array */
+    }
+    for (int s = 0; s < ARENA_MAX_SLOTS; s++) {
+        uint64_t expected = 0;
+        if (atomic_compare_exchange_strong(&h->slot_owner[s], &expected, me)) {
+            atomic_fetch_or(&a->claimed, UINT64_C(1) << s);
+            arena_slots[spare].hdr = h;
+            arena_slots[spare].slot = s;
+            arena_slots[spare].depth = 0;
+            return spare;
+        }
+    }
+    return -1;
+}
+
+/* Pin the current commit id; returns a handle for pin_exit and sets *S to the snapshot. */
+static int pin_enter(ll_arena_t *a, uint64_t *S)
+{
+    int i = thread_slot(a);
+    if (i < 0) {
+        atomic_fetch_add(&a->hdr->overflow_readers, 1);
+        *S = atomic_load(&a->hdr->commit_id);
+        return -1;
+    }
+    *S = atomic_load(&a->hdr->commit_id);
+    if (arena_slots[i].depth++ == 0)
+        atomic_store(&a->hdr->pins[arena_slots[i].slot], *S);
+    return i;
+}
+
+static void pin_exit(ll_arena_t *a, int i)
+{
+    if (i < 0) {
+        atomic_fetch_sub(&a->hdr->overflow_readers, 1);
+        return;
+    }
+    if (--arena_slots[i].depth == 0)
+        atomic_store(&a->hdr->pins[arena_slots[i].slot], (uint64_t)0);
+}
+
+static uint64_t min_pin(const ll_arena_t *a)
+{
+    uint64_t min = UINT64_MAX;
+    for (int s = 0; s < ARENA_MAX_SLOTS; s++) {
+        uint64_t v = atomic_load(&a->hdr->pins[s]);
+        if (v != 0 && v < min)
+            min = v;
+    }
+    return min;
+}
+
+/* --- Reclamation --- */
+
+static void retire(ll_arena_t *a, uint64_t off)
+{
+    arena_node_t *w = node(a, off);
+    w->retire_era = atomic_fetch_add(&a->hdr->commit_id, 1);
+    w->retire_next = atomic_load_explicit(&a->hdr->retired, memory_order_relaxed);
+    atomic_store_explicit(&blk(a, off)->state, BLK_RETIRED, memory_order_relaxed);
+    atomic_store_explicit(&a->hdr->retired, off, memory_order_relaxed);
+}
+
+/* Free what no pin still covers; true if something had to be kept. */
+static bool free_retired(ll_arena_t *a)
+{
+    if (atomic_load(&a->hdr->overflow_readers) != 0)
+        return false;
+    uint64_t min = min_pin(a);
+    uint64_t keep = 0;
+    uint64_t off = atomic_load_explicit(&a->hdr->retired, memory_order_relaxed);
+    while (off) {
+        arena_node_t *w = node(a, off);
+        uint64_t next = w->retire_next;
+        if (min <= w->retire_era) {
+            w->retire_next = keep;
+            keep = off;
+        } else {
+            /* Node first: a crash in between leaks the payload instead of double-freeing it. */
+            uint64_t user = w->user_elm;
+            int owns = atomic_load_explicit(&blk(a, off)->flags, memory_order_relaxed) & BLK_OWNS_PAYLOAD;
+            block_free(a, off);
+            if (owns)
+                block_free(a, user);
+        }
+        off = next;
+    }
+    atomic_store_explicit(&a->hdr->retired, keep, memory_order_relaxed);
+    return keep != 0;
+}
+
+/* One pass; "always" reaps dead processes whenever something is held back, else per reap_due. */
+static size_t arena_reclaim(ll_arena_t *a, bool always)
+{
+    struct arena_hdr *h = a->hdr;
+    uint64_t expected = 0;
+    if (!atomic_compare_exchange_strong(&h->reclaim_owner, &expected, my_token(a))) {
+        /* A reclaimer that died mid-pass would hold the lock forever. */
+        if (token_pid(expected) != a->pid && (always || reap_due(a)) &&
+            !pid_alive(token_pid(expected)))
+            reap_dead(a);
+        return 0;
+    }
+    atomic_store_explicit(&h->pending, 0, memory_order_relaxed);
+    uint64_t min_active = min_pin(a);
+    int pinned = min_active != UINT64_MAX;
+    int blocked = 0;
+    if (!pinned)
+        min_active = atomic_load(&h->commit_id);
+    size_t n = 0;
+    _Atomic uint64_t *link = &h->head;
+    for (;;) {
+        uint64_t cur = atomic_load(link) & ~ARENA_MARK;
+        if (!cur)
+            break;
+        arena_node_t *w = node(a, cur);
+        uint64_t nx = atomic_load(&w->next);
+        uint64_t rid = atomic_load(&w->removed_txn_id);
+        if ((nx & ARENA_MARK) || (rid != 0 && rid < min_active)) {
+            /* Mark first so a concurrent insert after this node fails its CAS and retries. */
+            if (!(nx & ARENA_MARK))
+                nx = atomic_fetch_or(&w->next, ARENA_MARK);
+            nx &= ~ARENA_MARK;
+            if (atomic_compare_exchange_strong(link, &cur, nx)) {
+                retire(a, cur);
+                n++;
+            }
+            continue;  /* re-read the same link */
+        }
+        if (rid != 0)
+            blocked = 1;
+        link = &w->next;
+    }
+    bool kept = free_retired(a);
+    /* Something held back by a pin: if its owner died, the next pass can take it. */
+    if (((blocked && pinned) || kept) && (always || reap_due(a)))
+        reap_dead(a);
+    atomic_store_explicit(&h->reclaim_owner, 0, memory_order_release);
+    return n;
+}
+
+size_t ll_arena_reclaim(ll_arena_t *a)
+{
+    return arena_reclaim(a, true);
+}
+
+static void note_removal(ll_arena_t *a)
+{
+    if (atomic_fetch_add_explicit(&a->hdr->pending, 1, memory_order_relaxed) + 1 >= ARENA_RECLAIM_EVERY)
+        arena_reclaim(a, false);
+}
+
+/* --- Payload allocation --- */
+
+void *ll_arena_alloc(ll_arena_t *a, size_t size)
+{
+    uint64_t off = block_alloc(a, size + sizeof(arena_block_t));
+    if (!off)
+        return NULL;
+    arena_block_t *b = blk(a, off);
+    atomic_store_explicit(&b->flags, 0u, memory_order_relaxed);
+    void *p = payload(a, off);
+    /* A block_alloc that lost the race for this block may still read its free-list link. */
+    atomic_store_explicit(free_next(a, off), (uint64_t)0, memory_order_relaxed);
+    memset((char *)p + sizeof(uint64_t), 0,
+           class_size(b->size_class) - sizeof(arena_block_t) - sizeof(uint64_t));
+    atomic_store_explicit(&b->state, BLK_ALLOC, memory_order_release);
+    return p;
+}
+
+void ll_arena_free(ll_arena_t *a, void *elm)
+{
+    uint64_t off = payload_off(a, elm);
+    if (off)
+        block_free(a, off);
+}
+
+uint64_t ll_arena_off(const ll_arena_t *a, const void *p)
+{
+    return p ? (uint64_t)((const char *)p - a->base) : 0;
+}
+
+void *ll_arena_ptr(const ll_arena_t *a, uint64_t off)
+{
+    return off ? a->base + off : NULL;
+}
+
+void ll_arena_set_root(ll_arena_t *a, void *p)
+{
+    atomic_store_explicit(&a->hdr->root, ll_arena_off(a, p), memory_order_release);
+}
+
+void *ll_arena_root(const ll_arena_t *a)
+{
+    return ll_arena_ptr(a, atomic_load_explicit(&a->hdr->root, memory_order_acquire));
+}
+
+/* --- List operations --- */
+
+static uint64_t node_new(ll_arena_t *a, const void *elm)
+{
+    uint64_t user = payload_off(a, elm);
+    if (!user)
+        return 0;
+    uint64_t off = block_alloc(a, ARENA_NODE_BYTES);
+    if (!off)
+        return 0;
+    arena_node_t *w = node(a, off);
+    w->user_elm = user;
+    w->insert_txn_id = atomic_fetch_add_explicit(&a->hdr->commit_id, 1, memory_order_acq_rel);
+    atomic_store_explicit(&w->removed_txn_id, (uint64_t)0, memory_order_relaxed);
+    atomic_store_explicit(&w->next, (uint64_t)0, memory_order_relaxed);
+    w->retire_era = 0;
+    w->retire_next = 0;
+    atomic_store_explicit(&blk(a, off)->flags, BLK_OWNS_PAYLOAD, memory_order_relaxed);
+    /* LINKED before publication: recovery frees LINKED nodes it cannot reach. */
+    atomic_store_explicit(&blk(a, off)->state, BLK_LINKED, memory_order_release);
+    return off;
+}
+
+int ll_arena_insert_head(ll_arena_t *a, void *elm)
+{
+    uint64_t off = node_new(a, elm);
+    if (!off)
+        return -1;
+    arena_node_t *w = node(a, off);
+    uint64_t old_head = atomic_load_explicit(&a->hdr->head, memory_order_acquire);
+    do {
+        atomic_store_explicit(&w->next, old_head, memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&a->hdr->head, &old_head, off,
+                                                    memory_order_release, memory_order_acquire));
+    return 0;
+}
+
+int ll_arena_insert_tail(ll_arena_t *a, void *elm)
+{
+    uint64_t off = node_new(a, elm);
+    if (!off)
+        return -1;
+    uint64_t S;
+    int pin = pin_enter(a, &S);
+    for (;;) {
+        _Atomic uint64_t *link = &a->hdr->head;
+        uint64_t v = atomic_load(link);
+        while (v && !(v & ARENA_MARK)) {
+            link = &node(a, v)->next;
+            v = atomic_load(link);
+        }
+        if (v & ARENA_MARK)
+            continue;  /* last node is being unlinked; walk again */
+        uint64_t expected = 0;
+        if (atomic_compare_exchange_strong(link, &expected, off))
+            break;
+    }
+    pin_exit(a, pin);
+    return 0;
+}
+
+int ll_arena_insert_after(ll_arena_t *a, void *after_elm, void *elm)
+{
+    uint64_t anchor = payload_off(a, after_elm);
+    if (!anchor)
+        return -1;
+    uint64_t off = node_new(a, elm);
+    if (!off)
+        return -1;
+    arena_node_t *w = node(a, off);
+    uint64_t S;
+    int pin = pin_enter(a, &S);
+    uint64_t cur = atomic_load(&a->hdr->head);
+    while (cur) {
+        arena_node_t *c = node(a, cur);
+        if (c->user_elm == anchor && visible(c, S)) {
+            uint64_t old_next = atomic_load(&c->next);
+            if (old_next & ARENA_MARK) {
+                cur = atomic_load(&a->hdr->head);  /* anchor being unlinked; search again */
+                continue;
+            }
+            atomic_store_explicit(&w->next, old_next, memory_order_relaxed);
+            if (atomic_compare_exchange_strong(&c->next, &old_next, off)) {
+                pin_exit(a, pin);
+                return 0;
+            }
+            continue;
+        }
+        cur = atomic_load(&c->next) & ~ARENA_MARK;
+    }
+    pin_exit(a, pin);
+    block_free(a, off);
+    return -1;  /* after_elm not in list */
+}
+
+void *ll_arena_remove_head(ll_arena_t *a)
+{
+    uint64_t S, C = 0;
+    void *user = NULL;
+    int pin = pin_enter(a, &S);
+    uint64_t cur = atomic_load(&a->hdr->head);
+    while (cur) {
+        arena_node_t *w = node(a, cur);
+        if (visible(w, S)) {
+            uint64_t expected = 0;
+            if (!C)
+                C = atomic_fetch_add_explicit(&a->hdr->commit_id, 1, memory_order_acq_rel);
+            if (atomic_compare_exchange_strong(&w->removed_txn_id, &expected, C)) {
+                /* Caller owns the payload now; reclaim frees only the node. */
+                atomic_fetch_and(&blk(a, cur)->flags, ~BLK_OWNS_PAYLOAD);
+                user = payload(a, w->user_elm);
+                break;
+            }
+        }
+        cur = atomic_load(&w->next) & ~ARENA_MARK;
+    }
+    pin_exit(a, pin);
+    if (user)
+        note_removal(a);
+    return user;
+}
+
+int ll_arena_remove(ll_arena_t *a, void *elm)
+{
+    uint64_t user = payload_off(a, elm);
+    if (!user)
+        return -1;
+    uint64_t S;
+    int found = 0;
+    int pin = pin_enter(a, &S);
+    uint64_t C = atomic_fetch_add_explicit(&a->hdr->commit_id, 1, memory_order_acq_rel);
+    uint64_t cur = atomic_load(&a->hdr->head);
+    while (cur) {
+        arena_node_t *w = node(a, cur);
+        uint64_t expected = 0;
+        if (w->user_elm == user &&
+            atomic_compare_exchange_strong(&w->removed_txn_id, &expected, C)) {
+            found = 1;
+            break;
+        }
+        cur = atomic_load(&w->next) & ~ARENA_MARK;
+    }
+    pin_exit(a, pin);
+    if (!found)
+        return -1;
+    note_removal(a);
+    return 0;
+}
+
+bool ll_arena_contains(ll_arena_t *a, const void *elm)
+{
+    uint64_t user = payload_off(a, elm);
+    if (!user)
+        return false;
+    uint64_t S;
+    bool found = false;
+    int pin = pin_enter(a, &S);
+    uint64_t cur = atomic_load(&a->hdr->head);
+    while (cur) {
+        arena_node_t *w = node(a, cur);
+        if (w->user_elm == user && visible(w, S)) {
+            found = true;
+            break;
+        }
+        cur = atomic_load(&w->next) & ~ARENA_MARK;
+    }
+    pin_exit(a, pin);
+    return found;
+}
+
+size_t ll_arena_size(ll_arena_t *a)
+{
+    uint64_t S;
+    size_t n = 0;
+    int pin = pin_enter(a, &S);
+    uint64_t cur = atomic_load(&a->hdr->head);
+    while (cur) {
+        arena_node_t *w = node(a, cur);
+        if (visible(w, S))
+            n++;
+        cur = atomic_load(&w->next) & ~ARENA_MARK;
+    }
+    pin_exit(a, pin);
+    return n;
+}
+
+void ll_arena_foreach(ll_arena_t *a, ll_arena_foreach_fn cb, void *userdata)
+{
+    uint64_t S;
+    int pin = pin_enter(a, &S);
+    uint64_t cur = atomic_load(&a->hdr->head);
+    while (cur) {
+        arena_node_t *w = node(a, cur);
+        if (visible(w, S))
+            cb(payload(a, w->user_elm), userdata);
+        cur = atomic_load(&w->next) & ~ARENA_MARK;
+    }
+    pin_exit(a, pin);
+}
+
+/* --- Open / close / recovery --- */
+
+static void arena_format(ll_arena_t *a)
+{
+    struct arena_hdr *h = a->hdr;
+    h->version = ARENA_VERSION;
+    h->hdr_size = ARENA_HDR_SIZE;
+    h->size = a->size;
+    atomic_store(&h->bump, (uint64_t)ARENA_HDR_SIZE);
+    atomic_store(&h->head, (uint64_t)0);
+    atomic_store(&h->commit_id, (uint64_t)1);
+    atomic_store(&h->clean, (uint64_t)1);
+    atomic_store(&h->magic, ARENA_MAGIC);  /* last: a torn create is not mistaken for an arena */
+}
+
+/*
+ * Crash recovery. Linear in the allocated region: walk the list once,
+ * cutting it at the first link that does not lead to a node block (or that
+ * closes a cycle), then sweep all blocks to rebuild the free lists. Nodes
+ * that were published but are no longer reachable are freed; payloads of
+ * such nodes stay allocated (the user may still reference them via root).
+ */
+static void arena_recover(ll_arena_t *a)
+{
+    struct arena_hdr *h = a->hdr;
+    uint64_t end = atomic_load(&h->bump);
+    if (end > h->size)
+        end = h->size;
+    if (end < ARENA_HDR_SIZE)
+        end = ARENA_HDR_SIZE;
+
+    /* Pins, registrations and the reclaim lock belonged to dead processes. */
+    for (int p = 0; p < ARENA_MAX_PROCS; p++)
+        atomic_store(&h->procs[p], (uint64_t)0);
+    for (int s = 0; s < ARENA_MAX_SLOTS; s++) {
+        atomic_store(&h->slot_owner[s], (uint64_t)0);
+        atomic_store(&h->pins[s], (uint64_t)0);
+    }
+    atomic_store(&h->reclaim_owner, (uint64_t)0);
+    atomic_store(&h->overflow_readers, (uint64_t)0);
+    atomic_store(&h->pending, (uint64_t)0);
+    atomic_store(&h->retired, (uint64_t)0);
+
+    /* Trust block headers only up to the first one that does not parse. */
+    uint64_t off = ARENA_HDR_SIZE;
+    while (off < end) {
+        uint32_t c = blk(a, off)->size_class;
+        if (c >= ARENA_NCLASSES || off + class_size(c) > end)
+            break;
+        off += class_size(c);
+    }
+    end = off;
+
+    _Atomic uint64_t *link = &h->head;
+    for (;;) {
+        uint64_t v = atomic_load(link);
+        if (v & ARENA_MARK) {
+            /* Unlink was interrupted; the node stays removed and is unlinked by the next reclaim. */
+            v &= ~ARENA_MARK;
+            atomic_store(link, v);
+        }
+        if (!v)
+            break;
+        arena_block_t *b = block_ok(a, v, end) ? blk(a, v) : NULL;
+        if (!b || b->size_class != (uint32_t)class_for(ARENA_NODE_BYTES) ||
+            atomic_load(&b->state) != BLK_LINKED ||
+            (atomic_load(&b->flags) & BLK_REACHED) ||
+            !block_ok(a, node(a, v)->user_elm, end)) {
+            atomic_store(link, (uint64_t)0);
+            break;
+        }
+        atomic_fetch_or(&b->flags, BLK_REACHED);
+        link = &node(a, v)->next;
+    }
+
+    /* Payloads owned by retired nodes go back to the free lists below. */
+    for (off = ARENA_HDR_SIZE; off < end; off += class_size(blk(a, off)->size_class)) {
+        arena_block_t *b = blk(a, off);
+        if (atomic_load(&b->state) == BLK_RETIRED && (atomic_load(&b->flags) & BLK_OWNS_PAYLOAD)) {
+            uint64_t user = node(a, off)->user_elm;
+            if (block_ok(a, user, end) && atomic_load(&blk(a, user)->state) == BLK_ALLOC)
+                atomic_store(&blk(a, user)->state, BLK_FREE);
+        }
+    }
+
+    /* Rebuild free lists from free, retired and unreachable node blocks. */
+    for (int c = 0; c < ARENA_NCLASSES; c++)
+        atomic_store(&h->free_lists[c], (uint64_t)0);
+    for (off = ARENA_HDR_SIZE; off < end; off += class_size(blk(a, off)->size_class)) {
+        arena_block_t *b = blk(a, off);
+        uint32_t st = atomic_load(&b->state);
+        uint32_t fl = atomic_load(&b->flags);
+        if (st == BLK_ALLOC || (st == BLK_LINKED && (fl & BLK_REACHED))) {
+            atomic_store(&b->flags, fl & ~BLK_REACHED);
+            continue;
+        }
+        block_free(a, off);
+    }
+    atomic_store(&h->bump, end);
+    a->recovered = true;
+}
+
+static void open_lock(ll_arena_t *a)
+{
+    _Atomic uint64_t *lock = &a->hdr->open_lock;
+    for (;;) {
+        uint64_t owner = 0;
+        if (atomic_compare_exchange_strong(lock, &owner, a->pid))
+            return;
+        if (!pid_alive(owner)) {
+            atomic_compare_exchange_strong(lock, &owner, (uint64_t)0);
+            continue;
+        }
+        nanosleep(&(struct timespec){ .tv_sec = 0, .tv_nsec = 100000 }, NULL);
+    }
+}
+
+static void open_unlock(ll_arena_t *a)
+{
+    atomic_store(&a->hdr->open_lock, (uint64_t)0);
+}
+
+static int other_procs_attached(const ll_arena_t *a)
+{
+    for (int p = 0; p < ARENA_MAX_PROCS; p++) {
+        uint64_t pid = atomic_load(&a->hdr->procs[p]);
+        if (pid && pid != a->pid)
+            return 1;
+    }
+    return 0;
+}
+
+/* Wait (bounded) for a concurrent creator to size the object and write the magic. */
+static int wait_formatted(int fd, size_t *size)
+{
+    struct stat st;
+    for (int tries = 0; tries < 2000; tries++) {
+        if (fstat(fd, &st) < 0)
+            return -1;
+        if (st.st_size > 0) {
+            *size = (size_t)st.st_size;
+            return 0;
+        }
+        nanosleep(&(struct timespec){ .tv_sec = 0, .tv_nsec = 1000000 }, NULL);
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+/*
+ * Map fd and attach this process. The creator formats the header; everybody
+ * else validates it. Recovery runs only when no other live process is
+ * attached and the last one to leave did not close cleanly.
+ */
+static ll_arena_t *arena_attach(int fd, size_t size, int create)
+{
+    if (create) {
+        long page = sysconf(_SC_PAGESIZE);
+        size = (size + (size_t)page - 1) & ~((size_t)page - 1);
+        if (size < 2 * ARENA_HDR_SIZE || size > ARENA_OFF_MASK) {
+            errno = EINVAL;
+            goto fail_fd;
+        }
+        if (ftruncate(fd, (off_t)size) < 0)
+            goto fail_fd;
+    } else if (wait_formatted(fd, &size) < 0) {
+        goto fail_fd;
+    }
+    if (size < 2 * ARENA_HDR_SIZE) {
+        errno = EINVAL;
+        goto fail_fd;
+    }
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+        goto fail_fd;
+    ll_arena_t *a = (ll_arena_t *)calloc(1, sizeof(*a));
+    if (!a) {
+        munmap(base, size);
+        goto fail_fd;
+    }
+    a->base = (char *)base;
+    a->hdr = (struct arena_hdr *)base;
+    a->size = size;
+    a->fd = fd;
+    a->pid = (uint64_t)getpid();
+    struct arena_hdr *h = a->hdr;
+    if (create) {
+        arena_format(a);
+    } else {
+        for (int tries = 0; tries < 2000 && atomic_load(&h->magic) != ARENA_MAGIC; tries++)
+            nanosleep(&(struct timespec){ .tv_sec = 0, .tv_nsec = 1000000 }, NULL);
+        if (atomic_load(&h->magic) != ARENA_MAGIC || h->version != ARENA_VERSION ||
+            h->hdr_size != ARENA_HDR_SIZE || h->size != size) {
+            errno = EINVAL;
+            goto fail_map;
+        }
+    }
+
+    open_lock(a);
+    reap_dead(a);
+    /* Clean shutdown or live peers: nothing to check. Either way the file is dirty while open. */
+    if (atomic_exchange(&h->clean, (uint64_t)0) != 1 && !other_procs_attached(a))
+        arena_recover(a);
+    int registered = 0;
+    for (int p = 0; p < ARENA_MAX_PROCS && !registered; p++) {
+        uint64_t expected = 0;
+        registered = atomic_compare_exchange_strong(&h->procs[p], &expected, a->pid);
+    }
+    open_unlock(a);
+    if (!registered) {
+        errno = EAGAIN;
+        goto fail_map;
+    }
+    arenas_add(a);
+    return a;
+
+fail_map:
+    munmap(a->base, a->size);
+    free(a);
+fail_fd:
+    close(fd);
+    return NULL;
+}
+
+ll_arena_t *ll_arena_open(const char *path, size_t size)
+{
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+    int create = fd >= 0;
+    if (!create) {
+        if (errno != EEXIST)
+            return NULL;
+        fd = open(path, O_RDWR);
+        if (fd < 0)
+            return NULL;
+    }
+    return arena_attach(fd, size, create);
+}
+
+ll_arena_t *ll_arena_shm_open(const char *name, size_t size)
+{
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    int create = fd >= 0;
+    if (!create) {
+        if (errno != EEXIST)
+            return NULL;
+        fd = shm_open(name, O_RDWR, 0600);
+        if (fd < 0)
+            return NULL;
+    }
+    return arena_attach(fd, size, create);
+}
+
+int ll_arena_shm_unlink(const char *name)
+{
+    return shm_unlink(name);
+}
+
+int ll_arena_sync(ll_arena_t *a)
+{
+    return msync(a->base, a->size, MS_SYNC);
+}
+
+bool ll_arena_recovered(const ll_arena_t *a)
+{
+    return a->recovered;
+}
+
+int ll_arena_close(ll_arena_t *a)
+{
+    struct arena_hdr *h = a->hdr;
+    /* A walk through this handle still running would be left on an unmapped arena. */
+    uint64_t claimed = atomic_load(&a->claimed);
+    for (int s = 0; s < ARENA_MAX_SLOTS; s++) {
+        if ((claimed >> s & 1) && atomic_load(&h->pins[s])) {
+            errno = EBUSY;
+            return -1;
+        }
+    }
+    arenas_remove(a);
+    ll_arena_reclaim(a);
+    open_lock(a);
+    /* Only this handle's slots: another handle on the same file may have readers inside. */
+    claimed = atomic_load(&a->claimed);
+    for (int s = 0; s < ARENA_MAX_SLOTS; s++) {
+        if (claimed >> s & 1)
+            slot_release(a, s);
+    }
+    for (int p = 0; p < ARENA_MAX_PROCS; p++) {
+        uint64_t pid = a->pid;
+        atomic_compare_exchange_strong(&h->procs[p], &pid, (uint64_t)0);
+    }
+    reap_dead(a);
+    int rc = 0;
+    if (!other_procs_attached(a)) {
+        /* Last one out: leave the file in a state the next open can trust without a scan. */
+        ll_arena_reclaim(a);
+        rc = msync(a->base, a->size, MS_SYNC);
+        atomic_store(&h->clean, (uint64_t)1);
+        if (msync(a->base, ARENA_HDR_SIZE, MS_SYNC) < 0)
+            rc = -1;
+    }
+    open_unlock(a);
+    if (munmap(a->base, a->size) < 0)
+        rc = -1;
+    close(a->fd);
+    free(a);
+    return rc;
+}
@@ -2,16 +2,23 @@
  * Unit and concurrent tests for the concurrent linked list.
  */
 #include "list.h"
+#include "list_arena.h"
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <pthread.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 struct item {
     int value;
     LL_ENTRY(item, link);
 };
 LL_HEAD(list_head, item);
+LL_GENERATE(list_head, item, link)
 
 static int tests_run, tests_failed;
 
@@ -167,6 +174,57 @@ static int test_insert_after_nonexistent(void) {
     return 0;
 }
 
+/* --- Generated (LL_GENERATE) operations --- */
+static int item_cmp_value(const struct item *e, const void *key) {
+    return e->value != *(const int *)key;
+}
+
+static void item_sum_visit(struct item *e, void *userdata) {
+    *(long *)userdata += e->value;
+}
+
+static int test_generated_ops(void) {
+    struct list_head lst;
+    LL_INIT(&lst);
+    struct item *e[4];
+    for (int i = 0; i < 4; i++) {
+        e[i] = malloc(sizeof(struct item));
+        e[i]->value = i;
+    }
+    list_head_LL_INSERT_TAIL(&lst, e[1]);
+    list_head_LL_INSERT_HEAD(&lst, e[0]);
+    list_head_LL_INSERT_TAIL(&lst, e[3]);
+    list_head_LL_INSERT_AFTER(&lst, e[1], e[2]);
+    ASSERT_EQ(list_head_LL_SIZE(&lst), 4);
+    ASSERT(list_head_LL_CONTAINS(&lst, e[2]));
+    int key = 3;
+    ASSERT(list_head_LL_FIND(&lst, item_cmp_value, &key) == e[3]);
+    key = 7;
+    ASSERT(list_head_LL_FIND(&lst, item_cmp_value, &key) == NULL);
+    int idx = 0;
+    struct item *var;
+    LL_GFOREACH(var, list_head, &lst) {
+        ASSERT(var == e[idx]);
+        if (++idx == 2)
+            break;
+    }
+    ASSERT_EQ(idx, 2);
+    long sum = 0;
+    list_head_LL_VISIT(&lst, item_sum_visit, &sum);
+    ASSERT_EQ(sum, 6);
+    ll_txn_t *txn = list_head_LL_TXN_START(&lst);
+    ASSERT(txn);
+    list_head_LL_TXN_REMOVE(txn, e[2]);
+    ASSERT(!list_head_LL_TXN_CONTAINS(txn, e[2]));
+    ll_txn_commit(txn);
+    ASSERT(!list_head_LL_CONTAINS(&lst, e[2]));
+    ASSERT_EQ(list_head_LL_SIZE(&lst), 3);
+    free(e[2]);
+    while ((var = list_head_LL_REMOVE_HEAD(&lst)) != NULL)
+        free(var);
+    return 0;
+}
+
 /* --- Transaction unit tests --- */
 static int test_txn_insert_after_commit(void) {
     struct list_head lst;
@@ -267,6 +325,1329 @@ static int test_txn_remove_inserted_after(void) {
     return 0;
 }
 
+static int test_txn_cache_reuse(void) {
+    struct list_head lst;
+    LL_INIT(&lst);
+    struct item e[10];
+    ll_txn_t *t1 = LL_TXN_START(&lst, struct item, link);
+    ASSERT(t1);
+    e[0].value = 0;
+    LL_TXN_INSERT_TAIL(t1, &e[0], link);
+    ASSERT_EQ(ll_txn_commit(t1), 0);
+    /* The finished txn is recycled; a large write set spills past the inline buffers. */
+    ll_txn_t *t2 = LL_TXN_START(&lst, struct item, link);
+    ASSERT(t2 == t1);
+    for (int i = 1; i < 10; i++) {
+        e[i].value = i;
+        LL_TXN_INSERT_TAIL(t2, &e[i], link);
+    }
+    LL_TXN_REMOVE(t2, &e[0], link);
+    ASSERT_EQ(ll_txn_commit(t2), 0);
+    ASSERT_EQ(LL_SIZE(&lst, struct item, link), 9);
+    int expect = 1;
+    struct item *var;
+    LL_FOREACH(var, &lst, struct item, link)
+        ASSERT_EQ(var->value, expect++);
+    ll_txn_t *t3 = LL_TXN_START(&lst, struct item, link);
+    ASSERT(t3 == t1);
+    ASSERT(!LL_TXN_CONTAINS(t3, &e[0], link));
+    ll_txn_rollback(t3);
+    while (LL_REMOVE_HEAD(&lst, struct item, link))
+        ;
+    return 0;
+}
+
+static int test_txn_group_commit(void) {
+    struct list_head lst;
+    LL_INIT(&lst);
+    LL_SET_GROUP_COMMIT(&lst, 1);
+    struct item e[6];
+    for (int i = 0; i < 6; i++)
+        e[i].value = i;
+    LL_INSERT_TAIL(&lst, &e[0], link);
+    LL_INSERT_TAIL(&lst, &e[1], link);
+    uint64_t before = atomic_load(&lst.commit_id);
+    ll_txn_t *txn = LL_TXN_START(&lst, struct item, link);
+    ASSERT(txn);
+    LL_TXN_INSERT_HEAD(txn, &e[2], link);
+    LL_TXN_INSERT_HEAD(txn, &e[3], link);
+    LL_TXN_INSERT_AFTER(txn, &e[0], &e[4], link);
+    LL_TXN_INSERT_TAIL(txn, &e[5], link);
+    LL_TXN_REMOVE(txn, &e[1], link);
+    /* The committed order is the transaction view's order. */
+    int view[6], n = 0, expect[] = { 3, 2, 0, 4, 5 };
+    struct item *var;
+    LL_TXN_FOREACH_ITER(var, txn, struct item)
+        view[n++] = var->value;
+    ASSERT_EQ(n, 5);
+    ASSERT_EQ(ll_txn_commit(txn), 0);
+    ASSERT_EQ(atomic_load(&lst.commit_id), before + 1);
+    n = 0;
+    LL_FOREACH(var, &lst, struct item, link) {
+        ASSERT_EQ(var->value, view[n]);
+        ASSERT_EQ(var->value, expect[n]);
+        n++;
+    }
+    ASSERT_EQ(n, 5);
+    while (LL_REMOVE_HEAD(&lst, struct item, link))
+        ;
+    return 0;
+}
+
+static int reclaim_freed;
+static void reclaim_free_cb(struct item *e) { e->value = -1; reclaim_freed++; }
+
+static int test_reclaim_budget(void) {
+    struct list_head lst;
+    LL_INIT(&lst);
+    LL_SET_RECLAIM_BUDGET(&lst, 8);
+    lst.free_cb = reclaim_free_cb;
+    reclaim_freed = 0;
+    static struct item e[256];
+    for (int i = 0; i < 256; i++) {
+        e[i].value = i;
+        LL_INSERT_TAIL(&lst, &e[i], link);
+    }
+    /* A removal deep in the list is not found by one commit's bounded walk... */
+    ll_txn_t *txn = LL_TXN_START(&lst, struct item, link);
+    LL_TXN_REMOVE(txn, &e[200], link);
+    ASSERT_EQ(ll_txn_commit(txn), 0);
+    ASSERT_EQ(reclaim_freed, 0);
+    /* ...but later commits carry on from where it stopped. */
+    for (int i = 0; i < 40; i++) {
+        txn = LL_TXN_START(&lst, struct item, link);
+        LL_TXN_REMOVE(txn, &e[i], link);
+        ASSERT_EQ(ll_txn_commit(txn), 0);
+    }
+    ASSERT_EQ(e[200].value, -1);
+    ASSERT_EQ(LL_SIZE(&lst, struct item, link), 215);
+    lst.free_cb = NULL;
+    while (LL_REMOVE_HEAD(&lst, struct item, link))
+        ;
+    return 0;
+}
+
+static int test_garbage_limit(void) {
+    struct list_head lst;
+    LL_INIT(&lst);
+    LL_SET_GARBAGE_LIMIT(&lst, 10, 0);
+    static struct item e[64];
+    for (int i = 0; i < 64; i++) {
+        e[i].value = i;
+        LL_INSERT_TAIL(&lst, &e[i], link);
+    }
+    /* An open snapshot pins everything removed after it: reclaim is forced but frees nothing. */
+    ll_txn_t *reader = LL_TXN_START(&lst, struct item, link);
+    for (int i = 0; i < 32; i++)
+        ASSERT_EQ(LL_REMOVE(&lst, &e[i], link), 0);
+    ll_garbage_stats_t st;
+    LL_GARBAGE_STATS(&lst, &st);
+    ASSERT_EQ(st.garbage, 32);
+    ASSERT_EQ(st.peak, 32);
+    ASSERT_EQ(st.forced, 22);
+    ASSERT_EQ(st.throttled, 0);
+    /* With a wait allowed, the remover is held back for it. */
+    LL_SET_GARBAGE_LIMIT(&lst, 10, 500);
+    ASSERT_EQ(LL_REMOVE(&lst, &e[32], link), 0);
+    LL_GARBAGE_STATS(&lst, &st);
+    ASSERT_EQ(st.throttled, 1);
+    /* Once the reader is gone, the next removal over the limit frees it all. */
+    ll_txn_rollback(reader);
+    ASSERT_EQ(LL_REMOVE(&lst, &e[33], link), 0);
+    LL_GARBAGE_STATS(&lst, &st);
+    ASSERT_EQ(st.garbage, 0);
+    ASSERT_EQ(st.peak, 34);
+    ASSERT_EQ(LL_SIZE(&lst, struct item, link), 30);
+    while (LL_REMOVE_HEAD(&lst, struct item, link))
+        ;
+    return 0;
+}
+
+static int test_snapshot_lease(void) {
+    struct list_head lst;
+    LL_INIT(&lst);
+    LL_SET_SNAPSHOT_LEASE(&lst, 2000);
+    static struct item e[16];
+    for (int i = 0; i < 16; i++) {
+        e[i].value = i;
+        LL_INSERT_TAIL(&lst, &e[i], link);
+    }
+    ll_txn_t *stale = LL_TXN_START(&lst, struct item, link);
+    LL_TXN_REMOVE(stale, &e[0], link);
+    ASSERT_EQ(ll_txn_status(stale), 0);
+    for (int i = 1; i < 5; i++)
+        LL_REMOVE(&lst, &e[i], link);
+    ll_garbage_stats_t st;
+    LL_GARBAGE_STATS(&lst, &st);
+    ASSERT_EQ(st.garbage, 4);
+    struct timespec ts = { 0, 5000000 };
+    nanosleep(&ts, NULL);
+    /* The forgotten snapshot no longer holds anything back. */
+    ASSERT_EQ(ll_txn_status(stale), LL_TXN_EXPIRED);
+    ASSERT(!LL_TXN_CONTAINS(stale, &e[8], link));
+    ll_txn_t *t = LL_TXN_START(&lst, struct item, link);
+    LL_TXN_REMOVE(t, &e[5], link);
+    ASSERT_EQ(ll_txn_commit(t), 0);
+    LL_GARBAGE_STATS(&lst, &st);
+    ASSERT_EQ(st.garbage, 0);
+    ASSERT_EQ(ll_txn_commit(stale), LL_TXN_EXPIRED);
+    ASSERT(LL_CONTAINS(&lst, &e[0], link));
+    ASSERT_EQ(LL_SIZE(&lst, struct item, link), 11);
+    while (LL_REMOVE_HEAD(&lst, struct item, link))
+        ;
+    return 0;
+}
+
+/* Remove 8 elements of lst, the last through a commit so reclaim runs; returns the garbage left. */
+static size_t remove_and_reclaim(struct list_head *lst, struct item *e) {
+    for (int i = 0; i < 8; i++) {
+        e[i].value = i;
+        LL_INSERT_TAIL(lst, &e[i], link);
+    }
+    for (int i = 0; i < 7; i++)
+        LL_REMOVE(lst, &e[i], link);
+    ll_txn_t *t = LL_TXN_START(lst, struct item, link);
+    LL_TXN_REMOVE(t, &e[7], link);
+    ll_txn_commit(t);
+    ll_garbage_stats_t st;
+    LL_GARBAGE_STATS(lst, &st);
+    return st.garbage;
+}
+
+static int test_reclaim_domain(void) {
+    struct list_head a, shared, own;
+    static struct item ea[1], es[8], eo[8];
+    LL_INIT(&a);
+    LL_INIT(&shared);
+    LL_INIT(&own);
+    ll_domain_t *dom = ll_domain_create();
+    ASSERT(dom != NULL);
+    LL_SET_DOMAIN(&own, dom);
+    LL_INSERT_TAIL(&a, &ea[0], link);
+    /* A snapshot open on a holds back lists in its domain only. */
+    ll_txn_t *reader = LL_TXN_START(&a, struct item, link);
+    ASSERT_EQ(remove_and_reclaim(&shared, es), 8);
+    ASSERT_EQ(remove_and_reclaim(&own, eo), 0);
+    ll_txn_rollback(reader);
+    ll_txn_t *t = LL_TXN_START(&shared, struct item, link);
+    ll_txn_commit(t);
+    ll_garbage_stats_t st;
+    LL_GARBAGE_STATS(&shared, &st);
+    ASSERT_EQ(st.garbage, 0);
+    ASSERT(LL_IS_EMPTY(&own));
+    LL_REMOVE_HEAD(&a, struct item, link);
+    ll_domain_destroy(dom);
+    return 0;
+}
+
+static int test_hazard_eras(void) {
+    struct list_head lst;
+    LL_INIT(&lst);
+    static struct item old, e[10];
+    LL_INSERT_TAIL(&lst, &old, link);
+    ll_txn_t *reader = LL_TXN_START(&lst, struct item, link);
+    for (int i = 0; i < 10; i++)
+        LL_INSERT_TAIL(&lst, &e[i], link);
+    /* The first insert takes the reader's snapshot id, so the reader sees it. */
+    ASSERT(LL_TXN_CONTAINS(reader, &e[0], link));
+    ASSERT(!LL_TXN_CONTAINS(reader, &e[1], link));
+    /* The reader's era pins only what its snapshot can see. */
+    ll_garbage_stats_t st;
+    ASSERT(LL_REMOVE_HEAD(&lst, struct item, link) == &old);
+    LL_GARBAGE_STATS(&lst, &st);
+    ASSERT_EQ(st.garbage, 1);
+    for (int i = 0; i < 10; i++)
+        ASSERT(LL_REMOVE_HEAD(&lst, struct item, link) == &e[i]);
+    LL_GARBAGE_STATS(&lst, &st);
+    ASSERT_EQ(st.garbage, 2);
+    ll_txn_rollback(reader);
+    ll_txn_commit(LL_TXN_START(&lst, struct item, link));
+    LL_GARBAGE_STATS(&lst, &st);
+    ASSERT_EQ(st.garbage, 0);
+    ASSERT(LL_IS_EMPTY(&lst));
+    return 0;
+}
+
+static int test_tagged_head_pop(void) {
+    struct list_head lst;
+    LL_INIT(&lst);
+#if defined(__x86_64__)
+    /* head and commit_id form the 16-byte word remove_head swaps in one CAS. */
+    ASSERT_EQ((uintptr_t)&lst.head % 16, 0);
+    ASSERT((char *)&lst.commit_id == (char *)&lst.head + sizeof(lst.head));
+#endif
+    static struct item e[3];
+    for (int i = 0; i < 3; i++)
+        LL_INSERT_TAIL(&lst, &e[i], link);
+    uint64_t c = atomic_load(&lst.commit_id);
+    ASSERT(LL_REMOVE_HEAD(&lst, struct item, link) == &e[0]);
+    ASSERT_EQ(atomic_load(&lst.commit_id), c + 1);
+    /* A head removed but still linked (a reader pins it) is skipped. */
+    ll_txn_t *reader = LL_TXN_START(&lst, struct item, link);
+    ASSERT_EQ(LL_REMOVE(&lst, &e[1], link), 0);
+    ASSERT(LL_REMOVE_HEAD(&lst, struct item, link) == &e[2]);
+    ASSERT(LL_REMOVE_HEAD(&lst, struct item, link) == NULL);
+    ll_txn_rollback(reader);
+    ll_txn_commit(LL_TXN_START(&lst, struct item, link));
+    ll_garbage_stats_t st;
+    LL_GARBAGE_STATS(&lst, &st);
+    ASSERT_EQ(st.garbage, 0);
+    ASSERT(LL_IS_EMPTY(&lst));
+    return 0;
+}
+
+static int item_order(const struct item *a, const struct item *b) {
+    return (a->value > b->value) - (a->value < b->value);
+}
+
+static int test_threading_modes(void) {
+    static const int modes[] = { LL_SINGLE_WRITER, LL_SINGLE_THREADED };
+    for (int m = 0; m < 2; m++) {
+        struct list_head lst;
+        LL_INIT(&lst);
+        LL_SET_THREADING(&lst, modes[m]);
+        static struct item e[5] = { { 0, 0 }, { 1, 0 }, { 2, 0 }, { 3, 0 }, { 4, 0 } };
+        LL_INSERT_TAIL(&lst, &e[1], link);
+        LL_INSERT_HEAD(&lst, &e[0], link);
+        LL_INSERT_TAIL(&lst, &e[3], link);
+        LL_INSERT_AFTER(&lst, &e[1], &e[2], link);
+        ASSERT_EQ(atomic_load(&lst.commit_id), 5);
+        int v = 0;
+        struct item *var;
+        LL_FOREACH(var, &lst, struct item, link) {
+            ASSERT_EQ(var->value, v);
+            v++;
+        }
+        ASSERT_EQ(v, 4);
+        /* Snapshots still see what the writer removes after them. */
+        ll_txn_t *reader = LL_TXN_START(&lst, struct item, link);
+        LL_INSERT_TAIL(&lst, &e[4], link);
+        ASSERT_EQ(LL_REMOVE(&lst, &e[2], link), 0);
+        ASSERT_EQ(LL_REMOVE(&lst, &e[2], link), -1);
+        ASSERT(!LL_CONTAINS(&lst, &e[2], link));
+        ASSERT(LL_TXN_CONTAINS(reader, &e[2], link));
+        ASSERT(LL_REMOVE_HEAD(&lst, struct item, link) == &e[0]);
+        ASSERT(LL_REMOVE_HEAD(&lst, struct item, link) == &e[1]);
+        ASSERT(LL_REMOVE_HEAD(&lst, struct item, link) == &e[3]);
+        ASSERT(LL_REMOVE_HEAD(&lst, struct item, link) == &e[4]);
+        ASSERT(LL_REMOVE_HEAD(&lst, struct item, link) == NULL);
+        ll_txn_rollback(reader);
+        ll_txn_commit(LL_TXN_START(&lst, struct item, link));
+        ll_garbage_stats_t st;
+        LL_GARBAGE_STATS(&lst, &st);
+        ASSERT_EQ(st.garbage, 0);
+        ASSERT(LL_IS_EMPTY(&lst));
+        /* Ordered lists follow the mode too; with one remover delete-min stays strict. */
+        struct list_head pq;
+        LL_INIT(&pq);
+        LL_SET_THREADING(&pq, modes[m]);
+        LL_SET_ORDER(&pq, item_order);
+        LL_SET_RELAXED_MIN(&pq, 8);
+        static const int order[] = { 3, 0, 4, 1, 2 };
+        for (int i = 0; i < 5; i++)
+            LL_INSERT_ORDERED(&pq, &e[order[i]], link);
+        ASSERT_EQ(atomic_load(&pq.commit_id), 6);
+        for (int i = 0; i < 5; i++)
+            ASSERT(LL_REMOVE_MIN(&pq, struct item, link) == &e[i]);
+        ASSERT(LL_REMOVE_MIN(&pq, struct item, link) == NULL);
+        ll_txn_commit(LL_TXN_START(&pq, struct item, link));
+        LL_GARBAGE_STATS(&pq, &st);
+        ASSERT_EQ(st.garbage, 0);
+    }
+    return 0;
+}
+
+static void par_count_cb(void *elm, void *userdata) {
+    _Atomic int *seen = userdata;
+    atomic_fetch_add(&seen[((struct item *)elm)->value], 1);
+}
+
+static int test_parallel_callbacks(void) {
+    enum { N = 5000 };
+    static struct item e[N];
+    static _Atomic int seen[N];
+    struct list_head lst;
+    LL_INIT(&lst);
+    for (int i = 0; i < N; i++) {
+        e[i].value = i;
+        LL_INSERT_TAIL(&lst, &e[i], link);
+    }
+    for (int i = 0; i < N; i += 7)
+        ASSERT_EQ(LL_REMOVE(&lst, &e[i], link), 0);
+    for (int threads = 1; threads <= 8; threads *= 2) {
+        for (int i = 0; i < N; i++)
+            atomic_store(&seen[i], 0);
+        ASSERT_EQ(LL_PARALLEL_CALLBACKS(&lst, threads, par_count_cb, seen), N - (N + 6) / 7);
+        for (int i = 0; i < N; i++)
+            ASSERT_EQ(atomic_load(&seen[i]), i % 7 != 0);
+    }
+    while (LL_REMOVE_HEAD(&lst, struct item, link))
+        ;
+    ASSERT_EQ(LL_PARALLEL_CALLBACKS(&lst, 4, par_count_cb, seen), 0);
+    ll_txn_commit(LL_TXN_START(&lst, struct item, link));
+    return 0;
+}
+
+struct item_stats { long n, sum; int min, max; };
+
+static void stats_identity(void *acc, void *userdata) {
+    (void)userdata;
+    *(struct item_stats *)acc = (struct item_stats){ 0, 0, INT_MAX, INT_MIN };
+}
+
+static void stats_map(void *acc, const void *elm, void *userdata) {
+    struct item_stats *st = acc;
+    int v = ((const struct item *)elm)->value;
+    (void)userdata;
+    st->n++;
+    st->sum += v;
+    if (v < st->min)
+        st->min = v;
+    if (v > st->max)
+        st->max = v;
+}
+
+static void stats_combine(void *acc, const void *other, void *userdata) {
+    struct item_stats *st = acc;
+    const struct item_stats *o = other;
+    (void)userdata;
+    st->n += o->n;
+    st->sum += o->sum;
+    if (o->min < st->min)
+        st->min = o->min;
+    if (o->max > st->max)
+        st->max = o->max;
+}
+
+static const ll_reduce_ops_t stats_ops = {
+    sizeof(struct item_stats), stats_identity, stats_map, stats_combine
+};
+
+static int test_snapshot_reduce(void) {
+    enum { N = 5000 };
+    static struct item e[N];
+    struct list_head lst;
+    LL_INIT(&lst);
+    struct item_stats st;
+    ASSERT_EQ(LL_SNAPSHOT_REDUCE(&lst, 4, &stats_ops, &st, NULL), 0);
+    ASSERT_EQ(st.n, 0);
+    ASSERT_EQ(st.min, INT_MAX);
+    for (int i = 0; i < N; i++) {
+        e[i].value = i;
+        LL_INSERT_TAIL(&lst, &e[i], link);
+    }
+    /* Drop the first and last ten and every fifth: min 11, max N - 11. */
+    long sum = 0, n = 0;
+    for (int i = 0; i < N; i++) {
+        if (i < 10 || i >= N - 10 || i % 5 == 0)
+            ASSERT_EQ(LL_REMOVE(&lst, &e[i], link), 0);
+        else
+            sum += i, n++;
+    }
+    for (int threads = 1; threads <= 8; threads *= 2) {
+        ASSERT_EQ(LL_SNAPSHOT_REDUCE(&lst, threads, &stats_ops, &st, NULL), 0);
+        ASSERT_EQ(st.n, n);
+        ASSERT_EQ(st.sum, sum);
+        ASSERT_EQ(st.min, 11);
+        ASSERT_EQ(st.max, N - 11);
+    }
+    while (LL_REMOVE_HEAD(&lst, struct item, link))
+        ;
+    ll_txn_commit(LL_TXN_START(&lst, struct item, link));
+    return 0;
+}
+
+static _Atomic int reduce_misaligned;
+
+static void aligned_identity(void *acc, void *userdata) {
+    (void)userdata;
+    if ((uintptr_t)acc % 64)
+        atomic_store(&reduce_misaligned, 1);
+    *(long *)acc = 0;
+}
+
+static void count_map(void *acc, const void *elm, void *userdata) {
+    (void)elm;
+    (void)userdata;
+    ++*(long *)acc;
+}
+
+static void count_combine(void *acc, const void *other, void *userdata) {
+    (void)userdata;
+    *(long *)acc += *(const long *)other;
+}
+
+/* With more than one thread, every accumulator starts a cache line of its own. */
+static int test_reduce_alignment(void) {
+    static const ll_reduce_ops_t ops = { sizeof(long), aligned_identity, count_map, count_combine };
+    static struct item e[100];
+    struct list_head lst;
+    LL_INIT(&lst);
+    for (int i = 0; i < 100; i++)
+        LL_INSERT_TAIL(&lst, &e[i], link);
+    atomic_store(&reduce_misaligned, 0);
+    for (int threads = 2; threads <= 8; threads *= 2) {
+        long n;
+        ASSERT_EQ(LL_SNAPSHOT_REDUCE(&lst, threads, &ops, &n, NULL), 0);
+        ASSERT_EQ(n, 100);
+    }
+    ASSERT(!atomic_load(&reduce_misaligned));
+    while (LL_REMOVE_HEAD(&lst, struct item, link))
+        ;
+    return 0;
+}
+
+/* Bump allocator over a static buffer: frees nothing, like a per-request arena. */
+static char bump_buf[1 << 16];
+static size_t bump_used;
+
+static void *bump_alloc(size_t size, size_t align, void *ctx) {
+    (void)ctx;
+    size_t at = (bump_used + align - 1) & ~(align - 1);
+    if (at + size > sizeof(bump_buf))
+        return NULL;
+    bump_used = at + size;
+    return bump_buf + at;
+}
+
+static int test_snapshot_to_array(void) {
+    enum { N = 1000 };
+    static struct item e[N];
+    struct list_head lst;
+    LL_INIT(&lst);
+    struct item **arr;
+    size_t n;
+    ASSERT_EQ(LL_SNAPSHOT_TO_ARRAY(&lst, 0, &arr, &n), 0);
+    ASSERT(arr == NULL);
+    ASSERT_EQ(n, 0);
+    for (int i = 0; i < N; i++) {
+        e[i].value = i;
+        LL_INSERT_TAIL(&lst, &e[i], link);
+    }
+    for (int i = 0; i < N; i += 3)
+        ASSERT_EQ(LL_REMOVE(&lst, &e[i], link), 0);
+    ASSERT_EQ(LL_SNAPSHOT_TO_ARRAY(&lst, 0, &arr, &n), 0);
+    ASSERT_EQ(n, N - (N + 2) / 3);
+    for (size_t i = 0; i < n; i++)
+        ASSERT(arr[i] == &e[i / 2 * 3 + 1 + i % 2]);
+    free(arr);
+
+    /*
+     * At an open transaction's snapshot, later changes don't show, except
+     * that the first insert takes the snapshot's id and so is seen.
+     */
+    ll_txn_t *txn = LL_TXN_START(&lst, struct item, link);
+    ASSERT(txn);
+    LL_INSERT_HEAD(&lst, &e[0], link);
+    for (int i = 1; i < N; i += 3)
+        ASSERT_EQ(LL_REMOVE(&lst, &e[i], link), 0);
+    ASSERT_EQ(LL_SNAPSHOT_TO_ARRAY(&lst, ll_txn_snapshot(txn), &arr, &n), 0);
+    ll_txn_rollback(txn);
+    ASSERT_EQ(n, 1 + N - (N + 2) / 3);
+    ASSERT(arr[0] == &e[0] && arr[1] == &e[1] && arr[2] == &e[2]);
+    free(arr);
+
+    ll_allocator_t arena = { bump_alloc, NULL, NULL };
+    bump_used = 0;
+    ASSERT_EQ(LL_SNAPSHOT_TO_ARRAY_ARENA(&lst, 0, &arr, &n, &arena), 0);
+    ASSERT_EQ(n, 1 + N / 3);
+    ASSERT((char *)arr >= bump_buf && (char *)arr < bump_buf + sizeof(bump_buf));
+    ASSERT(arr[0] == &e[0] && arr[1] == &e[2] && arr[n - 1] == &e[N - 2]);
+    while (LL_REMOVE_HEAD(&lst, struct item, link))
+        ;
+    ll_txn_commit(LL_TXN_START(&lst, struct item, link));
+    return 0;
+}
+
+static int test_wsdeque(void) {
+    enum { N = 200 };   /* past the initial ring, so it grows */
+    static struct item e[N];
+    ll_wsdeque_t dq;
+    ASSERT_EQ(LL_WSDEQUE_INIT(&dq), 0);
+    ASSERT(LL_WSDEQUE_POP(&dq, struct item) == NULL);
+    ASSERT(LL_WSDEQUE_STEAL(&dq, struct item) == NULL);
+    for (int i = 0; i < N; i++) {
+        e[i].value = i;
+        ASSERT_EQ(LL_WSDEQUE_PUSH(&dq, &e[i]), 0);
+    }
+    ASSERT_EQ(LL_WSDEQUE_SIZE(&dq), N);
+    /* Owner pops newest first, thieves take oldest first. */
+    ASSERT(LL_WSDEQUE_POP(&dq, struct item) == &e[N - 1]);
+    ASSERT(LL_WSDEQUE_STEAL(&dq, struct item) == &e[0]);
+    struct item *buf[N];
+    size_t n = LL_WSDEQUE_STEAL_HALF(&dq, buf, N);
+    ASSERT_EQ(n, (N - 2) / 2);
+    for (size_t i = 0; i < n; i++)
+        ASSERT(buf[i] == &e[1 + i]);
+    ASSERT_EQ(LL_WSDEQUE_STEAL_HALF(&dq, buf, 3), 3);
+    ASSERT(buf[2] == &e[n + 3]);
+    for (int i = N - 2; i >= (int)n + 4; i--)
+        ASSERT(LL_WSDEQUE_POP(&dq, struct item) == &e[i]);
+    ASSERT_EQ(LL_WSDEQUE_SIZE(&dq), 0);
+    ASSERT(LL_WSDEQUE_POP(&dq, struct item) == NULL);
+    ASSERT_EQ(LL_WSDEQUE_STEAL_HALF(&dq, buf, N), 0);
+    /* Wrapping around the ring after the top has moved. */
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < N; i++)
+            ASSERT_EQ(LL_WSDEQUE_PUSH(&dq, &e[i]), 0);
+        for (int i = 0; i < N; i++)
+            ASSERT(LL_WSDEQUE_STEAL(&dq, struct item) == &e[i]);
+    }
+    LL_WSDEQUE_DESTROY(&dq);
+    return 0;
+}
+
+static int test_priority_queue(void) {
+    struct list_head pq;
+    LL_INIT(&pq);
+    LL_SET_ORDER(&pq, item_order);
+    static struct item e[64];
+    for (int i = 0; i < 64; i++) {
+        e[i].value = (i * 37) % 64 / 2;   /* each key twice, shuffled */
+        LL_INSERT_ORDERED(&pq, &e[i], link);
+    }
+    int last = -1;
+    struct item *var;
+    LL_FOREACH(var, &pq, struct item, link) {
+        ASSERT(var->value >= last);
+        last = var->value;
+    }
+    /* Equal keys come out in insertion order. */
+    struct item *prev = NULL;
+    for (int i = 0; i < 64; i++) {
+        struct item *p = LL_REMOVE_MIN(&pq, struct item, link);
+        ASSERT(p);
+        ASSERT_EQ(p->value, i / 2);
+        if (i & 1)
+            ASSERT(p > prev);
+        prev = p;
+    }
+    ASSERT(LL_REMOVE_MIN(&pq, struct item, link) == NULL);
+
+    /* Relaxed: every element exactly once, each among the first "width". */
+    enum { WIDTH = 4 };
+    LL_SET_RELAXED_MIN(&pq, WIDTH);
+    for (int i = 0; i < 64; i++) {
+        e[i].value = (i * 37) % 64;
+        LL_INSERT_ORDERED(&pq, &e[i], link);
+    }
+    unsigned char out[64] = { 0 };
+    for (int i = 0; i < 64; i++) {
+        struct item *p = LL_REMOVE_MIN(&pq, struct item, link);
+        ASSERT(p);
+        ASSERT(!out[p->value]);
+        out[p->value] = 1;
+        int below = 0;
+        for (int k = 0; k < p->value; k++)
+            below += !out[k];
+        ASSERT(below < WIDTH);
+    }
+    ASSERT(LL_REMOVE_MIN(&pq, struct item, link) == NULL);
+    ll_txn_commit(LL_TXN_START(&pq, struct item, link));
+    return 0;
+}
+
+struct view_log { int vals[512]; int n; };
+
+static void view_log_cb(void *elm, void *userdata) {
+    struct view_log *v = userdata;
+    if (v->n < 512)
+        v->vals[v->n++] = ((struct item *)elm)->value;
+}
+
+static int test_txn_foreach_large_write_set(void) {
+    struct list_head lst;
+    LL_INIT(&lst);
+    struct item base[100], extra[100];
+    for (int i = 0; i < 100; i++) {
+        base[i].value = i;
+        LL_INSERT_TAIL(&lst, &base[i], link);
+    }
+    ll_txn_t *txn = LL_TXN_START(&lst, struct item, link);
+    ASSERT(txn);
+    /* Drop odd elements; after each multiple of 10 insert two, the first later withdrawn. */
+    for (int i = 1; i < 100; i += 2)
+        LL_TXN_REMOVE(txn, &base[i], link);
+    for (int i = 0; i < 100; i += 10) {
+        extra[i].value = 1000 + i;
+        extra[i + 1].value = 2000 + i;
+        LL_TXN_INSERT_AFTER(txn, &base[i], &extra[i], link);
+        LL_TXN_INSERT_AFTER(txn, &base[i], &extra[i + 1], link);
+    }
+    LL_TXN_REMOVE(txn, &extra[50], link);
+    struct view_log v = { { 0 }, 0 };
+    LL_TXN_FOREACH(txn, view_log_cb, &v);
+    int k = 0;
+    for (int i = 0; i < 100; i += 2) {
+        ASSERT_EQ(v.vals[k++], i);
+        if (i % 10 == 0) {
+            if (i != 50)
+                ASSERT_EQ(v.vals[k++], 1000 + i);
+            ASSERT_EQ(v.vals[k++], 2000 + i);
+        }
+    }
+    ASSERT_EQ(v.n, k);
+    /* Removes only: the insert-after index stays empty. */
+    ll_txn_t *only_rm = LL_TXN_START(&lst, struct item, link);
+    for (int i = 0; i < 10; i++)
+        LL_TXN_REMOVE(only_rm, &base[i], link);
+    struct view_log w = { { 0 }, 0 };
+    LL_TXN_FOREACH(only_rm, view_log_cb, &w);
+    ASSERT_EQ(w.n, 90);
+    ASSERT_EQ(w.vals[0], 10);
+    ll_txn_rollback(only_rm);
+    /* Changes after the view was indexed are seen by the next walk. */
+    LL_TXN_REMOVE(txn, &base[0], link);
+    LL_TXN_INSERT_AFTER(txn, &base[2], &extra[2], link);
+    extra[2].value = 3000;
+    v.n = 0;
+    LL_TXN_FOREACH(txn, view_log_cb, &v);
+    ASSERT_EQ(v.vals[0], 2);
+    ASSERT_EQ(v.vals[1], 3000);
+    ASSERT(!LL_TXN_CONTAINS(txn, &base[0], link));
+    ASSERT_EQ(ll_txn_commit(txn), 0);
+    ASSERT_EQ(LL_SIZE(&lst, struct item, link), (size_t)(v.n));
+    while (LL_REMOVE_HEAD(&lst, struct item, link))
+        ;
+    return 0;
+}
+
+static int test_txn_iter_cursor(void) {
+    struct list_head lst;
+    LL_INIT(&lst);
+    struct item e[8];
+    for (int i = 0; i < 8; i++)
+        e[i].value = i;
+    LL_INSERT_TAIL(&lst, &e[0], link);
+    LL_INSERT_TAIL(&lst, &e[1], link);
+    LL_INSERT_TAIL(&lst, &e[2], link);
+    ll_txn_t *txn = LL_TXN_START(&lst, struct item, link);
+    ASSERT(txn);
+    LL_TXN_INSERT_HEAD(txn, &e[3], link);
+    LL_TXN_INSERT_HEAD(txn, &e[4], link);
+    LL_TXN_INSERT_AFTER(txn, &e[0], &e[5], link);
+    LL_TXN_INSERT_TAIL(txn, &e[6], link);
+    LL_TXN_REMOVE(txn, &e[1], link);
+    /* Same order as LL_TXN_FOREACH: 4 3 | 0 5 2 | 6 */
+    struct view_log v = { { 0 }, 0 };
+    LL_TXN_FOREACH(txn, view_log_cb, &v);
+    ASSERT_EQ(v.n, 6);
+    int k = 0;
+    struct item *var;
+    LL_TXN_FOREACH_ITER(var, txn, struct item)
+        ASSERT_EQ(var->value, v.vals[k++]);
+    ASSERT_EQ(k, 6);
+    /* Early exit. */
+    LL_TXN_FOREACH_ITER(var, txn, struct item)
+        if (var->value == 5)
+            break;
+    ASSERT(var == &e[5]);
+    /* Batches. */
+    ll_txn_iter_t it;
+    void *out[4];
+    ll_txn_iter_begin(&it, txn);
+    ASSERT_EQ(ll_txn_iter_batch(&it, out, 4), 4);
+    ASSERT(out[0] == &e[4] && out[3] == &e[5]);
+    ASSERT(ll_txn_iter_get(&it) == &e[2]);
+    ASSERT_EQ(ll_txn_iter_batch(&it, out, 4), 2);
+    ASSERT(out[1] == &e[6]);
+    ASSERT(ll_txn_iter_get(&it) == NULL);
+    ASSERT_EQ(ll_txn_iter_batch(&it, out, 4), 0);
+    ll_txn_rollback(txn);
+    while (LL_REMOVE_HEAD(&lst, struct item, link))
+        ;
+    return 0;
+}
+
+/* --- Allocator hooks --- */
+struct count_alloc { long allocs, frees; size_t live; };
+
+static void *count_alloc_fn(size_t size, size_t align, void *ctx) {
+    struct count_alloc *c = ctx;
+    void *p = aligned_alloc(align, (size + align - 1) / align * align);
+    if (p) {
+        c->allocs++;
+        c->live += size;
+    }
+    return p;
+}
+
+static void count_free_fn(void *p, size_t size, size_t align, void *ctx) {
+    struct count_alloc *c = ctx;
+    (void)align;
+    c->frees++;
+    c->live -= size;
+    free(p);
+}
+
+static int test_custom_allocator(void) {
+    struct list_head lst;
+    struct count_alloc c = { 0, 0, 0 };
+    LL_INIT(&lst);
+    LL_SET_ALLOCATOR(&lst, count_alloc_fn, count_free_fn, &c);
+    struct item e[4] = { { 0, 0 }, { 1, 0 }, { 2, 0 }, { 3, 0 } };
+    LL_INSERT_TAIL(&lst, &e[0], link);
+    LL_INSERT_HEAD(&lst, &e[1], link);
+    LL_INSERT_AFTER(&lst, &e[0], &e[2], link);
+    ASSERT_EQ(c.allocs, 3);
+    ll_txn_t *txn = LL_TXN_START(&lst, struct item, link);
+    ASSERT(txn);
+    for (int i = 0; i < 20; i++)          /* grows the write set past its first buffer */
+        LL_TXN_INSERT_AFTER(txn, &e[0], &e[3], link), LL_TXN_REMOVE(txn, &e[3], link);
+    LL_TXN_INSERT_AFTER(txn, &e[2], &e[3], link);
+    LL_TXN_REMOVE(txn, &e[1], link);
+    ASSERT_EQ(ll_txn_commit(txn), 0);   /* reclaims e[1]'s wrapper */
+    ASSERT_EQ(LL_SIZE(&lst, struct item, link), 3);
+    /* Parallel scans take their chunks and per-thread accumulators from it too. */
+    long before = c.allocs;
+    size_t live = c.live;
+    struct item_stats st;
+    ASSERT_EQ(LL_SNAPSHOT_REDUCE(&lst, 2, &stats_ops, &st, NULL), 0);
+    ASSERT_EQ(st.n, 3);
+    ASSERT_EQ(c.allocs, before + 2);
+    ASSERT_EQ(c.live, live);
+    while (LL_REMOVE_HEAD(&lst, struct item, link))
+        ;
+    ASSERT(c.allocs > 4);
+    ASSERT_EQ(c.allocs, c.frees);
+    ASSERT_EQ(c.live, 0);
+    return 0;
+}
+
+/* Pop the head on another thread and run a reclaim pass there. */
+static void *thread_pop_reclaim(void *arg) {
+    struct list_head *lst = arg;
+    LL_REMOVE_HEAD(lst, struct item, link);
+    ll_txn_commit(LL_TXN_START(lst, struct item, link));
+    return NULL;
+}
+
+static void pop_reclaim_elsewhere(struct list_head *lst) {
+    pthread_t th;
+    pthread_create(&th, NULL, thread_pop_reclaim, lst);
+    pthread_join(th, NULL);
+}
+
+static size_t garbage_of(struct list_head *lst) {
+    ll_garbage_stats_t st;
+    LL_GARBAGE_STATS(lst, &st);
+    return st.garbage;
+}
+
+/* Leaves LL_FOREACH by return. */
+static struct item *first_at_least(struct list_head *lst, int min) {
+    struct item *var;
+    LL_FOREACH(var, lst, struct item, link) {
+        if (var->value >= min)
+            return var;
+    }
+    return NULL;
+}
+
+static int test_read_pin(void) {
+    struct list_head lst;
+    LL_INIT(&lst);
+    static struct item e[6];
+    for (int i = 0; i < 6; i++) {
+        e[i].value = i;
+        LL_INSERT_TAIL(&lst, &e[i], link);
+    }
+    /* A plain iterator standing on the head keeps its wrapper alive through a pop and a reclaim. */
+    ll_iter_t it;
+    ll_iter_begin(&it, &lst.head, &lst.commit_id, &lst.ctl);
+    ASSERT(ll_iter_get(&it) == &e[0]);
+    pop_reclaim_elsewhere(&lst);
+    ASSERT_EQ(garbage_of(&lst), 1);
+    ll_iter_next(&it);
+    ASSERT(ll_iter_get(&it) == &e[1]);
+    for (int n = 1; ll_iter_has(&it); n++, ll_iter_next(&it))
+        ASSERT(ll_iter_get(&it) == &e[n]);
+    /* Exhausted, it no longer holds anything back. */
+    ll_txn_commit(LL_TXN_START(&lst, struct item, link));
+    ASSERT_EQ(garbage_of(&lst), 0);
+    /* The same for a generated cursor, and for LL_FOREACH left with break. */
+    ll_gcursor_t gc;
+    ASSERT(list_head_LL_FIRST(&lst, &gc) == &e[1]);
+    pop_reclaim_elsewhere(&lst);
+    ASSERT_EQ(garbage_of(&lst), 1);
+    ASSERT(list_head_LL_NEXT(&gc) == &e[2]);
+    list_head_LL_END(&gc);
+    ll_txn_commit(LL_TXN_START(&lst, struct item, link));
+    ASSERT_EQ(garbage_of(&lst), 0);
+    struct item *var;
+    LL_FOREACH(var, &lst, struct item, link) {
+        ASSERT(var == &e[2]);
+        pop_reclaim_elsewhere(&lst);
+        ASSERT_EQ(garbage_of(&lst), 1);
+        break;
+    }
+    ll_txn_commit(LL_TXN_START(&lst, struct item, link));
+    ASSERT_EQ(garbage_of(&lst), 0);
+#if defined(__GNUC__) || defined(__clang__)
+    /* Left by return or goto, the loops drop their pins as well. */
+    ASSERT(first_at_least(&lst, 4) == &e[4]);
+    pop_reclaim_elsewhere(&lst);
+    ASSERT_EQ(garbage_of(&lst), 0);
+    LL_GFOREACH(var, list_head, &lst) {
+        if (var->value == 5)
+            goto found;
+    }
+    ASSERT(0);
+found:
+    ASSERT(var == &e[5]);
+    pop_reclaim_elsewhere(&lst);
+    ASSERT_EQ(garbage_of(&lst), 0);
+    ASSERT_EQ(LL_SIZE(&lst, struct item, link), 1);
+#else
+    ASSERT_EQ(LL_SIZE(&lst, struct item, link), 3);
+#endif
+    while (LL_REMOVE_HEAD(&lst, struct item, link))
+        ;
+    return 0;
+}
+
+struct pop_job {
+    struct list_head *lst;
+    int n;
+};
+
+static void *thread_pop_n(void *arg) {
+    struct pop_job *job = arg;
+    for (int i = 0; i < job->n; i++)
+        LL_REMOVE_HEAD(job->lst, struct item, link);
+    return NULL;
+}
+
+static int test_pop_vs_reader(void) {
+    struct list_head lst;
+    LL_INIT(&lst);
+    static struct item e[200];
+    for (int i = 0; i < 200; i++) {
+        e[i].value = i;
+        LL_INSERT_TAIL(&lst, &e[i], link);
+    }
+    /* No reader anywhere: a pop frees its wrapper at once. */
+    ASSERT(LL_REMOVE_HEAD(&lst, struct item, link) == &e[0]);
+    ASSERT_EQ(garbage_of(&lst), 0);
+    /*
+     * A plain reader stands on e[1] while another thread pops past it. The
+     * pops must leave every wrapper they take to reclaim, and the reader
+     * must walk on through them unharmed.
+     */
+    ll_iter_t it;
+    ll_iter_begin(&it, &lst.head, &lst.commit_id, &lst.ctl);
+    ASSERT(ll_iter_get(&it) == &e[1]);
+    struct pop_job job = {&lst, 100};
+    pthread_t th;
+    pthread_create(&th, NULL, thread_pop_n, &job);
+    pthread_join(th, NULL);
+    ASSERT_EQ(garbage_of(&lst), 100);
+    for (int n = 1; n < 150; n++, ll_iter_next(&it))
+        ASSERT(ll_iter_get(&it) == &e[n]);
+    ll_iter_end(&it);
+    /* Reader gone: pops free their own wrappers and drain the backlog, one generation each. */
+    ASSERT(LL_REMOVE_HEAD(&lst, struct item, link) == &e[101]);
+    ASSERT(garbage_of(&lst) < 100);
+    ASSERT(LL_REMOVE_HEAD(&lst, struct item, link) == &e[102]);
+    ASSERT_EQ(garbage_of(&lst), 0);
+    ASSERT_EQ(LL_SIZE(&lst, struct item, link), 97);
+    while (LL_REMOVE_HEAD(&lst, struct item, link))
+        ;
+    return 0;
+}
+
+enum { SLOT_FILLERS = 40 };
+static _Atomic int slot_fillers_up, slot_fillers_go;
+
+/* Take a slot (if any is left) with a read, then keep it until told to go. */
+static void *thread_slot_filler(void *arg) {
+    struct list_head *lst = arg;
+    (void)LL_SIZE(lst, struct item, link);
+    atomic_fetch_add(&slot_fillers_up, 1);
+    while (!atomic_load(&slot_fillers_go))
+        sched_yield();
+    return NULL;
+}
+
+static _Atomic int overflow_on_head, overflow_walk_on;
+
+/* A reader that finds every slot taken: stands on the head until the pop is done. */
+static void *thread_overflow_reader(void *arg) {
+    struct list_head *lst = arg;
+    ll_iter_t it;
+    ll_iter_begin(&it, &lst->head, &lst->commit_id, &lst->ctl);
+    int n = 0;
+    atomic_store(&overflow_on_head, 1);
+    while (!atomic_load(&overflow_walk_on))
+        sched_yield();
+    for (; ll_iter_has(&it); ll_iter_next(&it))
+        n += ((struct item *)ll_iter_get(&it))->value == n;
+    return (void *)(intptr_t)n;
+}
+
+static void *thread_qsbr_online(void *arg) {
+    (void)arg;
+    intptr_t rc = ll_qsbr_online();
+    if (rc == 0)
+        ll_qsbr_offline();
+    return (void *)rc;
+}
+
+/*
+ * More threads than there are slots: the ones left over must still hold
+ * reclaim back while they read.
+ */
+static int test_slot_overflow_reader(void) {
+    struct list_head lst;
+    LL_INIT(&lst);
+    static struct item e[4];
+    for (int i = 0; i < 4; i++) {
+        e[i].value = i;
+        LL_INSERT_TAIL(&lst, &e[i], link);
+    }
+    atomic_store(&slot_fillers_up, 0);
+    atomic_store(&slot_fillers_go, 0);
+    atomic_store(&overflow_on_head, 0);
+    atomic_store(&overflow_walk_on, 0);
+    pthread_t fill[SLOT_FILLERS], reader;
+    for (int i = 0; i < SLOT_FILLERS; i++)
+        pthread_create(&fill[i], NULL, thread_slot_filler, &lst);
+    while (atomic_load(&slot_fillers_up) < SLOT_FILLERS)
+        sched_yield();
+    /* No slot left: a QSBR reader cannot go online. */
+    pthread_t q;
+    void *online;
+    pthread_create(&q, NULL, thread_qsbr_online, NULL);
+    pthread_join(q, &online);
+    ASSERT_EQ((intptr_t)online, -1);
+    pthread_create(&reader, NULL, thread_overflow_reader, &lst);
+    while (!atomic_load(&overflow_on_head))
+        sched_yield();
+    ASSERT(LL_REMOVE_HEAD(&lst, struct item, link) == &e[0]);
+    ll_txn_commit(LL_TXN_START(&lst, struct item, link));
+    ASSERT_EQ(garbage_of(&lst), 1);
+    atomic_store(&overflow_walk_on, 1);
+    void *n;
+    pthread_join(reader, &n);
+    ASSERT_EQ((intptr_t)n, 4);
+    atomic_store(&slot_fillers_go, 1);
+    for (int i = 0; i < SLOT_FILLERS; i++)
+        pthread_join(fill[i], NULL);
+    ll_txn_commit(LL_TXN_START(&lst, struct item, link));
+    ASSERT_EQ(garbage_of(&lst), 0);
+    while (LL_REMOVE_HEAD(&lst, struct item, link))
+        ;
+    return 0;
+}
+
+/* --- File-backed arena --- */
+static void arena_path(char *buf, size_t n, const char *tag) {
+    snprintf(buf, n, "/tmp/ll_arena_test_%s_%ld.bin", tag, (long)getpid());
+    unlink(buf);
+}
+
+static void arena_sum_cb(void *elm, void *userdata) {
+    *(long *)userdata += ((struct item *)elm)->value;
+}
+
+static void arena_exit_cb(void *elm, void *userdata) {
+    (void)elm;
+    (void)userdata;
+    _exit(0);
+}
+
+static int test_arena_reopen_clean(void) {
+    char path[128];
+    arena_path(path, sizeof(path), "clean");
+    ll_arena_t *a = ll_arena_open(path, 1 << 20);
+    ASSERT(a);
+    ASSERT(!ll_arena_recovered(a));
+    struct item *first = NULL;
+    for (int i = 1; i <= 10; i++) {
+        struct item *e = LL_ARENA_NEW(a, struct item);
+        ASSERT(e);
+        e->value = i;
+        ASSERT_EQ(LL_ARENA_INSERT_TAIL(a, e), 0);
+        if (!first)
+            first = e;
+    }
+    ll_arena_set_root(a, first);
+    ASSERT_EQ(ll_arena_close(a), 0);
+
+    a = ll_arena_open(path, 0);
+    ASSERT(a);
+    ASSERT(!ll_arena_recovered(a));
+    ASSERT_EQ(ll_arena_size(a), 10);
+    long sum = 0;
+    LL_ARENA_FOREACH(a, arena_sum_cb, &sum);
+    ASSERT_EQ(sum, 55);
+    first = (struct item *)ll_arena_root(a);
+    ASSERT(first && first->value == 1);
+    ASSERT(LL_ARENA_CONTAINS(a, first));
+    struct item *p = LL_ARENA_REMOVE_HEAD(a, struct item);
+    ASSERT(p == first);
+    ll_arena_free(a, p);
+    ll_arena_set_root(a, NULL);
+    ASSERT_EQ(ll_arena_size(a), 9);
+    ASSERT_EQ(ll_arena_close(a), 0);
+    unlink(path);
+    return 0;
+}
+
+static int test_arena_remove_reuses_space(void) {
+    char path[128];
+    arena_path(path, sizeof(path), "reuse");
+    ll_arena_t *a = ll_arena_open(path, 64 * 1024);
+    ASSERT(a);
+    /* Far more insert/remove rounds than fit at once: reclaim must recycle nodes and payloads. */
+    for (int round = 0; round < 2000; round++) {
+        struct item *e = LL_ARENA_NEW(a, struct item);
+        ASSERT(e);
+        e->value = round;
+        ASSERT_EQ(LL_ARENA_INSERT_HEAD(a, e), 0);
+        ASSERT_EQ(LL_ARENA_REMOVE(a, e), 0);
+    }
+    ASSERT_EQ(ll_arena_size(a), 0);
+    ASSERT_EQ(ll_arena_close(a), 0);
+    unlink(path);
+    return 0;
+}
+
+static int test_arena_crash_recovery(void) {
+    char path[128];
+    arena_path(path, sizeof(path), "crash");
+    pid_t pid = fork();
+    ASSERT(pid >= 0);
+    if (pid == 0) {
+        ll_arena_t *a = ll_arena_open(path, 1 << 20);
+        if (!a)
+            _exit(1);
+        for (int i = 0; i < 100; i++) {
+            struct item *e = LL_ARENA_NEW(a, struct item);
+            if (!e)
+                _exit(1);
+            e->value = i;
+            LL_ARENA_INSERT_TAIL(a, e);
+            if (i % 3 == 0)
+                LL_ARENA_REMOVE(a, e);
+        }
+        _exit(0);  /* no ll_arena_close: file is left dirty */
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    ll_arena_t *a = ll_arena_open(path, 0);
+    ASSERT(a);
+    ASSERT(ll_arena_recovered(a));
+    ASSERT_EQ(ll_arena_size(a), 66);
+    struct item *p;
+    while ((p = LL_ARENA_REMOVE_HEAD(a, struct item)) != NULL)
+        ll_arena_free(a, p);
+    ASSERT_EQ(ll_arena_close(a), 0);
+    a = ll_arena_open(path, 0);
+    ASSERT(a && !ll_arena_recovered(a));
+    ASSERT_EQ(ll_arena_size(a), 0);
+    ll_arena_close(a);
+    unlink(path);
+    return 0;
+}
+
+static int test_arena_shm_dead_reader(void) {
+    char name[64];
+    snprintf(name, sizeof(name), "/ll_arena_test_dead_%ld", (long)getpid());
+    ll_arena_shm_unlink(name);
+    ll_arena_t *a = ll_arena_shm_open(name, 1 << 20);
+    ASSERT(a);
+    struct item *e = LL_ARENA_NEW(a, struct item);
+    ASSERT(e);
+    LL_ARENA_INSERT_TAIL(a, e);
+    pid_t pid = fork();
+    ASSERT(pid >= 0);
+    if (pid == 0) {
+        ll_arena_t *c = ll_arena_shm_open(name, 0);
+        if (!c)
+            _exit(1);
+        long sum = 0;
+        LL_ARENA_FOREACH(c, arena_exit_cb, &sum);  /* dies holding its snapshot pin */
+        _exit(1);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    ASSERT_EQ(LL_ARENA_REMOVE(a, e), 0);
+    ASSERT_EQ(ll_arena_reclaim(a), 0);  /* dead pin blocks this pass, and gets reaped */
+    ASSERT_EQ(ll_arena_reclaim(a), 1);
+    ASSERT_EQ(ll_arena_close(a), 0);
+    ll_arena_shm_unlink(name);
+    return 0;
+}
+
+struct arena_hold {
+    ll_arena_t *a;
+    _Atomic int held, release;
+};
+
+static void arena_hold_cb(void *elm, void *userdata) {
+    struct arena_hold *h = userdata;
+    (void)elm;
+    atomic_store(&h->held, 1);
+    while (!atomic_load(&h->release))
+        sched_yield();
+}
+
+/* Hold a snapshot pin on another thread until released. */
+static void *thread_arena_hold(void *arg) {
+    struct arena_hold *h = arg;
+    LL_ARENA_FOREACH(h->a, arena_hold_cb, h);
+    return NULL;
+}
+
+static void arena_hold_start(struct arena_hold *h, pthread_t *th) {
+    pthread_create(th, NULL, thread_arena_hold, h);
+    while (!atomic_load(&h->held))
+        sched_yield();
+}
+
+static void *thread_arena_size(void *arg) {
+    ll_arena_size(arg);
+    return NULL;
+}
+
+/*
+ * Threads that used the arena and exited must give their slots back:
+ * with them all taken, the readers below would pin without a slot, which
+ * holds back every free.
+ */
+static int test_arena_thread_exit(void) {
+    char path[128];
+    arena_path(path, sizeof(path), "exit");
+    ll_arena_t *a = ll_arena_open(path, 1 << 20);
+    ASSERT(a);
+    struct item *f = LL_ARENA_NEW(a, struct item);
+    ASSERT(f);
+    ASSERT_EQ(LL_ARENA_INSERT_TAIL(a, f), 0);
+    for (int i = 0; i < 100; i++) {
+        pthread_t th;
+        pthread_create(&th, NULL, thread_arena_size, a);
+        pthread_join(th, NULL);
+    }
+    struct item *e = LL_ARENA_NEW(a, struct item);
+    ASSERT(e);
+    ASSERT_EQ(LL_ARENA_INSERT_TAIL(a, e), 0);
+    ASSERT_EQ(LL_ARENA_REMOVE(a, e), 0);
+    /* u pins after the remove, so reclaim unlinks e but has to keep it. */
+    struct arena_hold u = { a, 0, 0 }, t = { a, 0, 0 };
+    pthread_t uth, tth;
+    arena_hold_start(&u, &uth);
+    ASSERT_EQ(ll_arena_reclaim(a), 1);
+    /* t pins after that; once u lets go, e is older than every pin. */
+    arena_hold_start(&t, &tth);
+    atomic_store(&u.release, 1);
+    pthread_join(uth, NULL);
+    ASSERT_EQ(ll_arena_reclaim(a), 0);
+    ASSERT(LL_ARENA_NEW(a, struct item) == e);
+    atomic_store(&t.release, 1);
+    pthread_join(tth, NULL);
+    ASSERT_EQ(ll_arena_close(a), 0);
+    unlink(path);
+    return 0;
+}
+
+/*
+ * Closing one handle must leave the slots of another handle on the same
+ * file alone, and a handle with a walk still inside refuses to close.
+ */
+static int test_arena_close_own_slots(void) {
+    char path[128];
+    arena_path(path, sizeof(path), "close");
+    ll_arena_t *a = ll_arena_open(path, 1 << 20);
+    ASSERT(a);
+    ll_arena_t *b = ll_arena_open(path, 1 << 20);
+    ASSERT(b);
+    struct item *f = LL_ARENA_NEW(a, struct item);
+    ASSERT(f);
+    ASSERT_EQ(LL_ARENA_INSERT_TAIL(a, f), 0);
+    struct item *e = LL_ARENA_NEW(a, struct item);
+    ASSERT(e);
+    ASSERT_EQ(LL_ARENA_INSERT_TAIL(a, e), 0);
+    ASSERT_EQ(LL_ARENA_REMOVE(a, e), 0);
+    /* u pins through a before reclaim unlinks e, so e has to stay. */
+    struct arena_hold u = { a, 0, 0 };
+    pthread_t uth;
+    arena_hold_start(&u, &uth);
+    ASSERT_EQ(ll_arena_reclaim(a), 1);
+    ASSERT_EQ(ll_arena_size(b), 1);
+    ASSERT_EQ(ll_arena_close(b), 0);
+    ASSERT_EQ(ll_arena_reclaim(a), 0);
+    struct item *g = LL_ARENA_NEW(a, struct item);
+    ASSERT(g && g != e);
+    ASSERT_EQ(ll_arena_close(a), -1);
+    ASSERT_EQ(errno, EBUSY);
+    atomic_store(&u.release, 1);
+    pthread_join(uth, NULL);
+    ASSERT_EQ(ll_arena_reclaim(a), 0);
+    ASSERT(LL_ARENA_NEW(a, struct item) == e);
+    ASSERT_EQ(ll_arena_close(a), 0);
+    unlink(path);
+    return 0;
+}
+
+enum { ARENAS_OPEN = 6 };
+
+struct arena_hold_last {
+    ll_arena_t **a;
+    struct arena_hold h;
+};
+
+/* Read every arena but the last, then hold a pin on the last. */
+static void *thread_arena_hold_last(void *arg) {
+    struct arena_hold_last *l = arg;
+    for (int i = 0; i < ARENAS_OPEN - 1; i++)
+        ll_arena_size(l->a[i]);
+    return thread_arena_hold(&l->h);
+}
+
+/* A thread reading more arenas than its first slot cache holds still pins each with a slot. */
+static int test_arena_many_open(void) {
+    char path[ARENAS_OPEN][128];
+    ll_arena_t *a[ARENAS_OPEN];
+    for (int i = 0; i < ARENAS_OPEN; i++) {
+        char tag[16];
+        snprintf(tag, sizeof(tag), "many%d", i);
+        arena_path(path[i], sizeof(path[i]), tag);
+        a[i] = ll_arena_open(path[i], 1 << 20);
+        ASSERT(a[i]);
+    }
+    ll_arena_t *last = a[ARENAS_OPEN - 1];
+    struct item *f = LL_ARENA_NEW(last, struct item);
+    ASSERT(f);
+    ASSERT_EQ(LL_ARENA_INSERT_TAIL(last, f), 0);
+    struct item *e = LL_ARENA_NEW(last, struct item);
+    ASSERT(e);
+    ASSERT_EQ(LL_ARENA_INSERT_TAIL(last, e), 0);
+    ASSERT_EQ(LL_ARENA_REMOVE(last, e), 0);
+    /* As in test_arena_thread_exit: e is unlinked under u, then t pins after it. */
+    struct arena_hold u = { last, 0, 0 };
+    pthread_t uth, tth;
+    arena_hold_start(&u, &uth);
+    ASSERT_EQ(ll_arena_reclaim(last), 1);
+    struct arena_hold_last t = { a, { last, 0, 0 } };
+    pthread_create(&tth, NULL, thread_arena_hold_last, &t);
+    while (!atomic_load(&t.h.held))
+        sched_yield();
+    atomic_store(&u.release, 1);
+    pthread_join(uth, NULL);
+    ASSERT_EQ(ll_arena_reclaim(last), 0);
+    ASSERT(LL_ARENA_NEW(last, struct item) == e);
+    atomic_store(&t.h.release, 1);
+    pthread_join(tth, NULL);
+    for (int i = 0; i < ARENAS_OPEN; i++) {
+        ASSERT_EQ(ll_arena_close(a[i]), 0);
+        unlink(path[i]);
+    }
+    return 0;
+}
+
 /* --- Concurrent tests --- */
 #define CONCURRENT_THREADS 8
 #define CONCURRENT_OPS     200
@@ -392,6 +1773,50 @@ static int test_concurrent_transactions(void) {
     return 0;
 }
 
+#define GROUP_THREADS 4
+#define GROUP_COMMITS 500
+static struct item group_elems[GROUP_THREADS][GROUP_COMMITS];
+
+/* Each commit adds this thread's next element and removes its previous one. */
+static void *thread_group_commit_worker(void *arg) {
+    long id = (long)arg;
+    for (int k = 0; k < GROUP_COMMITS; k++) {
+        ll_txn_t *txn = LL_TXN_START(conc_lst, struct item, link);
+        if (!txn)
+            continue;
+        group_elems[id][k].value = (int)(id * GROUP_COMMITS + k);
+        if (k & 1)
+            LL_TXN_INSERT_HEAD(txn, &group_elems[id][k], link);
+        else
+            LL_TXN_INSERT_TAIL(txn, &group_elems[id][k], link);
+        if (k > 0)
+            LL_TXN_REMOVE(txn, &group_elems[id][k - 1], link);
+        ll_txn_commit(txn);
+    }
+    return NULL;
+}
+
+static int test_concurrent_group_commit(void) {
+    struct list_head lst;
+    LL_INIT(&lst);
+    LL_SET_GROUP_COMMIT(&lst, 1);
+    conc_lst = &lst;
+    uint64_t before = atomic_load(&lst.commit_id);
+    pthread_t th[GROUP_THREADS];
+    for (int i = 0; i < GROUP_THREADS; i++)
+        pthread_create(&th[i], NULL, thread_group_commit_worker, (void *)(long)i);
+    for (int i = 0; i < GROUP_THREADS; i++)
+        pthread_join(th[i], NULL);
+    ASSERT(atomic_load(&lst.commit_id) - before <= GROUP_THREADS * GROUP_COMMITS);
+    /* Only each thread's last element is left. */
+    ASSERT_EQ(LL_SIZE(&lst, struct item, link), GROUP_THREADS);
+    for (int i = 0; i < GROUP_THREADS; i++)
+        ASSERT(LL_CONTAINS(&lst, &group_elems[i][GROUP_COMMITS - 1], link));
+    while (LL_REMOVE_HEAD(&lst, struct item, link))
+        ;
+    return 0;
+}
+
 static void *thread_reader(void *arg) {
     (void)arg;
     for (int i = 0; i < 100; i++) {
@@ -418,6 +1843,581 @@ static void *thread_writer(void *arg) {
     return NULL;
 }
 
+/* A thread that opens a txn on exit_lst; with hold set, waits until released and leaves it open. */
+struct exit_worker { int hold; _Atomic int opened, go; ll_txn_t *txn; };
+static struct list_head exit_lst;
+
+static void *thread_exit_worker(void *arg) {
+    struct exit_worker *w = arg;
+    w->txn = LL_TXN_START(&exit_lst, struct item, link);
+    if (!w->hold) {
+        ll_txn_rollback(w->txn);
+        return NULL;
+    }
+    atomic_store(&w->opened, 1);
+    while (!atomic_load(&w->go))
+        sched_yield();
+    return NULL;
+}
+
+static size_t exit_lst_garbage(void) {
+    ll_txn_commit(LL_TXN_START(&exit_lst, struct item, link));   /* runs reclaim */
+    ll_garbage_stats_t st;
+    LL_GARBAGE_STATS(&exit_lst, &st);
+    return st.garbage;
+}
+
+static int test_thread_exit(void) {
+    static struct item e[4];
+    LL_INIT(&exit_lst);
+    for (int i = 0; i < 4; i++)
+        LL_INSERT_TAIL(&exit_lst, &e[i], link);
+    /* Far more short-lived threads than registry slots: exited threads give theirs back. */
+    for (int i = 0; i < 100; i++) {
+        struct exit_worker w = { 0 };
+        pthread_t th;
+        pthread_create(&th, NULL, thread_exit_worker, &w);
+        pthread_join(th, NULL);
+    }
+    /* A thread after those still registers its snapshot, and dying with it open releases it. */
+    struct exit_worker w = { .hold = 1 };
+    pthread_t th;
+    pthread_create(&th, NULL, thread_exit_worker, &w);
+    while (!atomic_load(&w.opened))
+        sched_yield();
+    ASSERT_EQ(LL_REMOVE(&exit_lst, &e[0], link), 0);
+    ASSERT_EQ(exit_lst_garbage(), 1);
+    atomic_store(&w.go, 1);
+    pthread_join(th, NULL);
+    ASSERT_EQ(exit_lst_garbage(), 0);
+    ASSERT_EQ(ll_txn_status(w.txn), LL_TXN_EXPIRED);
+    ll_txn_rollback(w.txn);
+    ASSERT_EQ(LL_SIZE(&exit_lst, struct item, link), 3);
+    while (LL_REMOVE_HEAD(&exit_lst, struct item, link))
+        ;
+    return 0;
+}
+
+static _Atomic long batch_calls, batch_elms, batch_other_thread;
+static pthread_t batch_main;
+
+static void count_batch(void **elms, size_t n) {
+    atomic_fetch_add(&batch_calls, 1);
+    for (size_t i = 0; i < n; i++)
+        atomic_fetch_add(&batch_elms, ((struct item *)elms[i])->value);
+    if (!pthread_equal(pthread_self(), batch_main))
+        atomic_fetch_add(&batch_other_thread, 1);
+}
+
+static int test_free_batch(void) {
+    static struct item e[40];
+    batch_main = pthread_self();
+    for (int deferred = 0; deferred < 2; deferred++) {
+        struct list_head lst;
+        LL_INIT(&lst);
+        LL_SET_FREE_BATCH(&lst, count_batch, deferred);
+        atomic_store(&batch_calls, 0);
+        atomic_store(&batch_elms, 0);
+        atomic_store(&batch_other_thread, 0);
+        for (int i = 0; i < 40; i++) {
+            e[i].value = 1;
+            LL_INSERT_TAIL(&lst, &e[i], link);
+        }
+        /* One commit, one reclaim pass, one batch. */
+        ll_txn_t *t = LL_TXN_START(&lst, struct item, link);
+        for (int i = 0; i < 30; i++)
+            LL_TXN_REMOVE(t, &e[i], link);
+        ASSERT_EQ(ll_txn_commit(t), 0);
+        ll_free_flush();
+        ASSERT_EQ(atomic_load(&batch_calls), 1);
+        ASSERT_EQ(atomic_load(&batch_elms), 30);
+        ASSERT_EQ(atomic_load(&batch_other_thread), deferred);
+        ASSERT_EQ(LL_SIZE(&lst, struct item, link), 10);
+        if (deferred) {
+            /* Shutdown runs what is queued before it joins; the next batch restarts the thread. */
+            t = LL_TXN_START(&lst, struct item, link);
+            for (int i = 30; i < 35; i++)
+                LL_TXN_REMOVE(t, &e[i], link);
+            ASSERT_EQ(ll_txn_commit(t), 0);
+            ll_free_shutdown();
+            ASSERT_EQ(atomic_load(&batch_calls), 2);
+            ASSERT_EQ(atomic_load(&batch_elms), 35);
+            ll_free_shutdown();
+            t = LL_TXN_START(&lst, struct item, link);
+            LL_TXN_REMOVE(t, &e[35], link);
+            ASSERT_EQ(ll_txn_commit(t), 0);
+            ll_free_flush();
+            ASSERT_EQ(atomic_load(&batch_calls), 3);
+            ASSERT_EQ(atomic_load(&batch_other_thread), 3);
+            ll_free_shutdown();
+        }
+        while (LL_REMOVE_HEAD(&lst, struct item, link))
+            ;
+    }
+    return 0;
+}
+
+/* Remove elm and commit; returns the list's garbage after that commit's reclaim. */
+static size_t remove_committed(struct list_head *lst, struct item *elm) {
+    ll_txn_t *t = LL_TXN_START(lst, struct item, link);
+    LL_TXN_REMOVE(t, elm, link);
+    ll_txn_commit(t);
+    ll_garbage_stats_t st;
+    LL_GARBAGE_STATS(lst, &st);
+    return st.garbage;
+}
+
+static struct list_head qsbr_lst;
+static _Atomic int qsbr_step, qsbr_found;
+
+/* Reads with no stores, then quiesces when told to. */
+static void *thread_qsbr_reader(void *arg) {
+    struct item *e = arg;
+    if (ll_qsbr_online() < 0)
+        return NULL;
+    atomic_store(&qsbr_found, LL_CONTAINS(&qsbr_lst, &e[1], link));
+    atomic_store(&qsbr_step, 1);
+    while (atomic_load(&qsbr_step) != 2)
+        sched_yield();
+    ll_quiescent_state();
+    atomic_store(&qsbr_step, 3);
+    while (atomic_load(&qsbr_step) != 4)
+        sched_yield();
+    ll_qsbr_offline();
+    return NULL;
+}
+
+static int test_qsbr(void) {
+    static struct item e[4];
+    struct list_head plain;
+    LL_INIT(&qsbr_lst);
+    LL_INIT(&plain);
+    LL_SET_QSBR(&qsbr_lst, 1);
+    for (int i = 0; i < 4; i++)
+        LL_INSERT_TAIL(&qsbr_lst, &e[i], link);
+    pthread_t th;
+    pthread_create(&th, NULL, thread_qsbr_reader, e);
+    while (atomic_load(&qsbr_step) != 1)
+        sched_yield();
+    ASSERT(atomic_load(&qsbr_found));
+    /* An online reader that has not quiesced holds back QSBR lists only. */
+    ASSERT_EQ(remove_committed(&qsbr_lst, &e[0]), 1);
+    static struct item p[1];
+    LL_INSERT_TAIL(&plain, &p[0], link);
+    ASSERT_EQ(remove_committed(&plain, &p[0]), 0);
+    atomic_store(&qsbr_step, 2);
+    while (atomic_load(&qsbr_step) != 3)
+        sched_yield();
+    ASSERT_EQ(remove_committed(&qsbr_lst, &e[1]), 1);   /* e[0] freed, e[1] waits */
+    atomic_store(&qsbr_step, 4);
+    pthread_join(th, NULL);
+    /* Offline threads are not waited for. */
+    ASSERT_EQ(remove_committed(&qsbr_lst, &e[2]), 0);
+    ASSERT_EQ(LL_SIZE(&qsbr_lst, struct item, link), 1);
+    while (LL_REMOVE_HEAD(&qsbr_lst, struct item, link))
+        ;
+    return 0;
+}
+
+static struct list_head sw_lst;
+static _Atomic int sw_done, sw_unordered;
+
+/* Transactions on a single-writer list always see an ascending run. */
+static void *thread_sw_reader(void *arg) {
+    (void)arg;
+    while (!atomic_load(&sw_done)) {
+        ll_txn_t *t = LL_TXN_START(&sw_lst, struct item, link);
+        if (!t)
+            continue;
+        int last = -1;
+        struct item *var;
+        LL_TXN_FOREACH_ITER(var, t, struct item) {
+            if (var->value <= last)
+                atomic_store(&sw_unordered, 1);
+            last = var->value;
+        }
+        ll_txn_rollback(t);
+    }
+    return NULL;
+}
+
+static int test_single_writer(void) {
+    enum { READERS = 2, WINDOW = 16 };
+    struct item *e = malloc(sizeof(*e) * CONCURRENT_OPS);
+    ASSERT(e);
+    LL_INIT(&sw_lst);
+    LL_SET_THREADING(&sw_lst, LL_SINGLE_WRITER);
+    pthread_t th[READERS];
+    for (int i = 0; i < READERS; i++)
+        pthread_create(&th[i], NULL, thread_sw_reader, NULL);
+    for (int i = 0; i < CONCURRENT_OPS; i++) {
+        e[i].value = i;
+        LL_INSERT_TAIL(&sw_lst, &e[i], link);
+        if (i >= WINDOW && LL_REMOVE_HEAD(&sw_lst, struct item, link) != &e[i - WINDOW])
+            atomic_store(&sw_unordered, 1);
+    }
+    atomic_store(&sw_done, 1);
+    for (int i = 0; i < READERS; i++)
+        pthread_join(th[i], NULL);
+    ASSERT_EQ(LL_SIZE(&sw_lst, struct item, link), WINDOW);
+    while (LL_REMOVE_HEAD(&sw_lst, struct item, link))
+        ;
+    ll_txn_commit(LL_TXN_START(&sw_lst, struct item, link));
+    ASSERT(!atomic_load(&sw_unordered));
+    free(e);
+    return 0;
+}
+
+static struct list_head pq_lst;
+static _Atomic int pq_popped[4 * CONCURRENT_OPS];
+
+/* Push this thread's keys in order of a stride, popping one for every two pushed. */
+static void *thread_pq_worker(void *arg) {
+    struct item *e = arg;
+    for (int i = 0; i < CONCURRENT_OPS; i++) {
+        LL_INSERT_ORDERED(&pq_lst, &e[(i * 7) % CONCURRENT_OPS], link);
+        struct item *p = (i & 1) ? LL_REMOVE_MIN(&pq_lst, struct item, link) : NULL;
+        if (p)
+            atomic_fetch_add(&pq_popped[p->value], 1);
+    }
+    return NULL;
+}
+
+static int test_concurrent_priority_queue(void) {
+    enum { THREADS = 4 };
+    static struct item e[THREADS * CONCURRENT_OPS];
+    for (int relaxed = 0; relaxed < 2; relaxed++) {
+        LL_INIT(&pq_lst);
+        LL_SET_ORDER(&pq_lst, item_order);
+        LL_SET_RELAXED_MIN(&pq_lst, relaxed ? THREADS * 2 : 0);
+        for (int i = 0; i < THREADS * CONCURRENT_OPS; i++) {
+            e[i].value = i;
+            atomic_store(&pq_popped[i], 0);
+        }
+        pthread_t th[THREADS];
+        for (int t = 0; t < THREADS; t++)
+            pthread_create(&th[t], NULL, thread_pq_worker, &e[t * CONCURRENT_OPS]);
+        for (int t = 0; t < THREADS; t++)
+            pthread_join(th[t], NULL);
+        int last = -1;
+        struct item *p;
+        while ((p = LL_REMOVE_MIN(&pq_lst, struct item, link)) != NULL) {
+            if (!relaxed)
+                ASSERT(p->value > last);
+            last = p->value;
+            atomic_fetch_add(&pq_popped[p->value], 1);
+        }
+        for (int i = 0; i < THREADS * CONCURRENT_OPS; i++)
+            ASSERT_EQ(atomic_load(&pq_popped[i]), 1);
+        ll_txn_commit(LL_TXN_START(&pq_lst, struct item, link));
+    }
+    return 0;
+}
+
+enum { PAR_WINDOW = 2000 };
+static struct list_head par_lst;
+static _Atomic int par_done, par_torn;
+
+typedef struct {
+    _Atomic unsigned *stamp;     /* per element: the last pass that saw it */
+    unsigned pass;
+} par_reader_t;
+
+static void par_stamp_cb(void *elm, void *userdata) {
+    par_reader_t *r = userdata;
+    if (atomic_exchange(&r->stamp[((struct item *)elm)->value], r->pass) == r->pass)
+        atomic_store(&par_torn, 1);
+}
+
+/*
+ * Every commit swaps one element out and one in, so a pass sees PAR_WINDOW
+ * elements, give or take the two commits that can overlap its snapshot
+ * (the one in flight when it was taken, and the one numbered at it), and
+ * none of them twice.
+ */
+static void *thread_par_reader(void *arg) {
+    par_reader_t r = { arg, 0 };
+    while (!atomic_load(&par_done)) {
+        r.pass++;
+        size_t n = LL_PARALLEL_CALLBACKS(&par_lst, 3, par_stamp_cb, &r);
+        if (n + 2 < PAR_WINDOW || n > PAR_WINDOW + 2)
+            atomic_store(&par_torn, 1);
+    }
+    return NULL;
+}
+
+static int test_concurrent_parallel_callbacks(void) {
+    enum { READERS = 2, WINDOW = PAR_WINDOW, SWAPS = CONCURRENT_OPS * 10 };
+    struct item *e = malloc(sizeof(*e) * (WINDOW + SWAPS));
+    _Atomic unsigned *stamp = calloc((size_t)READERS * (WINDOW + SWAPS), sizeof(*stamp));
+    ASSERT(e && stamp);
+    for (int i = 0; i < WINDOW + SWAPS; i++)
+        e[i].value = i;
+    LL_INIT(&par_lst);
+    atomic_store(&par_done, 0);
+    atomic_store(&par_torn, 0);
+    for (int i = 0; i < WINDOW; i++)
+        LL_INSERT_TAIL(&par_lst, &e[i], link);
+    pthread_t th[READERS];
+    for (int i = 0; i < READERS; i++)
+        pthread_create(&th[i], NULL, thread_par_reader, stamp + (size_t)i * (WINDOW + SWAPS));
+    for (int i = 0; i < SWAPS; i++) {
+        ll_txn_t *txn = LL_TXN_START(&par_lst, struct item, link);
+        ASSERT(txn);
+        LL_TXN_REMOVE(txn, &e[i], link);
+        LL_TXN_INSERT_TAIL(txn, &e[WINDOW + i], link);
+        ASSERT_EQ(ll_txn_commit(txn), 0);
+    }
+    atomic_store(&par_done, 1);
+    for (int i = 0; i < READERS; i++)
+        pthread_join(th[i], NULL);
+    ASSERT(!atomic_load(&par_torn));
+    par_reader_t r = { stamp, 1u << 31 };
+    ASSERT_EQ(LL_PARALLEL_CALLBACKS(&par_lst, 4, par_stamp_cb, &r), WINDOW);
+    ASSERT(!atomic_load(&par_torn));
+    while (LL_REMOVE_HEAD(&par_lst, struct item, link))
+        ;
+    ll_txn_commit(LL_TXN_START(&par_lst, struct item, link));
+    free(stamp);
+    free(e);
+    return 0;
+}
+
+enum { PAR_DRAIN_N = 20000, PAR_DRAINERS = 2 };
+static struct list_head par_drain_lst;
+static _Atomic int par_drain_go, par_drained;
+
+/* Each drainer pops a quarter of the list once the scan has started. */
+static void *thread_par_drain(void *arg) {
+    (void)arg;
+    while (!atomic_load(&par_drain_go))
+        sched_yield();
+    for (int i = 0; i < PAR_DRAIN_N / 4; i++)
+        LL_REMOVE_HEAD(&par_drain_lst, struct item, link);
+    atomic_fetch_add(&par_drained, 1);
+    return NULL;
+}
+
+/* The first call holds its thread until half the list has been popped. */
+static void par_seen_cb(void *elm, void *userdata) {
+    if (atomic_fetch_add(&((_Atomic int *)userdata)[((struct item *)elm)->value], 1))
+        atomic_store(&par_torn, 1);
+    if (!atomic_exchange(&par_drain_go, 1))
+        while (atomic_load(&par_drained) < PAR_DRAINERS)
+            sched_yield();
+}
+
+static void seen_identity(void *acc, void *userdata) {
+    (void)userdata;
+    *(long *)acc = 0;
+}
+
+static void seen_map(void *acc, const void *elm, void *userdata) {
+    ++*(long *)acc;
+    par_seen_cb((void *)elm, userdata);
+}
+
+static void seen_combine(void *acc, const void *other, void *userdata) {
+    (void)userdata;
+    *(long *)acc += *(const long *)other;
+}
+
+/*
+ * Threads pop half the list while it is scanned. Every fifth element was
+ * removed beforehand and is kept linked, so the pops unlink nodes from
+ * behind a removed one, swinging its next past nodes the scan has yet to
+ * reach. No element may be visited twice, by LL_PARALLEL_CALLBACKS or by
+ * LL_SNAPSHOT_REDUCE.
+ */
+static int test_concurrent_parallel_drain(void) {
+    enum { N = PAR_DRAIN_N };
+    static const ll_reduce_ops_t seen_ops = { sizeof(long), seen_identity, seen_map, seen_combine };
+    struct item *e = malloc(sizeof(*e) * N);
+    _Atomic int *seen = malloc(sizeof(*seen) * N);
+    ASSERT(e && seen);
+    LL_INIT(&par_drain_lst);
+    atomic_store(&par_torn, 0);
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < N; i++) {
+            e[i].value = i;
+            atomic_init(&seen[i], 0);
+            LL_INSERT_TAIL(&par_drain_lst, &e[i], link);
+        }
+        /* An older snapshot keeps reclaim from unlinking the removed ones. */
+        ll_txn_t *old = LL_TXN_START(&par_drain_lst, struct item, link);
+        ASSERT(old);
+        for (int i = 0; i < N; i += 5)
+            ASSERT_EQ(LL_REMOVE(&par_drain_lst, &e[i], link), 0);
+        atomic_store(&par_drain_go, 0);
+        atomic_store(&par_drained, 0);
+        pthread_t th[PAR_DRAINERS];
+        for (int t = 0; t < PAR_DRAINERS; t++)
+            pthread_create(&th[t], NULL, thread_par_drain, NULL);
+        size_t n;
+        if (round) {
+            long count;
+            ASSERT_EQ(LL_SNAPSHOT_REDUCE(&par_drain_lst, 4, &seen_ops, &count, seen), 0);
+            n = (size_t)count;
+        } else {
+            n = LL_PARALLEL_CALLBACKS(&par_drain_lst, 4, par_seen_cb, seen);
+        }
+        for (int t = 0; t < PAR_DRAINERS; t++)
+            pthread_join(th[t], NULL);
+        ASSERT(!atomic_load(&par_torn));
+        ASSERT(n <= N - N / 5);
+        ll_txn_rollback(old);
+        while (LL_REMOVE_HEAD(&par_drain_lst, struct item, link))
+            ;
+        ll_txn_commit(LL_TXN_START(&par_drain_lst, struct item, link));
+    }
+    free(seen);
+    free(e);
+    return 0;
+}
+
+static ll_wsdeque_t ws_dq;
+static _Atomic int ws_done[CONCURRENT_OPS * 20];
+static _Atomic int ws_owner_finished;
+
+/* Thieves alternate single steals and steal_half until the owner is done and the deque is empty. */
+static void *thread_ws_thief(void *arg) {
+    (void)arg;
+    struct item *buf[8];
+    for (unsigned k = 0;; k++) {
+        size_t n;
+        if (k & 1) {
+            n = LL_WSDEQUE_STEAL_HALF(&ws_dq, buf, 8);
+        } else {
+            buf[0] = LL_WSDEQUE_STEAL(&ws_dq, struct item);
+            n = buf[0] != NULL;
+        }
+        for (size_t i = 0; i < n; i++)
+            atomic_fetch_add(&ws_done[buf[i]->value], 1);
+        if (!n && atomic_load(&ws_owner_finished) && LL_WSDEQUE_SIZE(&ws_dq) == 0)
+            break;
+        if (!n)
+            sched_yield();
+    }
+    return NULL;
+}
+
+static int test_concurrent_wsdeque(void) {
+    enum { THIEVES = 3, N = CONCURRENT_OPS * 20 };
+    static struct item e[N];
+    ASSERT_EQ(LL_WSDEQUE_INIT(&ws_dq), 0);
+    atomic_store(&ws_owner_finished, 0);
+    for (int i = 0; i < N; i++) {
+        e[i].value = i;
+        atomic_store(&ws_done[i], 0);
+    }
+    pthread_t th[THIEVES];
+    for (int t = 0; t < THIEVES; t++)
+        pthread_create(&th[t], NULL, thread_ws_thief, NULL);
+    /* Owner: push in bursts that outgrow the ring, popping one for every three pushed. */
+    for (int i = 0; i < N; i++) {
+        ASSERT_EQ(LL_WSDEQUE_PUSH(&ws_dq, &e[i]), 0);
+        struct item *p = (i % 3 == 2) ? LL_WSDEQUE_POP(&ws_dq, struct item) : NULL;
+        if (p)
+            atomic_fetch_add(&ws_done[p->value], 1);
+    }
+    struct item *p;
+    while ((p = LL_WSDEQUE_POP(&ws_dq, struct item)) != NULL)
+        atomic_fetch_add(&ws_done[p->value], 1);
+    atomic_store(&ws_owner_finished, 1);
+    for (int t = 0; t < THIEVES; t++)
+        pthread_join(th[t], NULL);
+    for (int i = 0; i < N; i++)
+        ASSERT_EQ(atomic_load(&ws_done[i]), 1);
+    LL_WSDEQUE_DESTROY(&ws_dq);
+    return 0;
+}
+
+static ll_arena_t *conc_arena;
+static _Atomic long conc_arena_empty;
+
+static void *thread_arena_worker(void *arg) {
+    long id = (long)arg;
+    for (int i = 0; i < CONCURRENT_OPS; i++) {
+        struct item *e = LL_ARENA_NEW(conc_arena, struct item);
+        if (!e)
+            continue;
+        e->value = (int)(id * 10000 + i);
+        if (i % 2)
+            LL_ARENA_INSERT_HEAD(conc_arena, e);
+        else
+            LL_ARENA_INSERT_TAIL(conc_arena, e);
+        struct item *p = LL_ARENA_REMOVE_HEAD(conc_arena, struct item);
+        if (p)
+            ll_arena_free(conc_arena, p);
+        else   /* only newer inserts left: invisible to this remove's snapshot */
+            atomic_fetch_add(&conc_arena_empty, 1);
+        ll_arena_size(conc_arena);
+    }
+    return NULL;
+}
+
+static int test_concurrent_arena(void) {
+    char path[128];
+    arena_path(path, sizeof(path), "conc");
+    conc_arena = ll_arena_open(path, 4 << 20);
+    ASSERT(conc_arena);
+    atomic_store(&conc_arena_empty, 0);
+    pthread_t th[CONCURRENT_THREADS];
+    for (int i = 0; i < CONCURRENT_THREADS; i++)
+        pthread_create(&th[i], NULL, thread_arena_worker, (void *)(long)i);
+    for (int i = 0; i < CONCURRENT_THREADS; i++)
+        pthread_join(th[i], NULL);
+    ASSERT_EQ(ll_arena_size(conc_arena), atomic_load(&conc_arena_empty));
+    ASSERT_EQ(ll_arena_close(conc_arena), 0);
+    unlink(path);
+    return 0;
+}
+
+#define SHM_ITEMS 2000
+
+static int test_concurrent_arena_shm_processes(void) {
+    char name[64];
+    snprintf(name, sizeof(name), "/ll_arena_test_shm_%ld", (long)getpid());
+    ll_arena_shm_unlink(name);
+    ll_arena_t *a = ll_arena_shm_open(name, 4 << 20);
+    ASSERT(a);
+    pid_t pid = fork();
+    ASSERT(pid >= 0);
+    if (pid == 0) {
+        /* Producer process: attaches by name, its pointers differ from the parent's. */
+        ll_arena_t *c = ll_arena_shm_open(name, 0);
+        if (!c)
+            _exit(1);
+        for (int i = 0; i < SHM_ITEMS; i++) {
+            struct item *e;
+            while ((e = LL_ARENA_NEW(c, struct item)) == NULL)
+                ll_arena_reclaim(c);
+            e->value = i;
+            if (LL_ARENA_INSERT_TAIL(c, e) != 0)
+                _exit(1);
+        }
+        _exit(ll_arena_close(c) == 0 ? 0 : 1);
+    }
+    long sum = 0;
+    int got = 0;
+    for (long spins = 0; got < SHM_ITEMS && spins < 100000000L; spins++) {
+        struct item *p = LL_ARENA_REMOVE_HEAD(a, struct item);
+        if (!p)
+            continue;
+        sum += p->value;
+        got++;
+        ll_arena_free(a, p);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    ASSERT_EQ(got, SHM_ITEMS);
+    ASSERT_EQ(sum, (long)SHM_ITEMS * (SHM_ITEMS - 1) / 2);
+    ASSERT_EQ(ll_arena_close(a), 0);
+    ll_arena_shm_unlink(name);
+    return 0;
+}
+
 static int test_concurrent_readers_writers(void) {
     struct list_head lst;
     LL_INIT(&lst);
@@ -447,10 +2447,39 @@ static void run_unit_tests(void) {
     RUN_TEST("foreach order", test_foreach_order);
     RUN_TEST("remove head empty", test_remove_head_empty);
     RUN_TEST("insert after nonexistent", test_insert_after_nonexistent);
+    RUN_TEST("generated ops", test_generated_ops);
     RUN_TEST("txn insert after commit", test_txn_insert_after_commit);
     RUN_TEST("txn rollback discards", test_txn_rollback_discards);
     RUN_TEST("txn multiple insert_after same anchor", test_txn_multiple_insert_after_same_anchor);
     RUN_TEST("txn remove inserted_after", test_txn_remove_inserted_after);
+    RUN_TEST("txn cache reuse", test_txn_cache_reuse);
+    RUN_TEST("txn group commit", test_txn_group_commit);
+    RUN_TEST("reclaim budget", test_reclaim_budget);
+    RUN_TEST("garbage limit", test_garbage_limit);
+    RUN_TEST("snapshot lease", test_snapshot_lease);
+    RUN_TEST("reclaim domain", test_reclaim_domain);
+    RUN_TEST("hazard eras", test_hazard_eras);
+    RUN_TEST("tagged head pop", test_tagged_head_pop);
+    RUN_TEST("threading modes", test_threading_modes);
+    RUN_TEST("priority queue", test_priority_queue);
+    RUN_TEST("parallel callbacks", test_parallel_callbacks);
+    RUN_TEST("snapshot reduce", test_snapshot_reduce);
+    RUN_TEST("reduce alignment", test_reduce_alignment);
+    RUN_TEST("snapshot to array", test_snapshot_to_array);
+    RUN_TEST("work-stealing deque", test_wsdeque);
+    RUN_TEST("txn foreach large write set", test_txn_foreach_large_write_set);
+    RUN_TEST("txn iter cursor", test_txn_iter_cursor);
+    RUN_TEST("custom allocator", test_custom_allocator);
+    RUN_TEST("read pin", test_read_pin);
+    RUN_TEST("pop vs reader", test_pop_vs_reader);
+    RUN_TEST("slot overflow reader", test_slot_overflow_reader);
+    RUN_TEST("arena reopen clean", test_arena_reopen_clean);
+    RUN_TEST("arena remove reuses space", test_arena_remove_reuses_space);
+    RUN_TEST("arena crash recovery", test_arena_crash_recovery);
+    RUN_TEST("arena shm dead reader", test_arena_shm_dead_reader);
+    RUN_TEST("arena thread exit", test_arena_thread_exit);
+    RUN_TEST("arena close own slots", test_arena_close_own_slots);
+    RUN_TEST("arena many open", test_arena_many_open);
 }
 
 static void run_concurrent_tests(void) {
@@ -458,7 +2487,18 @@ static void run_concurrent_tests(void) {
     RUN_TEST("concurrent mixed head/tail", test_concurrent_mixed_head_tail);
     RUN_TEST("concurrent insert_after", test_concurrent_insert_after);
     RUN_TEST("concurrent transactions", test_concurrent_transactions);
+    RUN_TEST("concurrent group commit", test_concurrent_group_commit);
     RUN_TEST("concurrent readers writers", test_concurrent_readers_writers);
+    RUN_TEST("thread exit", test_thread_exit);
+    RUN_TEST("free batch", test_free_batch);
+    RUN_TEST("qsbr", test_qsbr);
+    RUN_TEST("single writer", test_single_writer);
+    RUN_TEST("concurrent priority queue", test_concurrent_priority_queue);
+    RUN_TEST("concurrent parallel callbacks", test_concurrent_parallel_callbacks);
+    RUN_TEST("concurrent parallel drain", test_concurrent_parallel_drain);
+    RUN_TEST("concurrent work-stealing deque", test_concurrent_wsdeque);
+    RUN_TEST("concurrent arena", test_concurrent_arena);
+    RUN_TEST("concurrent arena shm processes", test_concurrent_arena_shm_processes);
 }
 
 int main(int argc, char **argv) {
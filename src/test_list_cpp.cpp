@@ -0,0 +1,198 @@
+/**
+ * Unit tests for the C++ wrapper (list.hpp).
+ */
+#if __cplusplus > 202002L && defined(__has_include)
+#if __has_include(<stdatomic.h>)
+/* C++23's own C atomics must coexist with list.h. */
+#include <stdatomic.h>
+#endif
+#endif
+#include "list.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+struct item {
+    int value;
+    LL_ENTRY(item, link);
+    explicit item(int v = 0) : value(v), link(0) {}
+};
+using item_list = ll::list<item, &item::link>;
+
+static int tests_run, tests_failed;
+
+#define RUN_TEST(name, fn) do { \
+    tests_run++; \
+    if (fn()) { \
+        fprintf(stderr, "FAIL: %s\n", name); \
+        tests_failed++; \
+    } else { \
+        printf("  ok %s\n", name); \
+    } \
+} while (0)
+
+#define ASSERT(c) do { if (!(c)) return 1; } while (0)
+#define ASSERT_EQ(a, b) do { if ((a) != (b)) { fprintf(stderr, "  assert %s: %ld != %ld\n", #a " == " #b, (long)(a), (long)(b)); return 1; } } while (0)
+
+static std::vector<int> values(const item_list &lst)
+{
+    std::vector<int> v;
+    for (const item &e : lst)
+        v.push_back(e.value);
+    return v;
+}
+
+static int test_cpp_basic_ops()
+{
+    item_list lst;
+    item a(1), b(2), c(3);
+    ASSERT(lst.empty());
+    lst.push_back(a);
+    lst.push_front(b);
+    lst.insert_after(a, c);
+    ASSERT_EQ(lst.size(), 3);
+    ASSERT((values(lst) == std::vector<int>{2, 1, 3}));
+    ASSERT(lst.contains(c));
+    ASSERT(lst.remove(c));
+    ASSERT(!lst.contains(c));
+    ASSERT(lst.pop_front() == &b);
+    ASSERT(lst.pop_front() == &a);
+    ASSERT(lst.pop_front() == nullptr);
+    return 0;
+}
+
+static int test_cpp_iterator_algorithms()
+{
+    item_list lst;
+    item e[5] = {item(1), item(2), item(3), item(4), item(5)};
+    for (item &x : e)
+        lst.push_back(x);
+    auto it = std::find_if(lst.begin(), lst.end(), [](const item &x) { return x.value == 4; });
+    ASSERT(it != lst.end());
+    ASSERT(&*it == &e[3]);
+    ASSERT_EQ(std::distance(lst.begin(), lst.end()), 5);
+    ASSERT_EQ(std::count_if(lst.begin(), lst.end(), [](const item &x) { return x.value % 2; }), 3);
+    /* The C macros see the same head. */
+    ASSERT_EQ(LL_SIZE(lst.native(), struct item, link), 5);
+    while (lst.pop_front())
+        ;
+    return 0;
+}
+
+static int test_cpp_txn_raii()
+{
+    item_list lst;
+    item a(1), b(2), c(3);
+    lst.push_back(a);
+    {
+        auto t = lst.begin_txn();
+        ASSERT(t);
+        t.push_back(b);
+        ASSERT(t.contains(b));
+        ASSERT(!lst.contains(b));
+    } /* destructor rolls back */
+    ASSERT_EQ(lst.size(), 1);
+
+    auto t = lst.begin_txn();
+    t.push_back(b);
+    t.insert_after(a, c);
+    int sum = 0;
+    t.for_each([&](item &x) { sum += x.value; });
+    ASSERT_EQ(sum, 6);
+    std::vector<int> view;
+    for (item &x : t)
+        view.push_back(x.value);
+    ASSERT((view == std::vector<int>{1, 3, 2}));
+    auto moved = std::move(t);
+    ASSERT(!t);
+    ASSERT_EQ(t.commit(), -1);
+    ASSERT_EQ(moved.commit(), 0);
+    ASSERT(!moved);
+    ASSERT((values(lst) == std::vector<int>{1, 3, 2}));
+    while (lst.pop_front())
+        ;
+    return 0;
+}
+
+/* Counts what the list allocates and forwards to the default resource. */
+struct counting_resource : std::pmr::memory_resource {
+    long live = 0, allocs = 0;
+    void *do_allocate(std::size_t bytes, std::size_t align) override
+    {
+        allocs++;
+        live++;
+        return std::pmr::new_delete_resource()->allocate(bytes, align);
+    }
+    void do_deallocate(void *p, std::size_t bytes, std::size_t align) override
+    {
+        live--;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+    }
+    bool do_is_equal(const std::pmr::memory_resource &o) const noexcept override
+    {
+        return this == &o;
+    }
+};
+
+static int test_cpp_pmr_resource()
+{
+    counting_resource mr;
+    {
+        item_list lst(&mr);
+        item a(1), b(2), c(3);
+        lst.push_back(a);
+        lst.push_back(b);
+        ASSERT_EQ(mr.live, 2);
+        auto t = lst.begin_txn();
+        t.remove(a);
+        t.insert_after(b, c);
+        ASSERT_EQ(t.commit(), 0);
+        ASSERT((values(lst) == std::vector<int>{2, 3}));
+        while (lst.pop_front())
+            ;
+    }
+    ASSERT(mr.allocs > 3);
+    ASSERT_EQ(mr.live, 0);
+    return 0;
+}
+
+static int test_cpp_concurrent_push()
+{
+    enum { THREADS = 4, PER = 1000 };
+    item_list lst;
+    std::vector<item> elems(THREADS * PER);
+    std::vector<std::thread> th;
+    for (int t = 0; t < THREADS; t++)
+        th.emplace_back([&, t] {
+            for (int i = 0; i < PER; i++) {
+                elems[t * PER + i].value = t * PER + i;
+                if (i & 1)
+                    lst.push_front(elems[t * PER + i]);
+                else
+                    lst.push_back(elems[t * PER + i]);
+            }
+        });
+    for (auto &x : th)
+        x.join();
+    ASSERT_EQ(lst.size(), THREADS * PER);
+    long sum = 0;
+    for (item &x : lst)
+        sum += x.value;
+    ASSERT_EQ(sum, (long)THREADS * PER * (THREADS * PER - 1) / 2);
+    while (lst.pop_front())
+        ;
+    return 0;
+}
+
+int main()
+{
+    printf("C++ wrapper tests\n");
+    RUN_TEST("cpp basic ops", test_cpp_basic_ops);
+    RUN_TEST("cpp iterator algorithms", test_cpp_iterator_algorithms);
+    RUN_TEST("cpp txn raii", test_cpp_txn_raii);
+    RUN_TEST("cpp pmr resource", test_cpp_pmr_resource);
+    RUN_TEST("cpp concurrent push", test_cpp_concurrent_push);
+    printf("\nTotal: %d run, %d failed\n", tests_run, tests_failed);
+    return tests_failed ? 1 : 0;
+}